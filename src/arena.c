@@ -0,0 +1,186 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: arena.c
+   Memory for the parsing state of one file, freed all at once
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* Most files need a single chunk. Larger allocations get a chunk of their
+   own. */
+#define ARENA_CHUNK (64*1024)
+#define ARENA_ALIGN (16)
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+/* The number of block sizes that can be recycled. */
+#define ARENA_SIZES (8)
+
+typedef struct arena_chunk arena_chunk;
+
+struct arena_chunk {
+   arena_chunk *next;
+   size_t size;
+   size_t used;
+};
+
+/* The memory of a chunk follows its header. */
+#define CHUNK_HEADER ARENA_ROUND(sizeof(arena_chunk))
+
+typedef struct arena_block arena_block;
+
+struct arena_block {
+   arena_block *next;
+};
+
+struct arena {
+   /* The newest chunk first; allocations are taken from it. */
+   arena_chunk *chunks;
+   /* Blocks given back, by size. */
+   size_t free_sizes[ARENA_SIZES];
+   arena_block *free_blocks[ARENA_SIZES];
+   int nsizes;
+};
+
+arena *arena_create(void)
+{
+   return calloc(1, sizeof(arena));
+}
+
+static void free_chunks(arena_chunk *chunk, arena_chunk *end)
+{
+   while(chunk != end) {
+      arena_chunk *next = chunk->next;
+      free(chunk);
+      chunk = next;
+   }
+}
+
+void arena_destroy(arena *mem)
+{
+   if(!mem)
+      return;
+   free_chunks(mem->chunks, NULL);
+   free(mem);
+}
+
+void *arena_alloc(arena *mem, size_t size)
+{
+   arena_chunk *chunk = mem->chunks;
+   void *ptr;
+   int i;
+
+   if(size > (size_t)-1 - CHUNK_HEADER - ARENA_ALIGN)
+      return NULL;
+   size = size ? ARENA_ROUND(size) : ARENA_ALIGN;
+   for(i=0; i < mem->nsizes; i++) {
+      if(mem->free_sizes[i] == size && mem->free_blocks[i]) {
+         arena_block *block = mem->free_blocks[i];
+         mem->free_blocks[i] = block->next;
+         return block;
+      }
+   }
+   if(!chunk || chunk->size - chunk->used < size) {
+      size_t chunk_size = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+      chunk = malloc(CHUNK_HEADER + chunk_size);
+      if(!chunk)
+         return NULL;
+      chunk->next = mem->chunks;
+      chunk->size = chunk_size;
+      chunk->used = 0;
+      mem->chunks = chunk;
+   }
+   ptr = (char *)chunk + CHUNK_HEADER + chunk->used;
+   chunk->used += size;
+   return ptr;
+}
+
+void *arena_calloc(arena *mem, size_t size)
+{
+   void *ptr = arena_alloc(mem, size);
+   if(ptr)
+      memset(ptr, 0, size);
+   return ptr;
+}
+
+void arena_recycle(arena *mem, void *ptr, size_t size)
+{
+   arena_block *block = ptr;
+   int i;
+
+   if(!ptr)
+      return;
+   size = size ? ARENA_ROUND(size) : ARENA_ALIGN;
+   for(i=0; i < mem->nsizes && mem->free_sizes[i] != size; i++);
+   if(i == mem->nsizes) {
+      /* Otherwise the block is only freed with the rest. */
+      if(i == ARENA_SIZES)
+         return;
+      mem->free_sizes[i] = size;
+      mem->free_blocks[i] = NULL;
+      mem->nsizes++;
+   }
+   block->next = mem->free_blocks[i];
+   mem->free_blocks[i] = block;
+}
+
+void arena_get_mark(arena *mem, arena_mark *mark)
+{
+   mark->chunk = mem->chunks;
+   mark->used = mem->chunks ? mem->chunks->used : 0;
+}
+
+void arena_release(arena *mem, const arena_mark *mark)
+{
+   free_chunks(mem->chunks, mark->chunk);
+   mem->chunks = mark->chunk;
+   if(mem->chunks)
+      mem->chunks->used = mark->used;
+}
+
+void arena_reset(arena *mem)
+{
+   arena_chunk *keep = NULL;
+   arena_chunk *chunk = mem->chunks;
+
+   while(chunk) {
+      arena_chunk *next = chunk->next;
+      if(!keep && chunk->size == ARENA_CHUNK) {
+         keep = chunk;
+         keep->next = NULL;
+         keep->used = 0;
+      }
+      else
+         free(chunk);
+      chunk = next;
+   }
+   mem->chunks = keep;
+   mem->nsizes = 0;
+}
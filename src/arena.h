@@ -0,0 +1,72 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: arena.h
+   Memory for the parsing state of one file, freed all at once
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_ARENA_H
+#define OPUSTOOLS_ARENA_H
+
+#include <stddef.h>
+
+/* Memory handed out from large blocks, so that the many small allocations
+   made while checking a file cost little, and are all freed by one
+   arena_reset() once the file is done. An arena is used by one thread at
+   a time. */
+typedef struct arena arena;
+
+/* Where an arena was, for arena_release(). */
+typedef struct {
+   void *chunk;
+   size_t used;
+} arena_mark;
+
+/* Returns NULL if out of memory. */
+arena *arena_create(void);
+
+void arena_destroy(arena *mem);
+
+/* Returns size bytes aligned for any type, or NULL if out of memory. */
+void *arena_alloc(arena *mem, size_t size);
+
+/* The same, with the bytes set to zero. */
+void *arena_calloc(arena *mem, size_t size);
+
+/* Gives back a block of size bytes from arena_alloc() to be handed out
+   again for the same size, so that memory does not grow with the number
+   of links of a chained file. Blocks allocated since a mark that is still
+   to be released cannot be given back. */
+void arena_recycle(arena *mem, void *ptr, size_t size);
+
+/* For scratch memory: arena_release() frees everything allocated since
+   arena_get_mark(). */
+void arena_get_mark(arena *mem, arena_mark *mark);
+void arena_release(arena *mem, const arena_mark *mark);
+
+/* Frees everything allocated from the arena, keeping one block for the
+   next file. */
+void arena_reset(arena *mem);
+
+#endif
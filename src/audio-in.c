@@ -50,6 +50,7 @@
 #include <math.h>
 
 #include "stack_alloc.h"
+#include "pcm_kernels.h"
 
 #if defined WIN32 || defined _WIN32
 # include <windows.h> /*GetFileType()*/
@@ -434,6 +435,8 @@ int aiff_open(FILE *in, oe_enc_opt *opt, unsigned char *buf, size_t buflen)
         aiff->totalsamples = format.totalframes;
         aiff->bigendian = bigendian;
         aiff->unsigned8bit = 0;
+        aiff->follow = NULL;
+        aiff->len_offset = -1;
 
         if (opt->channels_format==CHANNELS_FORMAT_DEFAULT && aiff->channels>3)
           fprintf(stderr, _("WARNING: AIFF[-C] files with more than three channels use\n"
@@ -657,8 +660,19 @@ int wav_open(FILE *in, oe_enc_opt *opt, unsigned char *oldbuf, size_t buflen)
                                             of trying to abstract stuff. */
         wav->samplesize = format.samplesize;
         wav->totalsamples = 0;
+        wav->follow = opt->follow;
+        wav->len_offset = -1;
 
-        if (opt->ignorelength)
+        if (opt->follow)
+        {
+            /* The data chunk is still growing, so the length in the header
+               is not a limit yet. wav_follow_length() looks at it again
+               each time we catch up with the writer. */
+            OFF_T pos = FTELL(in);
+            if (pos >= 4)
+                wav->len_offset = pos - 4;
+        }
+        else if (opt->ignorelength)
         {
             /* Assume audio data continues until EOF.
                No percent progress will be reported. */
@@ -713,6 +727,88 @@ int wav_open(FILE *in, oe_enc_opt *opt, unsigned char *oldbuf, size_t buflen)
     }
 }
 
+/* Called with --follow when we have read everything the writer has
+   written so far. Once the writer has finished the file and put another
+   chunk after the audio, the data chunk length in the header is final:
+   use it, so that the next chunk is not read as audio. Some recorders
+   rewrite the length as they go, so it only counts once a whole chunk
+   sits where it says the data ends; until then we keep following. */
+static void wav_follow_length(wavfile *f)
+{
+    unsigned char buf[4];
+    unsigned char next[8];
+    unsigned int len;
+    opus_int64 frames;
+    OFF_T pos;
+    OFF_T next_offset;
+    OFF_T end;
+    int ok;
+    int i;
+    if (f->len_offset < 0 || f->totalsamples > 0)
+        return;
+    pos = FTELL(f->f);
+    if (pos < 0 || FSEEK(f->f, f->len_offset, SEEK_SET))
+        return;
+    ok = fread(buf, 1, 4, f->f) == 4;
+    len = READ_U32_LE(buf);
+    next_offset = f->len_offset + 4 + (OFF_T)len + (len & 1);
+    /* 0 and all ones are the usual placeholders while recording. */
+    ok = ok && len != 0 && len != 0xFFFFFFFFU
+        && !FSEEK(f->f, next_offset, SEEK_SET)
+        && fread(next, 1, 8, f->f) == 8
+        && !FSEEK(f->f, 0, SEEK_END);
+    end = ok ? FTELL(f->f) : -1;
+    FSEEK(f->f, pos, SEEK_SET);
+    if (!ok)
+        return;
+    /* The ID of the next chunk is four printable ASCII characters, and its
+       body must be in the file already: audio still being written rarely
+       passes for both. */
+    for (i = 0; i < 4; i++)
+        if (next[i] < 0x20 || next[i] > 0x7E)
+            return;
+    if (end < next_offset + 8 + (OFF_T)READ_U32_LE(next + 4))
+        return;
+    frames = len/(f->channels*(f->samplesize/8));
+    f->totalsamples = frames > f->samplesread ? frames : f->samplesread;
+}
+
+/* Reads up to samples frames of frame_bytes each. With --follow, a read
+   that reaches the end of the file waits for the writer to add more,
+   until following ends. */
+static int wav_read_frames(wavfile *f, unsigned char *buf, int frame_bytes,
+    int samples)
+{
+    size_t want;
+    size_t have;
+    if (!f->follow)
+        return (int)fread(buf, frame_bytes, samples, f->f);
+    want = (size_t)samples*frame_bytes;
+    have = 0;
+    for (;;)
+    {
+        /* Reading bytes rather than frames keeps a frame that has only
+           been partly written, so that the rest of it follows it. */
+        have += fread(buf + have, 1, want - have, f->f);
+        if (have == want)
+            break;
+        wav_follow_length(f);
+        if (f->totalsamples > 0)
+        {
+            size_t left = (size_t)(f->totalsamples - f->samplesread)*frame_bytes;
+            if (have >= left)
+            {
+                have = left;
+                break;
+            }
+            want = want < left ? want : left;
+        }
+        if (!follow_wait(f->follow, f->f))
+            break;
+    }
+    return (int)(have/frame_bytes);
+}
+
 int wav_read(void *in, float *buffer, int samples)
 {
     wavfile *f = (wavfile *)in;
@@ -723,7 +819,7 @@ int wav_read(void *in, float *buffer, int samples)
     int i,j;
     int *ch_permute = f->channel_permute;
 
-    realsamples = (int)fread(buf, sampbyte*f->channels, realsamples, f->f);
+    realsamples = wav_read_frames(f, buf, sampbyte*f->channels, realsamples);
     f->samplesread += realsamples;
 
     if (f->samplesize==8)
@@ -809,7 +905,8 @@ int wav_ieee_read(void *in, float *buffer, int samples)
     float *buf = alloca((size_t)realsamples*4*f->channels); /* de-interleave buffer */
     int i,j;
 
-    realsamples = (int)fread(buf, 4*f->channels, realsamples, f->f);
+    realsamples = wav_read_frames(f, (unsigned char *)buf, 4*f->channels,
+        realsamples);
     f->samplesread += realsamples;
 
     if (!f->bigendian) {
@@ -850,6 +947,8 @@ int raw_open(FILE *in, oe_enc_opt *opt, unsigned char *buf, size_t buflen)
     wav->channels =      opt->channels;
     wav->samplesize =    opt->samplesize;
     wav->totalsamples =  0;
+    wav->follow =        opt->follow;
+    wav->len_offset =    -1;
     wav->channel_permute = malloc(wav->channels * sizeof(int));
     for (i=0; i < wav->channels; i++)
       wav->channel_permute[i] = i;
@@ -909,20 +1008,9 @@ static int read_downmix(void *data, float *buffer, int samples)
 {
     downmix *d = data;
     int in_samples = d->real_reader(d->real_readdata, d->bufs, samples);
-    int i,j,k,in_ch,out_ch;
-
-    in_ch = d->in_channels;
-    out_ch = d->out_channels;
 
-    for (i=0; i<in_samples; ++i) {
-        for (j=0; j<out_ch; ++j) {
-            float *samp = &buffer[i*out_ch+j];
-            *samp = 0;
-            for (k=0; k<in_ch; ++k) {
-                *samp += d->bufs[i*in_ch+k] * d->matrix[in_ch*j+k];
-            }
-        }
-    }
+    pcm_kernels()->downmix(buffer, d->bufs, d->matrix,
+        d->in_channels, d->out_channels, in_samples);
     return in_samples;
 }
 
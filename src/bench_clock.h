@@ -0,0 +1,68 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: bench_clock.h
+   Monotonic clock for the --bench timings
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_BENCH_CLOCK_H
+#define OPUSTOOLS_BENCH_CLOCK_H
+
+#if defined WIN32 || defined _WIN32
+# include <windows.h>
+#elif defined HAVE_MACH_ABSOLUTE_TIME
+# include <mach/mach_time.h>
+#else
+# include <time.h>
+#endif
+
+/* Returns a time in seconds from an arbitrary origin, for measuring short
+   intervals. */
+static inline double bench_clock(void)
+{
+#if defined WIN32 || defined _WIN32
+   static double scale;
+   LARGE_INTEGER now;
+   if (scale == 0)
+   {
+      LARGE_INTEGER freq;
+      QueryPerformanceFrequency(&freq);
+      scale = 1./(double)freq.QuadPart;
+   }
+   QueryPerformanceCounter(&now);
+   return (double)now.QuadPart*scale;
+#elif defined HAVE_MACH_ABSOLUTE_TIME
+   static mach_timebase_info_data_t tbinfo;
+   if (tbinfo.denom == 0) mach_timebase_info(&tbinfo);
+   return (double)mach_absolute_time()*tbinfo.numer/tbinfo.denom*1e-9;
+#elif defined HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec*1e-9;
+#else
+   return (double)clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+#endif
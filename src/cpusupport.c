@@ -0,0 +1,143 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: cpusupport.c
+   Run-time CPU feature detection
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "cpusupport.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+# include <intrin.h>
+#elif !defined(HAVE_AVX2_TARGET) && defined(__GNUC__) \
+ && (defined(__i386__) || defined(__x86_64__))
+# include <cpuid.h>
+#endif
+
+static const struct {
+   const char *name;
+   int mask;
+} cpu_tiers[] = {
+   {"c",      0},
+   {"sse2",   CPU_FEATURE_SSE2},
+   {"ssse3",  CPU_FEATURE_SSE2|CPU_FEATURE_SSSE3},
+   {"avx2",   CPU_FEATURE_SSE2|CPU_FEATURE_SSSE3|CPU_FEATURE_AVX2},
+   {"avx512", CPU_FEATURE_SSE2|CPU_FEATURE_SSSE3|CPU_FEATURE_AVX2
+              |CPU_FEATURE_AVX512},
+   {"neon",   CPU_FEATURE_NEON}
+};
+
+static int cpu_detect(void)
+{
+   int features = 0;
+#if defined(HAVE_AVX2_TARGET)
+   /*The configure test guarantees __builtin_cpu_supports(), which also
+     checks that the OS saves the AVX registers.*/
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("sse2")) features |= CPU_FEATURE_SSE2;
+   if (__builtin_cpu_supports("ssse3")) features |= CPU_FEATURE_SSSE3;
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      features |= CPU_FEATURE_AVX2;
+# if defined(HAVE_AVX512_TARGET)
+   if ((features & CPU_FEATURE_AVX2) && __builtin_cpu_supports("avx512f"))
+      features |= CPU_FEATURE_AVX512;
+# endif
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+   int buffer[4];
+   __cpuid(buffer, 1);
+   if (buffer[3] & (1<<26)) features |= CPU_FEATURE_SSE2;
+   if (buffer[2] & (1<<9)) features |= CPU_FEATURE_SSSE3;
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+   unsigned int eax, ebx, ecx=0, edx=0;
+   if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+   {
+      if (edx & (1<<26)) features |= CPU_FEATURE_SSE2;
+      if (ecx & (1<<9)) features |= CPU_FEATURE_SSSE3;
+   }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+   features |= CPU_FEATURE_NEON;
+#endif
+   return features;
+}
+
+static const char *cpu_override(void)
+{
+   const char *env;
+   env = getenv("OPUSTOOLS_CPU");
+   return env && *env ? env : NULL;
+}
+
+int cpu_features(void)
+{
+   static int features = -1;
+   if (features < 0)
+   {
+      int detected;
+      const char *env;
+      detected = cpu_detect();
+      env = cpu_override();
+      if (env)
+      {
+         size_t i;
+         for (i = 0; i < sizeof(cpu_tiers)/sizeof(cpu_tiers[0]); i++)
+         {
+            if (strcmp(env, cpu_tiers[i].name) == 0)
+            {
+               detected &= cpu_tiers[i].mask;
+               break;
+            }
+         }
+         if (i == sizeof(cpu_tiers)/sizeof(cpu_tiers[0]))
+         {
+            fprintf(stderr, "Warning: Ignoring unknown OPUSTOOLS_CPU value '%s'.\n",
+             env);
+         }
+      }
+      features = detected;
+   }
+   return features;
+}
+
+void cpu_print_info(FILE *file)
+{
+   int features;
+   const char *env;
+   features = cpu_features();
+   fprintf(file, "CPU features:");
+   if (features & CPU_FEATURE_SSE2) fprintf(file, " sse2");
+   if (features & CPU_FEATURE_SSSE3) fprintf(file, " ssse3");
+   if (features & CPU_FEATURE_AVX2) fprintf(file, " avx2 fma");
+   if (features & CPU_FEATURE_AVX512) fprintf(file, " avx512f");
+   if (features & CPU_FEATURE_NEON) fprintf(file, " neon");
+   if (!features) fprintf(file, " none");
+   fprintf(file, "\n");
+   env = cpu_override();
+   if (env) fprintf(file, "Limited by OPUSTOOLS_CPU=%s\n", env);
+}
@@ -29,6 +29,25 @@
 #ifndef OPUSTOOLS_CPUSUPPORT_H
 # define OPUSTOOLS_CPUSUPPORT_H
 
+#include <stdio.h>
+
+/* Run-time CPU features, as returned by cpu_features(). */
+# define CPU_FEATURE_SSE2   (1<<0)
+# define CPU_FEATURE_SSSE3  (1<<1)
+/* AVX2 is only reported together with FMA. */
+# define CPU_FEATURE_AVX2   (1<<2)
+# define CPU_FEATURE_AVX512 (1<<3)
+# define CPU_FEATURE_NEON   (1<<4)
+
+/* Detects the CPU features once and caches them. Setting OPUSTOOLS_CPU to
+   one of "c", "sse2", "ssse3", "avx2", "avx512" or "neon" hides every
+   feature above that tier, so that slower kernel variants can be tested.
+   Kernels selected at compile time (e.g. SSE on x86-64) are unaffected. */
+int cpu_features(void);
+
+/* Prints the detected features and any OPUSTOOLS_CPU override. */
+void cpu_print_info(FILE *file);
+
 /* We want to warn if we're built with SSE support, but running
    on a host without those instructions. Therefore we disable
    the query both if the compiler isn't supporting SSE, and on
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <opus_types.h>
 #include <opusenc.h>
+#include "follow.h"
 
 #ifdef ENABLE_NLS
 # include <libintl.h>
@@ -36,6 +37,7 @@ typedef struct
     int samplesize;
     int endianness;
     int ignorelength;
+    follow_state *follow; /* Non-NULL with --follow */
     OggOpusComments *comments;
     int copy_comments;
     int copy_pictures;
@@ -74,6 +76,8 @@ typedef struct {
     short bigendian;
     short unsigned8bit;
     int *channel_permute;
+    follow_state *follow;
+    opus_int64 len_offset; /* Position of the data chunk length, or -1 */
 } wavfile;
 
 typedef struct {
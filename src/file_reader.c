@@ -0,0 +1,544 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: file_reader.c
+   Sequential file reads with io_uring read-ahead
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined WIN32 || defined _WIN32
+# include "unicode_support.h"
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define fopen_utf8(_x,_y) fopen((_x),(_y))
+#endif
+
+#if defined __linux__ && defined HAVE_LINUX_IO_URING_H
+# include <stdint.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+# include <linux/io_uring.h>
+# if defined __NR_io_uring_setup && defined __NR_io_uring_enter
+#  define READER_URING
+# endif
+#endif
+
+#include "file_reader.h"
+
+/* Macros for handling potentially large file offsets */
+#if defined WIN32 || defined _WIN32
+# define OFF_T __int64
+# define FSEEK _fseeki64
+# define FTELL _ftelli64
+#elif defined HAVE_FSEEKO
+# define OFF_T off_t
+# define FSEEK fseeko
+# define FTELL ftello
+#else
+# define OFF_T long
+# define FSEEK fseek
+# define FTELL ftell
+#endif
+
+/* The size of each read, and how many of them can be in flight for one
+   file. */
+#define READER_BLOCK (256*1024)
+#define READER_DEPTH (8)
+/* Room in a ring for the reads of a few files at once. */
+#define RING_ENTRIES (32)
+#define READER_ALIGN (4096)
+
+enum {
+   BLOCK_IDLE,
+   BLOCK_QUEUED,
+   BLOCK_DONE
+};
+
+typedef struct {
+   unsigned char *data;
+   ogg_int64_t offset;
+   /* The number of bytes read, or a negative errno value. */
+   long length;
+   int state;
+#ifdef READER_URING
+   struct iovec iov;
+#endif
+} reader_block;
+
+struct file_reader {
+   FILE *f;
+   file_ring *ring;
+   int regular;
+   /* The size of the file when it was opened, or -1, so that nothing is
+      read ahead past it. */
+   ogg_int64_t size;
+   ogg_int64_t pos;
+   /* Where stdio is in the file, when it is used to read. */
+   ogg_int64_t stdio_pos;
+   /* blocks[head] holds pos, and the count blocks from there follow each
+      other up to next_offset. */
+   reader_block blocks[READER_DEPTH];
+   int depth;
+   int head;
+   int count;
+   ogg_int64_t next_offset;
+   /* How many blocks to keep in flight: one after a seek, doubling with
+      each block read in order. */
+   int window;
+   unsigned char *buffer;
+};
+
+#ifdef READER_URING
+struct file_ring {
+   int fd;
+   unsigned entries;
+   /* Reads queued but not yet given to the kernel, and reads not yet
+      completed. */
+   unsigned pending;
+   unsigned inflight;
+   unsigned *sq_tail;
+   unsigned *sq_mask;
+   unsigned *sq_array;
+   struct io_uring_sqe *sqes;
+   unsigned *cq_head;
+   unsigned *cq_tail;
+   unsigned *cq_mask;
+   struct io_uring_cqe *cqes;
+   void *sq_ring;
+   size_t sq_ring_size;
+   void *cq_ring;
+   size_t cq_ring_size;
+   size_t sqes_size;
+};
+
+file_ring *file_ring_create(void)
+{
+   struct io_uring_params p;
+   file_ring *ring;
+   unsigned char *sq;
+   unsigned char *cq;
+   ring = calloc(1, sizeof(*ring));
+   if (!ring) return NULL;
+   ring->sq_ring = ring->cq_ring = MAP_FAILED;
+   ring->sqes = MAP_FAILED;
+   memset(&p, 0, sizeof(p));
+   ring->fd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+   if (ring->fd < 0)
+   {
+      free(ring);
+      return NULL;
+   }
+   ring->entries = p.sq_entries;
+   ring->sq_ring_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+   ring->cq_ring_size = p.cq_off.cqes
+      + p.cq_entries*sizeof(struct io_uring_cqe);
+   ring->sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+   /* Newer kernels map both rings at once. */
+   if (p.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      if (ring->cq_ring_size > ring->sq_ring_size)
+         ring->sq_ring_size = ring->cq_ring_size;
+      ring->cq_ring_size = 0;
+   }
+   ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ|PROT_WRITE,
+      MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+   if (ring->sq_ring != MAP_FAILED && ring->cq_ring_size)
+   {
+      ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ|PROT_WRITE,
+         MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+   }
+   else ring->cq_ring = ring->sq_ring;
+   ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE,
+      MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+   if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED
+      || ring->sqes == MAP_FAILED)
+   {
+      file_ring_destroy(ring);
+      return NULL;
+   }
+   sq = (unsigned char *)ring->sq_ring;
+   cq = (unsigned char *)ring->cq_ring;
+   ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+   ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+   ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+   ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+   ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+   ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+   ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+   return ring;
+}
+
+void file_ring_destroy(file_ring *ring)
+{
+   if (!ring) return;
+   if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+   if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+      munmap(ring->cq_ring, ring->cq_ring_size);
+   if (ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+   close(ring->fd);
+   free(ring);
+}
+
+/* Gives the kernel the queued reads, and waits for wait of them to
+   complete. */
+static int ring_enter(file_ring *ring, unsigned wait)
+{
+   int ret;
+   for (;;)
+   {
+      ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait,
+         wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+      if (ret >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY))
+         break;
+   }
+   if (ret > 0) ring->pending -= (unsigned)ret;
+   return ret;
+}
+
+/* Stores the results of the completed reads in their blocks. */
+static void ring_reap(file_ring *ring)
+{
+   unsigned head;
+   unsigned tail;
+   head = *ring->cq_head;
+   tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+   while (head != tail)
+   {
+      struct io_uring_cqe *cqe;
+      reader_block *b;
+      cqe = &ring->cqes[head & *ring->cq_mask];
+      b = (reader_block *)(uintptr_t)cqe->user_data;
+      b->length = cqe->res;
+      b->state = BLOCK_DONE;
+      ring->inflight--;
+      head++;
+   }
+   __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* Returns 0 if the ring is full. */
+static int ring_queue(file_ring *ring, int fd, reader_block *b)
+{
+   struct io_uring_sqe *sqe;
+   unsigned tail;
+   unsigned idx;
+   if (ring->inflight >= ring->entries) return 0;
+   tail = *ring->sq_tail;
+   idx = tail & *ring->sq_mask;
+   sqe = &ring->sqes[idx];
+   memset(sqe, 0, sizeof(*sqe));
+   /* READV rather than READ works from the first kernels with io_uring. */
+   b->iov.iov_base = b->data;
+   b->iov.iov_len = READER_BLOCK;
+   sqe->opcode = IORING_OP_READV;
+   sqe->fd = fd;
+   sqe->addr = (uintptr_t)&b->iov;
+   sqe->len = 1;
+   sqe->off = (ogg_uint64_t)b->offset;
+   sqe->user_data = (uintptr_t)b;
+   ring->sq_array[idx] = idx;
+   __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+   ring->pending++;
+   ring->inflight++;
+   b->state = BLOCK_QUEUED;
+   return 1;
+}
+
+static void ring_wait(file_ring *ring, reader_block *b)
+{
+   for (;;)
+   {
+      ring_reap(ring);
+      if (b->state != BLOCK_QUEUED) break;
+      if (ring_enter(ring, 1) < 0)
+      {
+         /* The read is lost; the block is not used again. */
+         b->length = -EIO;
+         b->state = BLOCK_DONE;
+         break;
+      }
+   }
+}
+#else
+file_ring *file_ring_create(void)
+{
+   return NULL;
+}
+
+void file_ring_destroy(file_ring *ring)
+{
+   (void)ring;
+}
+#endif
+
+/* Reads a block without the ring. */
+static void block_read(file_reader *r, reader_block *b)
+{
+   long got;
+   got = 0;
+#if !(defined WIN32 || defined _WIN32)
+   if (r->regular)
+   {
+      while (got < READER_BLOCK)
+      {
+         ssize_t ret;
+         ret = pread(fileno(r->f), b->data + got, READER_BLOCK - got,
+            (off_t)(b->offset + got));
+         if (ret < 0 && errno == EINTR) continue;
+         if (ret < 0 && got == 0) got = -errno;
+         if (ret <= 0) break;
+         got += (long)ret;
+      }
+      b->length = got;
+      b->state = BLOCK_DONE;
+      return;
+   }
+#endif
+   /* Pipes can only be read in order, so stdio is only seeked when the
+      caller has. */
+   if (b->offset != r->stdio_pos)
+   {
+      if (FSEEK(r->f, (OFF_T)b->offset, SEEK_SET) != 0)
+      {
+         b->length = -EIO;
+         b->state = BLOCK_DONE;
+         return;
+      }
+      r->stdio_pos = b->offset;
+   }
+   got = (long)fread(b->data, 1, READER_BLOCK, r->f);
+   r->stdio_pos += got;
+   b->length = got == 0 && ferror(r->f) ? -EIO : got;
+   b->state = BLOCK_DONE;
+}
+
+/* Waits for the reads still in flight, and forgets every block. */
+static void reader_reset(file_reader *r)
+{
+   int i;
+   for (i = 0; i < r->count; i++)
+   {
+      reader_block *b = &r->blocks[(r->head + i) % r->depth];
+#ifdef READER_URING
+      if (b->state == BLOCK_QUEUED) ring_wait(r->ring, b);
+#endif
+      b->state = BLOCK_IDLE;
+   }
+   r->count = 0;
+   r->window = 1;
+}
+
+/* Queues reads of the blocks after the last one, as far as the window and
+   the size of the file allow. */
+static void reader_fill(file_reader *r)
+{
+#ifdef READER_URING
+   /* Without a ring, the one block below is read with stdio. */
+   if (r->ring)
+   {
+      while (r->count < r->window
+         && (r->count == 0 || r->size < 0 || r->next_offset < r->size))
+      {
+         reader_block *b = &r->blocks[(r->head + r->count) % r->depth];
+         b->offset = r->count ? r->next_offset : r->pos;
+         if (!ring_queue(r->ring, fileno(r->f), b)) break;
+         r->count++;
+         r->next_offset = b->offset + READER_BLOCK;
+      }
+      if (r->ring->pending) ring_enter(r->ring, 0);
+   }
+#endif
+   if (r->count == 0)
+   {
+      reader_block *b = &r->blocks[r->head];
+      b->offset = r->pos;
+      b->state = BLOCK_IDLE;
+      r->count = 1;
+      r->next_offset = r->pos + READER_BLOCK;
+   }
+}
+
+static void block_wait(file_reader *r, reader_block *b)
+{
+#ifdef READER_URING
+   if (b->state == BLOCK_QUEUED)
+   {
+      ring_wait(r->ring, b);
+      if (b->length == -EINVAL || b->length == -EOPNOTSUPP)
+      {
+         /* This file cannot be read with io_uring. */
+         reader_reset(r);
+         r->ring = NULL;
+         r->depth = 1;
+         r->head = 0;
+         reader_fill(r);
+         b = &r->blocks[r->head];
+      }
+   }
+#endif
+   if (b->state == BLOCK_IDLE) block_read(r, b);
+}
+
+file_reader *file_reader_open(const char *path, file_ring *ring)
+{
+   file_reader *r;
+   unsigned char *data;
+   int i;
+   r = calloc(1, sizeof(*r));
+   if (!r) return NULL;
+   r->f = fopen_utf8(path, "rb");
+   if (!r->f)
+   {
+      free(r);
+      return NULL;
+   }
+   r->size = -1;
+#if !(defined WIN32 || defined _WIN32)
+   {
+      struct stat st;
+      if (fstat(fileno(r->f), &st) == 0 && S_ISREG(st.st_mode))
+      {
+         r->regular = 1;
+         r->size = st.st_size;
+      }
+   }
+#endif
+   r->ring = r->regular ? ring : NULL;
+   r->depth = r->ring ? READER_DEPTH : 1;
+   r->window = 1;
+   r->buffer = malloc((size_t)r->depth*READER_BLOCK + READER_ALIGN);
+   if (!r->buffer)
+   {
+      fclose(r->f);
+      free(r);
+      errno = ENOMEM;
+      return NULL;
+   }
+   data = r->buffer + (READER_ALIGN - (size_t)r->buffer%READER_ALIGN)
+      % READER_ALIGN;
+   for (i = 0; i < r->depth; i++)
+      r->blocks[i].data = data + (size_t)i*READER_BLOCK;
+   return r;
+}
+
+long file_reader_read(file_reader *r, void *buf, long n)
+{
+   long got;
+   got = 0;
+   while (got < n)
+   {
+      reader_block *b;
+      long avail;
+      if (r->count == 0) reader_fill(r);
+      b = &r->blocks[r->head];
+      block_wait(r, b);
+      b = &r->blocks[r->head];
+      if (b->length < 0)
+      {
+         reader_reset(r);
+         return got ? got : -1;
+      }
+      avail = (long)(b->offset + b->length - r->pos);
+      if (avail <= 0)
+      {
+         if (b->length == READER_BLOCK)
+         {
+            /* Move on to the next block, reading further ahead. */
+            b->state = BLOCK_IDLE;
+            r->head = (r->head + 1) % r->depth;
+            r->count--;
+            r->window = r->window*2 < r->depth ? r->window*2 : r->depth;
+            reader_fill(r);
+            continue;
+         }
+         /* A short read at pos is the end of the file. One that ended
+            before pos is read again, in case the file has grown. */
+         if (b->offset == r->pos) break;
+         reader_reset(r);
+         continue;
+      }
+      if (avail > n - got) avail = n - got;
+      memcpy((unsigned char *)buf + got, b->data + (r->pos - b->offset),
+         avail);
+      got += avail;
+      r->pos += avail;
+   }
+   return got;
+}
+
+ogg_int64_t file_reader_seek(file_reader *r, ogg_int64_t offset, int whence)
+{
+   ogg_int64_t target;
+   if (whence == SEEK_CUR) target = r->pos + offset;
+   else if (whence == SEEK_END)
+   {
+      ogg_int64_t size;
+#if defined WIN32 || defined _WIN32
+      if (FSEEK(r->f, 0, SEEK_END) != 0) return -1;
+      size = FTELL(r->f);
+      r->stdio_pos = size;
+#else
+      struct stat st;
+      if (!r->regular || fstat(fileno(r->f), &st) != 0) return -1;
+      size = st.st_size;
+#endif
+      if (size < 0) return -1;
+      target = size + offset;
+   }
+   else target = offset;
+   if (target < 0) return -1;
+   /* Stay in the current block if we can. */
+   if (r->count == 0 || target < r->blocks[r->head].offset
+      || target >= r->blocks[r->head].offset + READER_BLOCK)
+   {
+      reader_reset(r);
+   }
+   r->pos = target;
+   return target;
+}
+
+ogg_int64_t file_reader_tell(file_reader *r)
+{
+   return r->pos;
+}
+
+void file_reader_close(file_reader *r)
+{
+   if (!r) return;
+   reader_reset(r);
+   fclose(r->f);
+   free(r->buffer);
+   free(r);
+}
@@ -0,0 +1,61 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: file_reader.h
+   Sequential file reads with io_uring read-ahead
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_FILE_READER_H
+#define OPUSTOOLS_FILE_READER_H
+
+#include <ogg/ogg.h>
+
+typedef struct file_ring file_ring;
+typedef struct file_reader file_reader;
+
+/* An io_uring to keep the reads of file_readers in flight, for one thread.
+   A thread that reads many files in turn should keep one ring for all of
+   them. Returns NULL if io_uring is not available, in which case readers
+   fall back to plain reads. */
+file_ring *file_ring_create(void);
+void file_ring_destroy(file_ring *ring);
+
+/* Opens path for reading from the start. With a ring, the blocks after the
+   one being read are read ahead while the caller works on it, as long as
+   the file is read in order. ring may be NULL. Returns NULL if the file
+   cannot be opened, with errno set. */
+file_reader *file_reader_open(const char *path, file_ring *ring);
+
+/* Reads up to n bytes, returning fewer only at the end of the file.
+   Returns -1 on a read error. */
+long file_reader_read(file_reader *r, void *buf, long n);
+
+/* As fseek(), but returns the new position, or -1 on error. */
+ogg_int64_t file_reader_seek(file_reader *r, ogg_int64_t offset, int whence);
+
+ogg_int64_t file_reader_tell(file_reader *r);
+
+void file_reader_close(file_reader *r);
+
+#endif
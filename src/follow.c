@@ -0,0 +1,175 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: follow.c
+   Waiting for more data at the end of a file that is still being written
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined WIN32 || defined _WIN32
+# include <windows.h>
+# include "unicode_support.h"
+#else
+# include <unistd.h>
+# define fopen_utf8(_x,_y) fopen((_x),(_y))
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+# include <poll.h>
+#endif
+
+#include "follow.h"
+
+/* Without inotify, the file is polled for growth this often, in ms. With
+   it, growth wakes us up straight away, and we only wake up this often to
+   check the timeout and the sentinel. */
+#define FOLLOW_POLL_MS (100)
+#define FOLLOW_CHECK_MS (1000)
+
+int follow_init(follow_state *fs, const char *path, double timeout,
+   const char *sentinel)
+{
+   fs->timeout = timeout;
+   fs->sentinel = sentinel;
+   fs->last_growth = time(NULL);
+   fs->inotify_fd = -1;
+#ifdef HAVE_SYS_INOTIFY_H
+   fs->inotify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+   if (fs->inotify_fd >= 0
+      && inotify_add_watch(fs->inotify_fd, path, IN_MODIFY) < 0)
+   {
+      close(fs->inotify_fd);
+      fs->inotify_fd = -1;
+      return -1;
+   }
+#else
+   (void)path;
+#endif
+   return 0;
+}
+
+void follow_clear(follow_state *fs)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+   if (fs->inotify_fd >= 0) close(fs->inotify_fd);
+#endif
+   fs->inotify_fd = -1;
+}
+
+/* Returns 1 if there are bytes in f past the current read position. */
+static int file_grew(FILE *f)
+{
+#if defined WIN32 || defined _WIN32
+   struct _stati64 st;
+   __int64 pos;
+   pos = _ftelli64(f);
+   if (_fstati64(_fileno(f), &st)) return 0;
+#else
+   struct stat st;
+# ifdef HAVE_FSEEKO
+   off_t pos;
+   pos = ftello(f);
+# else
+   long pos;
+   pos = ftell(f);
+# endif
+   if (fstat(fileno(f), &st)) return 0;
+#endif
+   return pos >= 0 && st.st_size > pos;
+}
+
+static int sentinel_exists(const char *path)
+{
+   FILE *f;
+   f = fopen_utf8(path, "rb");
+   if (!f) return 0;
+   fclose(f);
+   return 1;
+}
+
+static void wait_for_change(follow_state *fs)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+   if (fs->inotify_fd >= 0)
+   {
+      struct pollfd pfd;
+      pfd.fd = fs->inotify_fd;
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, FOLLOW_CHECK_MS) > 0)
+      {
+         char events[4096];
+         /* We only care that something happened. */
+         while (read(fs->inotify_fd, events, sizeof(events)) > 0);
+      }
+      return;
+   }
+#else
+   (void)fs;
+#endif
+#if defined WIN32 || defined _WIN32
+   Sleep(FOLLOW_POLL_MS);
+#elif defined HAVE_NANOSLEEP
+   {
+      struct timespec nap;
+      nap.tv_sec = 0;
+      nap.tv_nsec = FOLLOW_POLL_MS*1000000L;
+      nanosleep(&nap, NULL);
+   }
+#elif defined HAVE_USLEEP
+   usleep(FOLLOW_POLL_MS*1000);
+#else
+   sleep(1);
+#endif
+}
+
+int follow_wait(follow_state *fs, FILE *f)
+{
+   for (;;)
+   {
+      int done;
+      clearerr(f);
+      /* Look for the sentinel before checking the size, so that data
+         written just before the sentinel was created is never missed. */
+      done = fs->sentinel != NULL && sentinel_exists(fs->sentinel);
+      if (file_grew(f))
+      {
+         fs->last_growth = time(NULL);
+         return 1;
+      }
+      if (done) return 0;
+      if (fs->timeout > 0
+         && difftime(time(NULL), fs->last_growth) >= fs->timeout)
+         return 0;
+      wait_for_change(fs);
+   }
+}
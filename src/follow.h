@@ -0,0 +1,59 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: follow.h
+   Waiting for more data at the end of a file that is still being written
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_FOLLOW_H
+#define OPUSTOOLS_FOLLOW_H
+
+#include <stdio.h>
+#include <time.h>
+
+/* Used by opusenc --follow and opusdec --follow to read a file while
+   another program is still appending to it. When a read reaches the end of
+   the file, follow_wait() blocks until the file grows, using inotify where
+   it is available and polling otherwise. Following ends when the sentinel
+   file appears, or when the file has not grown for the timeout. */
+typedef struct {
+   double timeout;
+   const char *sentinel;
+   time_t last_growth;
+   int inotify_fd;
+} follow_state;
+
+/* timeout is in seconds; 0 waits forever. sentinel may be NULL. Returns 0
+   on success or -1 if path cannot be watched. */
+int follow_init(follow_state *fs, const char *path, double timeout,
+   const char *sentinel);
+
+/* Called after a read of f came up short. Returns 1 once there is more
+   data to read, or 0 if following has ended and nothing more will come.
+   Clears the end-of-file indicator of f. */
+int follow_wait(follow_state *fs, FILE *f);
+
+void follow_clear(follow_state *fs);
+
+#endif
@@ -29,17 +29,20 @@
 # include <config.h>
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <ogg/ogg.h>
 
+#include "arena.h"
 #ifndef OPUSTOOLS
 # include "ogginfo2.h"
 #else
 # include "opusinfo.h"
 #endif
 #include "opus_header.h"
+#include "packet_stats.h"
 #include "info_opus.h"
 
 /* From libopus, src/opus_decode.c */
@@ -100,9 +103,10 @@ void info_opus_process(stream_processor *stream, ogg_page *page )
 
     while(1) {
         ogg_int32_t spp;
+        int frames;
         res = ogg_stream_packetout(&stream->os, &packet);
         if(res < 0) {
-           oi_warn(_("WARNING: discontinuity in stream (%d)\n"), stream->num);
+           oi_warn(stream->report, "discontinuity", _("WARNING: discontinuity in stream (%d)\n"), stream->num);
            continue;
         }
         else if (res == 0)
@@ -110,20 +114,20 @@ void info_opus_process(stream_processor *stream, ogg_page *page )
 
         packets++;
         if(header == 1 && packets >= 2) {
-          oi_warn(_("WARNING: Extra packet in header page "
+          oi_warn(stream->report, "extra_header_packet", _("WARNING: Extra packet in header page "
                     "- invalid Opus stream (%d)\n"), stream->num);
         }
         if(inf->doneheaders < 2) {
             if(inf->doneheaders==0 && opus_header_parse(packet.packet,packet.bytes,&inf->oh)!=1) {
-                oi_warn(_("WARNING: Could not decode Opus header "
+                oi_warn(stream->report, "bad_opushead", _("WARNING: Could not decode Opus header "
                        "packet %d - invalid Opus stream (%d)\n"),
                         inf->doneheaders, stream->num);
                 continue;
             } else if (inf->doneheaders==0){
-                if(inf->oh.preskip<120)oi_warn(_("WARNING: Implausibly low preskip in Opus stream (%d)\n"),stream->num);
+                if(inf->oh.preskip<120)oi_warn(stream->report, "low_preskip", _("WARNING: Implausibly low preskip in Opus stream (%d)\n"),stream->num);
             }
             if(inf->doneheaders==1 && (packet.bytes<8 || memcmp(packet.packet, "OpusTags",8)!=0)) {
-               oi_warn(_("WARNING: Could not decode OpusTags header "
+               oi_warn(stream->report, "bad_opustags", _("WARNING: Could not decode OpusTags header "
                        "packet %d - invalid Opus stream (%d)\n"),
                         inf->doneheaders, stream->num);
                 continue;
@@ -134,49 +138,43 @@ void info_opus_process(stream_processor *stream, ogg_page *page )
 
                 length=packet.bytes;
                 if (length<(8+4+4)) {
-                    oi_warn(_("Invalid/corrupted comments in stream %d\n"),stream->num);
+                    oi_warn(stream->report, "bad_comments", _("Invalid/corrupted comments in stream %d\n"),stream->num);
                     continue;
                 }
                 c += 8;
                 len=readle32(c, 0);
                 c+=4;
                 if (len < 0 || len>(length-16)) {
-                    oi_warn(_("Invalid/corrupted comments in stream %d\n"),stream->num);
+                    oi_warn(stream->report, "bad_comments", _("Invalid/corrupted comments in stream %d\n"),stream->num);
                     continue;
                 }
-                tmp=calloc(len+1,1);
-                memcpy(tmp,c,len);
-                oi_info(_("Encoded with %s\n"),tmp);
-                free(tmp);
+                tmp=memchr(c,0,len);
+                oi_info(stream->report, _("Encoded with %.*s\n"),
+                        tmp ? (int)(tmp-c) : len, c);
                 c+=len;
                 /*The -16 check above makes sure we can read this.*/
                 nb_fields=readle32(c, 0);
                 c+=4;
                 length-=16+len;
                 if (nb_fields < 0 || nb_fields>(length>>2)) {
-                    oi_warn(_("Invalid/corrupted comments in stream %d\n"),stream->num);
+                    oi_warn(stream->report, "bad_comments", _("Invalid/corrupted comments in stream %d\n"),stream->num);
                     continue;
                 }
-                if(nb_fields)oi_info(_("User comments section follows...\n"));
+                if(nb_fields)oi_info(stream->report, _("User comments section follows...\n"));
                 for (i=0;i<nb_fields;i++) {
-                    char *comment;
                     if (length<4) {
-                        oi_warn(_("Invalid/corrupted comments in stream %d\n"),stream->num);
+                        oi_warn(stream->report, "bad_comments", _("Invalid/corrupted comments in stream %d\n"),stream->num);
                         break;
                     }
                     len=readle32(c, 0);
                     c+=4;
                     length-=4;
                     if (len < 0 || len>length) {
-                        oi_warn(_("Invalid/corrupted comments in stream %d\n"),stream->num);
+                        oi_warn(stream->report, "bad_comments", _("Invalid/corrupted comments in stream %d\n"),stream->num);
                         break;
                     }
-                    /*check_xiph_comment expects a null terminated comment*/
-                    comment=malloc((len+1)*sizeof(char));
-                    memcpy(comment,c,len);
-                    comment[len]=0;
-                    check_xiph_comment(stream, i, comment, len);
-                    free(comment);
+                    /*The comment is checked in place, in the packet.*/
+                    check_xiph_comment(stream, i, c, len);
                     c+=len;
                     length-=len;
                 }
@@ -186,23 +184,25 @@ void info_opus_process(stream_processor *stream, ogg_page *page )
             continue;
         }
         if(packet.bytes>=2 && memcmp(packet.packet, "Op",2)==0) {
-            oi_warn(_("WARNING: Invalid packet or misplaced header in stream %d\n"),stream->num);
+            oi_warn(stream->report, "misplaced_header", _("WARNING: Invalid packet or misplaced header in stream %d\n"),stream->num);
             continue;
         }
         if(packet.bytes<1) {
-            oi_warn(_("WARNING: Invalid zero byte packet in stream %d\n"),stream->num);
+            if(inf->stats)packet_stats_add_empty(inf->stats);
+            oi_warn(stream->report, "empty_packet", _("WARNING: Invalid zero byte packet in stream %d\n"),stream->num);
             continue;
         }
-        spp = packet_get_nb_frames(packet.packet,packet.bytes);
-        if(spp<1 || spp>48) {
-            oi_warn(_("WARNING: Invalid packet TOC in stream %d\n"),stream->num);
+        frames = packet_get_nb_frames(packet.packet,packet.bytes);
+        if(frames<1 || frames>48) {
+            oi_warn(stream->report, "bad_toc", _("WARNING: Invalid packet TOC in stream %d\n"),stream->num);
             continue;
         }
-        spp *= packet_get_samples_per_frame(packet.packet,48000);
+        spp = frames*packet_get_samples_per_frame(packet.packet,48000);
         if(spp<120 || spp>5760 || (spp%120)!=0) {
-            oi_warn(_("WARNING: Invalid packet TOC in stream %d\n"),stream->num);
+            oi_warn(stream->report, "bad_toc", _("WARNING: Invalid packet TOC in stream %d\n"),stream->num);
             continue;
         }
+        if(inf->stats)packet_stats_add(inf->stats,packet.packet,packet.bytes,frames,spp);
         inf->total_samples += spp;
         page_samples += spp;
         inf->total_packets++;
@@ -217,7 +217,7 @@ void info_opus_process(stream_processor *stream, ogg_page *page )
         ogg_int64_t gp = ogg_page_granulepos(page);
         if(gp > 0) {
             if(gp < inf->lastgranulepos)
-                oi_warn(_("WARNING: granulepos in stream %d decreases from %"
+                oi_warn(stream->report, "granulepos_decreases", _("WARNING: granulepos in stream %d decreases from %"
                         PRId64 " to %" PRId64 "\n" ),
                         stream->num, inf->lastgranulepos, gp);
             if(inf->lastgranulepos==0 && inf->firstgranule==-1) {
@@ -226,25 +226,25 @@ void info_opus_process(stream_processor *stream, ogg_page *page )
                 if(inf->firstgranule<0) {
                   /*There shouldn't be any negative samples after counting the samples in the page backwards
                     from the first GP, but if this is the last page of the stream there may need to be to trim.*/
-                  if(!ogg_page_eos(page))oi_warn(_("WARNING: Samples with negative granpos in stream %d\n"),stream->num);
+                  if(!ogg_page_eos(page))oi_warn(stream->report, "negative_granpos", _("WARNING: Samples with negative granpos in stream %d\n"),stream->num);
                   else inf->firstgranule=0;
                 }
             }
-            if(inf->total_samples<gp-inf->firstgranule)oi_warn(_("WARNING: Sample count behind granule (%" PRId64 "<%" PRId64 ") in stream %d\n"),
+            if(inf->total_samples<gp-inf->firstgranule)oi_warn(stream->report, "samples_behind_granule", _("WARNING: Sample count behind granule (%" PRId64 "<%" PRId64 ") in stream %d\n"),
                 inf->total_samples,gp-inf->firstgranule,stream->num);
             if(!ogg_page_eos(page) && (inf->total_samples>gp-inf->firstgranule))
-                oi_warn(_("WARNING: Sample count ahead of granule (%" PRId64 ">%" PRId64 ") in stream %d\n"),
+                oi_warn(stream->report, "samples_ahead_of_granule", _("WARNING: Sample count ahead of granule (%" PRId64 ">%" PRId64 ") in stream %d\n"),
                 inf->total_samples,gp-inf->firstgranule,stream->num);
             inf->lastlastgranulepos = inf->lastgranulepos;
             inf->lastgranulepos = gp;
             if(!packets)
-                oi_warn(_("WARNING: Page with positive granpos (%" PRId64 ") on a page with no completed packets in stream %d\n"),gp,stream->num);
+                oi_warn(stream->report, "granpos_without_packets", _("WARNING: Page with positive granpos (%" PRId64 ") on a page with no completed packets in stream %d\n"),gp,stream->num);
         }
         else if(packets) {
             /* Only do this if we saw at least one packet ending on this page.
              * It's legal (though very unusual) to have no packets in a page at
              * all - this is occasionally used to have an empty EOS page */
-            oi_warn(_("Negative or zero granulepos (%" PRId64 ") on Opus stream outside of headers. This file was created by a buggy encoder\n"), gp);
+            oi_warn(stream->report, "bad_granulepos", _("Negative or zero granulepos (%" PRId64 ") on Opus stream outside of headers. This file was created by a buggy encoder\n"), gp);
         }
         inf->overhead_bytes += page->header_len;
         if(page_samples)inf->last_page_duration = page_samples;
@@ -258,69 +258,173 @@ void info_opus_process(stream_processor *stream, ogg_page *page )
     inf->bytes += page->header_len + page->body_len;
 }
 
+/* Prints the fields of the ID header. */
+static void print_opus_header(stream_processor *stream,
+        const misc_opus_info *inf)
+{
+    int i, j;
+    oi_info(stream->report, _("\tPre-skip: %d\n"),inf->oh.preskip);
+    oi_info(stream->report, _("\tPlayback gain: %g dB\n"),inf->oh.gain/256.);
+    oi_info(stream->report, _("\tChannels: %d\n"),inf->oh.channels);
+    if(inf->oh.input_sample_rate)oi_info(stream->report, _("\tOriginal sample rate: %d Hz\n"),inf->oh.input_sample_rate);
+    if(inf->oh.nb_streams>1)oi_info(stream->report, _("\tStreams: %d, Coupled: %d\n"),inf->oh.nb_streams,inf->oh.nb_coupled);
+    if(inf->oh.channel_mapping>0) {
+      oi_info(stream->report, _("\tChannel Mapping Family: %d"),inf->oh.channel_mapping);
+      if(inf->oh.channel_mapping==3) {
+        oi_info(stream->report, _("\n"));
+        if(inf->oh.channels*(inf->oh.nb_streams+inf->oh.nb_coupled)*2 <= OPUS_DEMIXING_MATRIX_SIZE_MAX) {
+          oi_info(stream->report, _("\tDemixing Matrix [%dx%d]:\n"),inf->oh.nb_streams+inf->oh.nb_coupled,inf->oh.channels);
+          for(i=0;i<inf->oh.nb_streams+inf->oh.nb_coupled;i++) {
+            for(j=0;j<inf->oh.channels;j++) {
+              int k=j*(inf->oh.nb_streams+inf->oh.nb_coupled)+i;
+              int s=inf->oh.dmatrix[2*k + 1] << 8 | inf->oh.dmatrix[2*k];
+              s = ((s & 0xFFFF) ^ 0x8000) - 0x8000;
+              oi_info(stream->report, "%s%6d%s",j==0?"\t[":", ",s,j==inf->oh.channels-1?"]\n":"");
+            }
+          }
+        }
+      }
+      else {
+        oi_info(stream->report, _(" Map:"));
+        for(i=0;i<inf->oh.channels;i++)oi_info(stream->report, "%s%d%s",i==0?" [":", ",inf->oh.stream_map[i],i==inf->oh.channels-1?"]\n":"");
+      }
+    }
+}
+
+/* Splits a duration in seconds into minutes, seconds and milliseconds. */
+static void split_time(double time, long *minutes, long *seconds,
+        long *milliseconds)
+{
+    *minutes = (long)(time) / 60;
+    *seconds = (long)(time - *minutes*60);
+    *milliseconds = (long)((time - *minutes*60 - *seconds)*1000);
+}
+
+/* Prints the --stats report, and keeps it for --json. */
+static void print_opus_stats(stream_processor *stream, packet_stats *stats,
+        oi_stream_summary *summary)
+{
+    char name[32];
+    int i;
+    double n;
+
+    packet_stats_finish(stats);
+    n = stats->packets ? stats->packets/100. : 1;
+    oi_info(stream->report, _("\tPacket statistics:\n"));
+    for(i=0;i<32;i++) {
+        if(!stats->configs[i])continue;
+        packet_stats_config_name(i, name, sizeof(name));
+        oi_info(stream->report, _("\t  %-16s %10" PRId64 " packets (%5.1f%%)\n"),name,stats->configs[i],stats->configs[i]/n);
+    }
+    oi_info(stream->report, _("\t  %-16s %10" PRId64 " packets (%5.1f%%)\n"),_("Stereo"),stats->stereo,stats->stereo/n);
+    for(i=1;i<49;i++) {
+        if(!stats->frames[i])continue;
+        snprintf(name, sizeof(name), i==1?_("%d frame"):_("%d frames"), i);
+        oi_info(stream->report, _("\t  %-16s %10" PRId64 " packets (%5.1f%%)\n"),name,stats->frames[i],stats->frames[i]/n);
+    }
+    oi_info(stream->report, _("\t  %-16s %10" PRId64 " packets (%5.1f%%)\n"),_("DTX"),stats->dtx,stats->dtx/n);
+    if(stats->empty)oi_info(stream->report, _("\t  %-16s %10" PRId64 " packets\n"),_("Empty"),stats->empty);
+    if(stats->sizes.count)oi_info(stream->report, _("\tPacket size: %d (min), %d (10%%), %d (median), %d (90%%), %d (99%%), %d (max) bytes\n"),
+        stats->sizes.min,value_sketch_quantile(&stats->sizes,.1),value_sketch_quantile(&stats->sizes,.5),
+        value_sketch_quantile(&stats->sizes,.9),value_sketch_quantile(&stats->sizes,.99),stats->sizes.max);
+    if(stats->rates.count)oi_info(stream->report, _("\tBitrate per second: %.4g (min), %.4g (10%%), %.4g (median), %.4g (90%%), %.4g (max) kbit/s\n"),
+        stats->rates.min/1000.,value_sketch_quantile(&stats->rates,.1)/1000.,value_sketch_quantile(&stats->rates,.5)/1000.,
+        value_sketch_quantile(&stats->rates,.9)/1000.,stats->rates.max/1000.);
+    if(summary)summary->stats = packet_stats_json(stats);
+}
+
+/* Keeps what --json reports for the stream. */
+static void summarize_opus(stream_processor *stream,
+        const misc_opus_info *inf, double time, double bitrate)
+{
+    oi_stream_summary *summary = oi_stream(stream->report, stream->num);
+    if(!summary)
+        return;
+    summary->channels = inf->oh.channels;
+    summary->preskip = inf->oh.preskip;
+    summary->input_sample_rate = inf->oh.input_sample_rate;
+    summary->duration = time;
+    summary->bitrate = bitrate;
+}
+
 void info_opus_end(stream_processor *stream)
 {
     misc_opus_info *inf = stream->data;
 
-    oi_info(_("Opus stream %d:\n"),stream->num);
+    oi_info(stream->report, _("Opus stream %d:\n"),stream->num);
 
     if(inf && inf->total_packets>0){
-        int i, j;
         long minutes, seconds, milliseconds;
         double time;
         time = (inf->lastgranulepos-inf->firstgranule-inf->oh.preskip) / 48000.;
         if(time<=0)time=0;
-        minutes = (long)(time) / 60;
-        seconds = (long)(time - minutes*60);
-        milliseconds = (long)((time - minutes*60 - seconds)*1000);
+        split_time(time, &minutes, &seconds, &milliseconds);
         if(inf->lastgranulepos-inf->firstgranule<inf->oh.preskip)
-           oi_error(_("\tERROR: stream %d has a negative duration: %" PRId64 "-%" PRId64 "-%d=%" PRId64 "\n"),stream->num,
+           oi_error(stream->report, "negative_duration", _("\tERROR: stream %d has a negative duration: %" PRId64 "-%" PRId64 "-%d=%" PRId64 "\n"),stream->num,
            inf->lastgranulepos,inf->firstgranule,inf->oh.preskip,inf->lastgranulepos-inf->firstgranule-inf->oh.preskip);
         if((inf->total_samples-inf->last_page_duration)>(inf->lastgranulepos-inf->firstgranule))
-           oi_error(_("\tERROR: stream %d has interior holes or more than one page of end trimming\n"),stream->num);
+           oi_error(stream->report, "interior_holes", _("\tERROR: stream %d has interior holes or more than one page of end trimming\n"),stream->num);
         if(inf->last_eos &&( (inf->last_page_duration-inf->last_packet_duration)>(inf->lastgranulepos-inf->lastlastgranulepos)))
-           oi_warn(_("\tWARNING: stream %d has more than one packet of end trimming\n"),stream->num);
+           oi_warn(stream->report, "end_trimming", _("\tWARNING: stream %d has more than one packet of end trimming\n"),stream->num);
         if(inf->max_page_duration>=240000)
-           oi_warn(_("\tWARNING: stream %d has high muxing delay\n"),stream->num);
-        oi_info(_("\tPre-skip: %d\n"),inf->oh.preskip);
-        oi_info(_("\tPlayback gain: %g dB\n"),inf->oh.gain/256.);
-        oi_info(_("\tChannels: %d\n"),inf->oh.channels);
-        if(inf->oh.input_sample_rate)oi_info(_("\tOriginal sample rate: %d Hz\n"),inf->oh.input_sample_rate);
-        if(inf->oh.nb_streams>1)oi_info(_("\tStreams: %d, Coupled: %d\n"),inf->oh.nb_streams,inf->oh.nb_coupled);
-        if(inf->oh.channel_mapping>0) {
-          oi_info(_("\tChannel Mapping Family: %d"),inf->oh.channel_mapping);
-          if(inf->oh.channel_mapping==3) {
-            oi_info(_("\n"));
-            if(inf->oh.channels*(inf->oh.nb_streams+inf->oh.nb_coupled)*2 <= OPUS_DEMIXING_MATRIX_SIZE_MAX) {
-              oi_info(_("\tDemixing Matrix [%dx%d]:\n"),inf->oh.nb_streams+inf->oh.nb_coupled,inf->oh.channels);
-              for(i=0;i<inf->oh.nb_streams+inf->oh.nb_coupled;i++) {
-                for(j=0;j<inf->oh.channels;j++) {
-                  int k=j*(inf->oh.nb_streams+inf->oh.nb_coupled)+i;
-                  int s=inf->oh.dmatrix[2*k + 1] << 8 | inf->oh.dmatrix[2*k];
-                  s = ((s & 0xFFFF) ^ 0x8000) - 0x8000;
-                  oi_info("%s%6d%s",j==0?"\t[":", ",s,j==inf->oh.channels-1?"]\n":"");
-                }
-              }
-            }
-          }
-          else {
-            oi_info(_(" Map:"));
-            for(i=0;i<inf->oh.channels;i++)oi_info("%s%d%s",i==0?" [":", ",inf->oh.stream_map[i],i==inf->oh.channels-1?"]\n":"");
-          }
-        }
-        if(inf->total_packets)oi_info(_("\tPacket duration: %6.1fms (max), %6.1fms (avg), %6.1fms (min)\n"),
+           oi_warn(stream->report, "muxing_delay", _("\tWARNING: stream %d has high muxing delay\n"),stream->num);
+        print_opus_header(stream, inf);
+        if(inf->total_packets)oi_info(stream->report, _("\tPacket duration: %6.1fms (max), %6.1fms (avg), %6.1fms (min)\n"),
             inf->max_packet_duration/48.,inf->total_samples/(double)inf->total_packets/48.,inf->min_packet_duration/48.);
-        if(inf->total_pages)oi_info(_("\tPage duration: %8.1fms (max), %6.1fms (avg), %6.1fms (min)\n"),
+        if(inf->total_pages)oi_info(stream->report, _("\tPage duration: %8.1fms (max), %6.1fms (avg), %6.1fms (min)\n"),
             inf->max_page_duration/48.,inf->total_samples/(double)inf->total_pages/48.,inf->min_page_duration/48.);
-        oi_info(_("\tTotal data length: %" PRId64 " bytes (overhead: %0.3g%%)\n"),inf->bytes,(double)inf->overhead_bytes/inf->bytes*100.);
-        oi_info(_("\tPlayback length: %ldm:%02ld.%03lds\n"), minutes, seconds, milliseconds);
-        oi_info(_("\tAverage bitrate: %0.4g kbit/s, w/o overhead: %.04g kbit/s%s\n"),time<=0?0:inf->bytes*8/time/1000.0,
+        oi_info(stream->report, _("\tTotal data length: %" PRId64 " bytes (overhead: %0.3g%%)\n"),inf->bytes,(double)inf->overhead_bytes/inf->bytes*100.);
+        oi_info(stream->report, _("\tPlayback length: %ldm:%02ld.%03lds\n"), minutes, seconds, milliseconds);
+        oi_info(stream->report, _("\tAverage bitrate: %0.4g kbit/s, w/o overhead: %.04g kbit/s%s\n"),time<=0?0:inf->bytes*8/time/1000.0,
             time<=0?0:(inf->bytes-inf->overhead_bytes)*8/time/1000.0,
             (inf->min_packet_duration==inf->max_packet_duration)&&(inf->min_packet_bytes==inf->max_packet_bytes)?" (hard-CBR)":"");
+        summarize_opus(stream, inf, time, time<=0?0:inf->bytes*8/time/1000.0);
+        if(inf->stats)print_opus_stats(stream, inf->stats, oi_stream(stream->report, stream->num));
     } else {
-      oi_warn(_("\tWARNING: stream %d is empty\n"),stream->num);
+      oi_warn(stream->report, "empty_stream", _("\tWARNING: stream %d is empty\n"),stream->num);
     }
-    free(stream->data);
+    if(inf)arena_recycle(stream->mem, inf->stats, sizeof(packet_stats));
+    arena_recycle(stream->mem, stream->data, sizeof(misc_opus_info));
+}
+
+int info_opus_timed(stream_processor *stream)
+{
+    misc_opus_info *inf = stream->data;
+    return inf->doneheaders >= 2 && inf->firstgranule != -1;
+}
+
+ogg_int64_t info_opus_start_granule(stream_processor *stream)
+{
+    misc_opus_info *inf = stream->data;
+    return inf->firstgranule + inf->oh.preskip;
+}
+
+void info_opus_quick_end(stream_processor *stream, ogg_int64_t granulepos,
+        ogg_int64_t file_bytes)
+{
+    misc_opus_info *inf = stream->data;
+    long minutes, seconds, milliseconds;
+    double time;
+
+    oi_info(stream->report, _("Opus stream %d:\n"),stream->num);
+
+    if(granulepos > inf->lastgranulepos)
+        inf->lastgranulepos = granulepos;
+    time = (inf->lastgranulepos-inf->firstgranule-inf->oh.preskip) / 48000.;
+    if(time<=0)time=0;
+    split_time(time, &minutes, &seconds, &milliseconds);
+    if(inf->lastgranulepos-inf->firstgranule<inf->oh.preskip)
+       oi_error(stream->report, "negative_duration", _("\tERROR: stream %d has a negative duration: %" PRId64 "-%" PRId64 "-%d=%" PRId64 "\n"),stream->num,
+       inf->lastgranulepos,inf->firstgranule,inf->oh.preskip,inf->lastgranulepos-inf->firstgranule-inf->oh.preskip);
+    print_opus_header(stream, inf);
+    if(file_bytes>=0)oi_info(stream->report, _("\tFile size: %" PRId64 " bytes\n"),file_bytes);
+    oi_info(stream->report, _("\tPlayback length: %ldm:%02ld.%03lds\n"), minutes, seconds, milliseconds);
+    if(file_bytes>=0)oi_info(stream->report, _("\tAverage bitrate: %0.4g kbit/s (from the file size)\n"),
+        time<=0?0:file_bytes*8/time/1000.0);
+    summarize_opus(stream, inf, time,
+        file_bytes<0||time<=0?-1:file_bytes*8/time/1000.0);
+    arena_recycle(stream->mem, inf->stats, sizeof(packet_stats));
+    arena_recycle(stream->mem, stream->data, sizeof(misc_opus_info));
 }
 
 void info_opus_start(stream_processor *stream)
@@ -331,11 +435,15 @@ void info_opus_start(stream_processor *stream)
     stream->process_page = info_opus_process;
     stream->process_end = info_opus_end;
 
-    stream->data = calloc(1, sizeof(misc_opus_info));
+    stream->data = arena_calloc(stream->mem, sizeof(misc_opus_info));
 
     oinfo = stream->data;
     oinfo->firstgranule=-1;
     oinfo->min_packet_duration=5760;
     oinfo->min_page_duration=5760*255;
     oinfo->min_packet_bytes=2147483647;
+    if(oi_want_stats(stream->report)) {
+        oinfo->stats = arena_alloc(stream->mem, sizeof(packet_stats));
+        if(oinfo->stats)packet_stats_init(oinfo->stats);
+    }
 }
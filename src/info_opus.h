@@ -46,6 +46,21 @@ typedef struct {
     int last_eos;
 
     int doneheaders;
+    /* Only with opusinfo --stats. */
+    packet_stats *stats;
 } misc_opus_info;
 
 void info_opus_start(stream_processor *stream);
+
+/* For opusinfo --quick, which only reads the start and the end of a file.
+   info_opus_timed() returns 1 once the headers and the first page with a
+   granule position have been seen, so that the start time is known.
+   info_opus_quick_end() replaces the end of stream report with one based
+   on the last granule position found at the end of the file, and on the
+   size of the file unless file_bytes is negative. */
+int info_opus_timed(stream_processor *stream);
+/* Returns the granule position of the first sample to play, once
+   info_opus_timed() returns 1. */
+ogg_int64_t info_opus_start_granule(stream_processor *stream);
+void info_opus_quick_end(stream_processor *stream, ogg_int64_t granulepos,
+        ogg_int64_t file_bytes);
@@ -0,0 +1,264 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: loss_model.c
+   Seeded packet loss models for opusdec
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opus_types.h>
+
+#if defined WIN32 || defined _WIN32
+# include "unicode_support.h"
+#else
+# define fopen_utf8(_x,_y) fopen((_x),(_y))
+#endif
+
+#include "loss_model.h"
+
+enum {
+   LOSS_BERNOULLI,
+   LOSS_GILBERT_ELLIOTT,
+   LOSS_TRACE
+};
+
+struct loss_model {
+   int type;
+   /* xorshift128 state. */
+   opus_uint32 rng[4];
+   /* Probabilities as fractions. For Bernoulli losses only loss_good is
+      used. */
+   double p;
+   double r;
+   double loss_bad;
+   double loss_good;
+   int bad;
+   unsigned char *trace;
+   size_t trace_len;
+   size_t trace_pos;
+};
+
+static double rng_uniform(loss_model *lm)
+{
+   opus_uint32 *s = lm->rng;
+   opus_uint32 t;
+   t = s[3];
+   t ^= t << 11;
+   t ^= t >> 8;
+   s[3] = s[2];
+   s[2] = s[1];
+   s[1] = s[0];
+   t ^= s[0] ^ (s[0] >> 19);
+   s[0] = t;
+   return t*(1./4294967296.);
+}
+
+static void rng_seed(loss_model *lm, unsigned seed)
+{
+   opus_uint32 x = (opus_uint32)seed;
+   int i;
+   /* Spread the seed over the state so that nearby seeds give unrelated
+      sequences, and the state is never all zero. */
+   for (i = 0; i < 4; i++)
+   {
+      x += 0x9E3779B9U;
+      lm->rng[i] = x;
+      lm->rng[i] = (lm->rng[i] ^ (lm->rng[i] >> 16))*0x85EBCA6BU;
+      lm->rng[i] = (lm->rng[i] ^ (lm->rng[i] >> 13))*0xC2B2AE35U;
+      lm->rng[i] ^= lm->rng[i] >> 16;
+   }
+   if (!(lm->rng[0] | lm->rng[1] | lm->rng[2] | lm->rng[3])) lm->rng[0] = 1;
+}
+
+/* Parses a percentage and the separator after it. Returns the character
+   after the number, or NULL if it is not a number from 0 to 100. */
+static const char *parse_percent(const char *arg, double *val)
+{
+   char *end;
+   *val = strtod(arg, &end);
+   if (end == arg || *val < 0 || *val > 100) return NULL;
+   *val /= 100;
+   return end;
+}
+
+static int load_trace(loss_model *lm, const char *path)
+{
+   FILE *fin;
+   size_t size = 0;
+   int c;
+   fin = fopen_utf8(path, "r");
+   if (!fin)
+   {
+      fprintf(stderr, "Error: cannot open loss trace '%s'.\n", path);
+      return -1;
+   }
+   while ((c = getc(fin)) != EOF)
+   {
+      if (c == '#')
+      {
+         /* Comment to the end of the line. */
+         while ((c = getc(fin)) != EOF && c != '\n');
+         continue;
+      }
+      if (c != '0' && c != '1') continue;
+      if (lm->trace_len == size)
+      {
+         unsigned char *trace;
+         size = size ? 2*size : 4096;
+         trace = realloc(lm->trace, size);
+         if (!trace)
+         {
+            fclose(fin);
+            fprintf(stderr, "Error: out of memory reading loss trace.\n");
+            return -1;
+         }
+         lm->trace = trace;
+      }
+      lm->trace[lm->trace_len++] = c == '1';
+   }
+   fclose(fin);
+   if (lm->trace_len == 0)
+   {
+      fprintf(stderr, "Error: loss trace '%s' has no packets.\n", path);
+      return -1;
+   }
+   return 0;
+}
+
+loss_model *loss_model_create(const char *spec, unsigned seed)
+{
+   loss_model *lm;
+   const char *p;
+   lm = calloc(1, sizeof(*lm));
+   if (!lm) return NULL;
+   rng_seed(lm, seed);
+   if (strncmp(spec, "bernoulli:", 10) == 0)
+   {
+      lm->type = LOSS_BERNOULLI;
+      p = parse_percent(spec + 10, &lm->loss_good);
+      if (!p || *p) goto bad_spec;
+   }
+   else if (strncmp(spec, "ge:", 3) == 0)
+   {
+      lm->type = LOSS_GILBERT_ELLIOTT;
+      lm->loss_bad = 1;
+      p = parse_percent(spec + 3, &lm->p);
+      if (!p || *p++ != ':') goto bad_spec;
+      p = parse_percent(p, &lm->r);
+      if (!p) goto bad_spec;
+      if (*p == ':')
+      {
+         p = parse_percent(p + 1, &lm->loss_bad);
+         if (!p) goto bad_spec;
+         if (*p == ':')
+         {
+            p = parse_percent(p + 1, &lm->loss_good);
+            if (!p) goto bad_spec;
+         }
+      }
+      if (*p || lm->r <= 0) goto bad_spec;
+   }
+   else if (strncmp(spec, "trace:", 6) == 0)
+   {
+      lm->type = LOSS_TRACE;
+      if (load_trace(lm, spec + 6) < 0)
+      {
+         loss_model_destroy(lm);
+         return NULL;
+      }
+   }
+   else goto bad_spec;
+   return lm;
+bad_spec:
+   fprintf(stderr, "Error: invalid loss model '%s'.\n", spec);
+   loss_model_destroy(lm);
+   return NULL;
+}
+
+int loss_model_next(loss_model *lm)
+{
+   int lost;
+   switch (lm->type)
+   {
+      case LOSS_GILBERT_ELLIOTT:
+      {
+         /* The state for this packet is chosen first, so that a burst can
+            start on any packet. */
+         if (rng_uniform(lm) < (lm->bad ? lm->r : lm->p)) lm->bad = !lm->bad;
+         lost = rng_uniform(lm) < (lm->bad ? lm->loss_bad : lm->loss_good);
+         break;
+      }
+      case LOSS_TRACE:
+      {
+         lost = lm->trace[lm->trace_pos++];
+         if (lm->trace_pos == lm->trace_len) lm->trace_pos = 0;
+         break;
+      }
+      default:
+      {
+         lost = rng_uniform(lm) < lm->loss_good;
+         break;
+      }
+   }
+   return lost;
+}
+
+double loss_model_rate(const loss_model *lm)
+{
+   switch (lm->type)
+   {
+      case LOSS_GILBERT_ELLIOTT:
+      {
+         double bad_share;
+         /* Stationary probability of the bad state. */
+         bad_share = lm->p/(lm->p + lm->r);
+         return bad_share*lm->loss_bad + (1 - bad_share)*lm->loss_good;
+      }
+      case LOSS_TRACE:
+      {
+         size_t lost = 0;
+         size_t i;
+         for (i = 0; i < lm->trace_len; i++) lost += lm->trace[i];
+         return (double)lost/lm->trace_len;
+      }
+      default:
+      {
+         return lm->loss_good;
+      }
+   }
+}
+
+void loss_model_destroy(loss_model *lm)
+{
+   if (!lm) return;
+   free(lm->trace);
+   free(lm);
+}
@@ -0,0 +1,59 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: loss_model.h
+   Seeded packet loss models for opusdec
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_LOSS_MODEL_H
+#define OPUSTOOLS_LOSS_MODEL_H
+
+/* Decides which packets opusdec drops when simulating a lossy network.
+   The decisions depend only on the model and the seed, not on the C
+   library, so a run can be reproduced anywhere. */
+typedef struct loss_model loss_model;
+
+/* Creates a model from a specification:
+    bernoulli:P           independent losses with probability P %
+    ge:P:R[:BAD[:GOOD]]   Gilbert-Elliott bursts: P % chance per packet of
+                          going from the good to the bad state and R % of
+                          coming back; packets are lost with BAD % (default
+                          100) in the bad state and GOOD % (default 0) in the
+                          good one
+    trace:FILE            replay FILE, where '1' is a lost packet and '0' a
+                          received one; other characters are ignored and the
+                          trace repeats when it runs out
+   Prints a message and returns NULL if the specification or trace file is
+   invalid. */
+loss_model *loss_model_create(const char *spec, unsigned seed);
+
+/* Returns 1 if the next packet is lost, 0 if it is received. */
+int loss_model_next(loss_model *lm);
+
+/* Returns the long-run fraction of packets the model drops. */
+double loss_model_rate(const loss_model *lm);
+
+void loss_model_destroy(loss_model *lm);
+
+#endif
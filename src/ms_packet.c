@@ -0,0 +1,189 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: ms_packet.c
+   Splitting Opus multistream packets into per-stream packets
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+#include <opus.h>
+
+#include "ms_packet.h"
+
+/* Reads a frame length (RFC 6716 section 3.2.1). Returns the number of
+   bytes it takes, or -1 if the packet is too short. */
+static int parse_size(const unsigned char *data, opus_int32 len,
+   opus_int32 *size)
+{
+   if (len < 1) return -1;
+   if (data[0] < 252)
+   {
+      *size = data[0];
+      return 1;
+   }
+   if (len < 2) return -1;
+   *size = 4*data[1] + data[0];
+   return 2;
+}
+
+/* Works out the total length of a self-delimited packet (RFC 6716
+   appendix B) and where its extra length field is. Returns 0 on success or
+   -1 if the packet is invalid. */
+static int parse_self_delimited(const unsigned char *data, opus_int32 len,
+   opus_int32 *total, opus_int32 *field_pos, int *field_len)
+{
+   opus_int32 pos;
+   opus_int32 frame_bytes;
+   opus_int32 size;
+   opus_int32 last;
+   int n;
+   if (len < 1) return -1;
+   pos = 1;
+   switch (data[0]&0x3)
+   {
+      case 0:
+      case 1:
+      {
+         n = parse_size(data + pos, len - pos, &last);
+         if (n < 0) return -1;
+         *field_pos = pos;
+         *field_len = n;
+         pos += n;
+         frame_bytes = (data[0]&0x3) == 0 ? last : 2*last;
+         break;
+      }
+      case 2:
+      {
+         n = parse_size(data + pos, len - pos, &size);
+         if (n < 0) return -1;
+         pos += n;
+         n = parse_size(data + pos, len - pos, &last);
+         if (n < 0) return -1;
+         *field_pos = pos;
+         *field_len = n;
+         pos += n;
+         frame_bytes = size + last;
+         break;
+      }
+      default:
+      {
+         opus_int32 padding;
+         int count;
+         int vbr;
+         int i;
+         if (len < 2) return -1;
+         count = data[1]&0x3F;
+         vbr = data[1]&0x80;
+         if (count == 0) return -1;
+         pos = 2;
+         padding = 0;
+         if (data[1]&0x40)
+         {
+            int p;
+            do {
+               if (pos >= len) return -1;
+               p = data[pos++];
+               padding += p == 255 ? 254 : p;
+            } while (p == 255);
+         }
+         frame_bytes = padding;
+         if (vbr)
+         {
+            for (i = 0; i < count - 1; i++)
+            {
+               n = parse_size(data + pos, len - pos, &size);
+               if (n < 0) return -1;
+               pos += n;
+               frame_bytes += size;
+            }
+         }
+         n = parse_size(data + pos, len - pos, &last);
+         if (n < 0) return -1;
+         *field_pos = pos;
+         *field_len = n;
+         pos += n;
+         frame_bytes += vbr ? last : count*last;
+         break;
+      }
+   }
+   *total = pos + frame_bytes;
+   return *total <= len ? 0 : -1;
+}
+
+int ms_packet_split(const unsigned char *data, opus_int32 len,
+   int nb_streams, unsigned char *buf, const unsigned char **packets,
+   opus_int32 *sizes)
+{
+   opus_int32 out;
+   int s;
+   if (nb_streams < 1) return OPUS_INVALID_PACKET;
+   out = 0;
+   for (s = 0; s < nb_streams - 1; s++)
+   {
+      opus_int32 total;
+      opus_int32 field_pos;
+      int field_len;
+      if (parse_self_delimited(data, len, &total, &field_pos, &field_len) < 0)
+         return OPUS_INVALID_PACKET;
+      memcpy(buf + out, data, field_pos);
+      memcpy(buf + out + field_pos, data + field_pos + field_len,
+         total - field_pos - field_len);
+      packets[s] = buf + out;
+      sizes[s] = total - field_len;
+      out += sizes[s];
+      data += total;
+      len -= total;
+   }
+   /* The last stream uses standard framing and takes the rest. */
+   if (len <= 0) return OPUS_INVALID_PACKET;
+   packets[s] = data;
+   sizes[s] = len;
+   return 0;
+}
+
+int ms_packet_has_lbrr(const unsigned char *packet, opus_int32 len)
+{
+   const unsigned char *frames[48];
+   opus_int16 sizes[48];
+   int silk_frames;
+   int lbrr;
+   /* CELT-only packets never carry LBRR data. */
+   if (len < 1 || (packet[0]&0x80)) return 0;
+   if (opus_packet_parse(packet, len, NULL, frames, sizes, NULL) <= 0)
+      return 0;
+   if (sizes[0] == 0) return 0;
+   /* The SILK header starts with a VAD flag per 20 ms frame followed by the
+      LBRR flag, for each coded channel, in the first bits of the range
+      coder output. */
+   silk_frames = opus_packet_get_samples_per_frame(packet, 48000)/960;
+   if (silk_frames < 1) silk_frames = 1;
+   lbrr = (frames[0][0] >> (7 - silk_frames))&1;
+   if (opus_packet_get_nb_channels(packet) == 2)
+      lbrr |= (frames[0][0] >> (6 - 2*silk_frames))&1;
+   return lbrr;
+}
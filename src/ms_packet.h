@@ -0,0 +1,50 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: ms_packet.h
+   Splitting Opus multistream packets into per-stream packets
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_MS_PACKET_H
+#define OPUSTOOLS_MS_PACKET_H
+
+#include <opus_types.h>
+
+/* Splits a multistream packet into nb_streams standard Opus packets, so
+   that single streams can be given to opus_decode() on their own. All but
+   the last stream are stored with self-delimited framing; their extra
+   length field is dropped while copying them to buf, which must hold at
+   least len bytes. packets[s] and sizes[s] receive stream s. Returns 0 on
+   success or OPUS_INVALID_PACKET. */
+int ms_packet_split(const unsigned char *data, opus_int32 len,
+   int nb_streams, unsigned char *buf, const unsigned char **packets,
+   opus_int32 *sizes);
+
+/* Returns 1 if the first frame of a standard Opus packet carries LBRR
+   (in-band forward error correction) data for the frame before it, so that
+   opus_decode() with decode_fec set can rebuild that frame instead of
+   concealing it, and 0 otherwise. */
+int ms_packet_has_lbrr(const unsigned char *packet, opus_int32 len);
+
+#endif
@@ -0,0 +1,242 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: opus_index.c
+   Seek indexes of Ogg Opus files
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "opus_index.h"
+
+static const char magic[8] = {'O', 'p', 'u', 's', 'I', 'd', 'x',
+   OPUS_INDEX_VERSION};
+
+opus_index *opus_index_create(int interval_ms)
+{
+   opus_index *index = calloc(1, sizeof(*index));
+   if (index) index->interval_ms = interval_ms;
+   return index;
+}
+
+void opus_index_free(opus_index *index)
+{
+   int i;
+   if (!index) return;
+   for (i = 0; i < index->nlinks; i++) free(index->links[i].entries);
+   free(index->links);
+   free(index);
+}
+
+int opus_index_add_link(opus_index *index, ogg_uint32_t serial,
+   ogg_int64_t offset)
+{
+   opus_index_link *link;
+   if (index->nlinks == index->allocated)
+   {
+      int allocated = index->allocated ? 2*index->allocated : 4;
+      opus_index_link *links = realloc(index->links,
+         sizeof(*links)*allocated);
+      if (!links) return -1;
+      index->links = links;
+      index->allocated = allocated;
+   }
+   link = &index->links[index->nlinks];
+   memset(link, 0, sizeof(*link));
+   link->serial = serial;
+   link->start_granule = -1;
+   link->last_granule = 0;
+   link->offset = offset;
+   return index->nlinks++;
+}
+
+int opus_index_add_entry(opus_index *index, int link,
+   ogg_int64_t granulepos, ogg_int64_t offset)
+{
+   opus_index_link *l = &index->links[link];
+   if (l->nentries == l->allocated)
+   {
+      int allocated = l->allocated ? 2*l->allocated : 64;
+      opus_index_entry *entries = realloc(l->entries,
+         sizeof(*entries)*allocated);
+      if (!entries) return -1;
+      l->entries = entries;
+      l->allocated = allocated;
+   }
+   l->entries[l->nentries].granulepos = granulepos;
+   l->entries[l->nentries].offset = offset;
+   l->nentries++;
+   return 0;
+}
+
+static void put32(unsigned char *buf, ogg_uint32_t value)
+{
+   buf[0] = value & 0xFF;
+   buf[1] = value >> 8 & 0xFF;
+   buf[2] = value >> 16 & 0xFF;
+   buf[3] = value >> 24 & 0xFF;
+}
+
+static void put64(unsigned char *buf, ogg_int64_t value)
+{
+   put32(buf, (ogg_uint32_t)((ogg_uint64_t)value & 0xFFFFFFFF));
+   put32(buf + 4, (ogg_uint32_t)((ogg_uint64_t)value >> 32));
+}
+
+static ogg_uint32_t get32(const unsigned char *buf)
+{
+   return (ogg_uint32_t)buf[0] | (ogg_uint32_t)buf[1] << 8
+      | (ogg_uint32_t)buf[2] << 16 | (ogg_uint32_t)buf[3] << 24;
+}
+
+static ogg_int64_t get64(const unsigned char *buf)
+{
+   return (ogg_int64_t)((ogg_uint64_t)get32(buf)
+      | (ogg_uint64_t)get32(buf + 4) << 32);
+}
+
+int opus_index_write(const opus_index *index, FILE *file)
+{
+   unsigned char buf[40];
+   int i, j;
+   memcpy(buf, magic, 8);
+   put32(buf + 8, index->interval_ms);
+   put32(buf + 12, index->nlinks);
+   if (fwrite(buf, 1, 16, file) != 16) return -1;
+   for (i = 0; i < index->nlinks; i++)
+   {
+      const opus_index_link *link = &index->links[i];
+      put32(buf, link->serial);
+      put32(buf + 4, 0);
+      put64(buf + 8, link->start_granule);
+      put64(buf + 16, link->last_granule);
+      put64(buf + 24, link->offset);
+      put32(buf + 32, link->nentries);
+      put32(buf + 36, 0);
+      if (fwrite(buf, 1, 40, file) != 40) return -1;
+      for (j = 0; j < link->nentries; j++)
+      {
+         put64(buf, link->entries[j].granulepos);
+         put64(buf + 8, link->entries[j].offset);
+         if (fwrite(buf, 1, 16, file) != 16) return -1;
+      }
+   }
+   return fflush(file) == 0 ? 0 : -1;
+}
+
+opus_index *opus_index_read(FILE *file)
+{
+   unsigned char buf[40];
+   opus_index *index;
+   ogg_uint32_t nlinks;
+   int i, j;
+   if (fread(buf, 1, 16, file) != 16 || memcmp(buf, magic, 8) != 0)
+      return NULL;
+   nlinks = get32(buf + 12);
+   if (nlinks > 0x7FFFFFFF) return NULL;
+   index = opus_index_create(get32(buf + 8));
+   if (!index) return NULL;
+   for (i = 0; i < (int)nlinks; i++)
+   {
+      opus_index_link *link;
+      ogg_uint32_t nentries;
+      int l;
+      if (fread(buf, 1, 40, file) != 40) break;
+      l = opus_index_add_link(index, get32(buf), get64(buf + 24));
+      if (l < 0) break;
+      link = &index->links[l];
+      link->start_granule = get64(buf + 8);
+      link->last_granule = get64(buf + 16);
+      nentries = get32(buf + 32);
+      if (nentries > 0x7FFFFFFF) break;
+      for (j = 0; j < (int)nentries; j++)
+      {
+         ogg_int64_t granulepos;
+         ogg_int64_t offset;
+         if (fread(buf, 1, 16, file) != 16) break;
+         granulepos = get64(buf);
+         offset = get64(buf + 8);
+         if (j > 0 && (granulepos < link->entries[j-1].granulepos
+               || offset <= link->entries[j-1].offset)) break;
+         if (opus_index_add_entry(index, l, granulepos, offset) != 0) break;
+      }
+      if (j < (int)nentries) break;
+   }
+   if (i < (int)nlinks)
+   {
+      opus_index_free(index);
+      return NULL;
+   }
+   return index;
+}
+
+int opus_index_seek(const opus_index *index, double seconds, int *link,
+   ogg_int64_t *offset, ogg_int64_t *granulepos)
+{
+   ogg_int64_t target = (ogg_int64_t)(seconds*48000);
+   int i;
+   if (target < 0) target = 0;
+   for (i = 0; i < index->nlinks; i++)
+   {
+      const opus_index_link *l = &index->links[i];
+      ogg_int64_t length = l->last_granule - l->start_granule;
+      int lo, hi;
+      if (l->start_granule < 0 || length < 0) length = 0;
+      if (target >= length && i < index->nlinks - 1)
+      {
+         target -= length;
+         continue;
+      }
+      if (target > length) return -1;
+      /* The last entry that starts at least the pre-roll before the
+         target, or the start of the link if there is none. */
+      target += l->start_granule - OPUS_INDEX_PREROLL;
+      lo = 0;
+      hi = l->nentries;
+      while (lo < hi)
+      {
+         int mid = lo + (hi - lo)/2;
+         if (l->entries[mid].granulepos <= target) lo = mid + 1;
+         else hi = mid;
+      }
+      *link = i;
+      if (lo > 0)
+      {
+         *offset = l->entries[lo-1].offset;
+         *granulepos = l->entries[lo-1].granulepos;
+      }
+      else
+      {
+         *offset = l->offset;
+         *granulepos = -1;
+      }
+      return 0;
+   }
+   return -1;
+}
@@ -0,0 +1,106 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: opus_index.h
+   Seek indexes of Ogg Opus files
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_OPUS_INDEX_H
+#define OPUSTOOLS_OPUS_INDEX_H
+
+#include <stdio.h>
+#include <ogg/ogg.h>
+
+/* A seek index, as written by opusinfo --write-index, lets a player find
+   where to read for any time in an Ogg Opus file with one lookup in the
+   index and one read of the file, instead of bisecting it.
+
+   The file holds, all little-endian:
+    "OpusIdx" and a version byte of 1
+    u32 interval in milliseconds, u32 number of links
+   then for each link, in the order of the file:
+    u32 serial number, u32 reserved (0)
+    i64 granule position of the first sample to play (after pre-skip),
+        or -1 if the link has no audio
+    i64 granule position of the last page
+    u64 byte offset of the first page of the link, where its headers are
+    u32 number of entries, u32 reserved (0)
+   then the entries of the link, each 16 bytes:
+    i64 granule position at the start of a page, that is the granule
+        position of the page before it in the same stream
+    u64 byte offset of the page, which starts a new packet
+   The entries are about one interval of audio apart, in increasing
+   order of both fields. */
+
+#define OPUS_INDEX_VERSION (1)
+/* Opus needs 80 ms of audio decoded before a seek point to converge. */
+#define OPUS_INDEX_PREROLL (3840)
+
+typedef struct {
+   ogg_int64_t granulepos;
+   ogg_int64_t offset;
+} opus_index_entry;
+
+typedef struct {
+   ogg_uint32_t serial;
+   ogg_int64_t start_granule;
+   ogg_int64_t last_granule;
+   ogg_int64_t offset;
+   opus_index_entry *entries;
+   int nentries;
+   int allocated;
+} opus_index_link;
+
+typedef struct {
+   int interval_ms;
+   opus_index_link *links;
+   int nlinks;
+   int allocated;
+} opus_index;
+
+opus_index *opus_index_create(int interval_ms);
+void opus_index_free(opus_index *index);
+/* Adds a link whose first page is at offset. Returns its number, or -1 if
+   out of memory. */
+int opus_index_add_link(opus_index *index, ogg_uint32_t serial,
+   ogg_int64_t offset);
+/* Returns 0, or -1 if out of memory. */
+int opus_index_add_entry(opus_index *index, int link,
+   ogg_int64_t granulepos, ogg_int64_t offset);
+/* Return 0 on success, or -1 on a read or write error, or if the file is
+   not a valid index. */
+int opus_index_write(const opus_index *index, FILE *file);
+opus_index *opus_index_read(FILE *file);
+
+/* Finds where to read to play from the given time, counted from the start
+   of the first link, assuming the links follow one another. Sets *link to
+   the link, and *offset and *granulepos to the page to read from and the
+   granule position of its start, which is at least the pre-roll before the
+   time wanted, or to the start of the link and -1 if there is no such
+   entry. The headers of the link are at index->links[*link].offset.
+   Returns 0, or -1 if the time is past the end of the last link. */
+int opus_index_seek(const opus_index *index, double seconds, int *link,
+   ogg_int64_t *offset, ogg_int64_t *granulepos);
+
+#endif
@@ -46,6 +46,12 @@
 # include <inttypes.h>
 #endif
 
+#ifdef _MSC_VER
+# if (_MSC_VER < 1900)
+#  define snprintf _snprintf
+# endif
+#endif
+
 #include <opus.h>
 #include <opusfile.h>
 
@@ -107,6 +113,15 @@
 #include "speex_resampler.h"
 #include "stack_alloc.h"
 #include "cpusupport.h"
+#include "pcm_kernels.h"
+#include "output_sink.h"
+#include "ms_packet.h"
+#include "loss_model.h"
+#include "validate.h"
+#include "bench_clock.h"
+#include "follow.h"
+#include "picture.h"
+#include "text_kernels.h"
 
 /* printf format specifier for opus_int64 */
 #if !defined opus_int64 && defined PRId64
@@ -128,104 +143,6 @@
 struct sio_hdl *hdl;
 #endif
 
-typedef struct shapestate shapestate;
-struct shapestate {
-  float * b_buf;
-  float * a_buf;
-  int fs;
-  int mute;
-};
-
-static unsigned int rngseed = 22222;
-static inline unsigned int fast_rand(void)
-{
-  rngseed = (rngseed * 96314165) + 907633515;
-  return rngseed;
-}
-
-#ifndef HAVE_FMINF
-# define fminf(_x,_y) ((_x)<(_y)?(_x):(_y))
-#endif
-
-#ifndef HAVE_FMAXF
-# define fmaxf(_x,_y) ((_x)>(_y)?(_x):(_y))
-#endif
-
-/* This implements a 16 bit quantization with full triangular dither
-   and IIR noise shaping. The noise shaping filters were designed by
-   Sebastian Gesemann based on the LAME ATH curves with flattening
-   to limit their peak gain to 20 dB.
-   (Everyone elses' noise shaping filters are mildly crazy)
-   The 48kHz version of this filter is just a warped version of the
-   44.1kHz filter and probably could be improved by shifting the
-   HF shelf up in frequency a little bit since 48k has a bit more
-   room and being more conservative against bat-ears is probably
-   more important than more noise suppression.
-   This process can increase the peak level of the signal (in theory
-   by the peak error of 1.5 +20 dB though this much is unobservable rare)
-   so to avoid clipping the signal is attenuated by a couple thousandths
-   of a dB. Initially the approach taken here was to only attenuate by
-   the 99.9th percentile, making clipping rare but not impossible (like
-   SoX) but the limited gain of the filter means that the worst case was
-   only two thousandths of a dB more, so this just uses the worst case.
-   The attenuation is probably also helpful to prevent clipping in the DAC
-   reconstruction filters or downstream resampling in any case.*/
-static inline void shape_dither_toshort(shapestate *_ss, short *_o, float *_i, int _n, int _CC)
-{
-  const float gains[3]={32768.f-15.f,32768.f-15.f,32768.f-3.f};
-  const float fcoef[3][8] =
-  {
-    {2.2374f, -.7339f, -.1251f, -.6033f, 0.9030f, .0116f, -.5853f, -.2571f}, /* 48.0kHz noise shaping filter sd=2.34*/
-    {2.2061f, -.4706f, -.2534f, -.6214f, 1.0587f, .0676f, -.6054f, -.2738f}, /* 44.1kHz noise shaping filter sd=2.51*/
-    {1.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f,0.0000f, 0.0000f, 0.0000f}, /* lowpass noise shaping filter sd=0.65*/
-  };
-  int i;
-  int rate=_ss->fs==44100?1:(_ss->fs==48000?0:2);
-  float gain=gains[rate];
-  float *b_buf;
-  float *a_buf;
-  int mute=_ss->mute;
-  b_buf=_ss->b_buf;
-  a_buf=_ss->a_buf;
-  /*In order to avoid replacing digital silence with quiet dither noise
-    we mute if the output has been silent for a while*/
-  if(mute>64)
-    memset(a_buf,0,sizeof(float)*_CC*4);
-  for(i=0;i<_n;i++)
-  {
-    int c;
-    int pos = i*_CC;
-    int silent=1;
-    for(c=0;c<_CC;c++)
-    {
-      int j, si;
-      float r,s,err=0;
-      silent&=_i[pos+c]==0;
-      s=_i[pos+c]*gain;
-      for(j=0;j<4;j++)
-        err += fcoef[rate][j]*b_buf[c*4+j] - fcoef[rate][j+4]*a_buf[c*4+j];
-      memmove(&a_buf[c*4+1],&a_buf[c*4],sizeof(float)*3);
-      memmove(&b_buf[c*4+1],&b_buf[c*4],sizeof(float)*3);
-      a_buf[c*4]=err;
-      s = s - err;
-      r=(float)fast_rand()*(1/(float)UINT_MAX) - (float)fast_rand()*(1/(float)UINT_MAX);
-      if (mute>16)r=0;
-      /*Clamp in float out of paranoia that the input will be >96 dBFS and wrap if the
-        integer is clamped.*/
-      _o[pos+c] = si = float2int(fmaxf(-32768,fminf(s + r,32767)));
-      /*Including clipping in the noise shaping is generally disastrous:
-        the futile effort to restore the clipped energy results in more clipping.
-        However, small amounts-- at the level which could normally be created by
-        dither and rounding-- are harmless and can even reduce clipping somewhat
-        due to the clipping sometimes reducing the dither+rounding error.*/
-      b_buf[c*4] = (mute>16)?0:fmaxf(-1.5f,fminf(si - s,1.5f));
-    }
-    mute++;
-    if(!silent)mute=0;
-  }
-  _ss->mute=MINI(mute,960);
-}
-
 static void print_comments(const OpusTags *_tags)
 {
    int i;
@@ -236,9 +153,10 @@ static void print_comments(const OpusTags *_tags)
       char *comment;
       comment=_tags->user_comments[i];
       if (opus_tagncompare("METADATA_BLOCK_PICTURE",22,comment)==0) {
-         OpusPictureTag pic;
-         int            err;
-         err=opus_picture_tag_parse(&pic, comment);
+         /* Only the header of the picture is decoded, not the image. */
+         picture_tag pic;
+         int         err;
+         err=picture_tag_parse(&pic, comment);
          fprintf(stderr, "%.23s", comment);
          if (err<0) {
             fprintf(stderr, "<error parsing picture tag>\n");
@@ -248,18 +166,16 @@ static void print_comments(const OpusTags *_tags)
             if (pic.colors != 0) {
                fprintf(stderr, "/%u", pic.colors);
             }
-            if (pic.format==OP_PIC_FORMAT_URL) {
-               fprintf(stderr, "|%s\n", pic.data);
+            if (pic.is_url) {
+               fprintf(stderr, "|%s\n", pic.url);
             } else {
-               static const char *pic_format_str[4] = {
-                  "image", "JPEG", "PNG", "GIF"
+               static const char *pic_format_str[3] = {
+                  "JPEG", "PNG", "GIF"
                };
-               int format_idx;
-               format_idx = pic.format < 1 || pic.format >= 4 ? 0 : pic.format;
                fprintf(stderr, "|<%u bytes of %s data>\n", pic.data_length,
-                pic_format_str[format_idx]);
+                pic.format < 0 ? "image" : pic_format_str[pic.format]);
             }
-            opus_picture_tag_clear(&pic);
+            picture_tag_clear(&pic);
          }
       } else {
          fprintf(stderr, "%s\n", comment);
@@ -269,7 +185,8 @@ static void print_comments(const OpusTags *_tags)
 
 /* Returns 1 on success, 0 on error with message displayed on stderr. */
 static int out_file_open(const char *outFile, int *wav_format, int rate,
-    int mapping_family, int *channels, int fp, FILE **fout)
+    int mapping_family, int *channels, int fp, opus_int64 audio_size,
+    FILE **fout)
 {
    /* Open output file or audio playback device. */
    if (!outFile)
@@ -429,7 +346,8 @@ static int out_file_open(const char *outFile, int *wav_format, int rate,
       }
       if (*wav_format)
       {
-         *wav_format = write_wav_header(*fout, rate, mapping_family, *channels, fp);
+         *wav_format = write_wav_header(*fout, rate, mapping_family,
+          *channels, fp, audio_size);
          if (*wav_format < 0)
          {
             fprintf(stderr, "Error writing WAV header.\n");
@@ -451,6 +369,8 @@ void usage(void)
 #else
    printf("Usage: opusdec [options] input output\n");
 #endif
+   printf("       opusdec --validate [--jobs n] input [input ...]\n");
+   printf("       opusdec --bench [--repeat n] input\n");
    printf("\n");
    printf("Decode audio in Opus format to Wave or raw PCM\n");
    printf("\n");
@@ -474,13 +394,47 @@ void usage(void)
    printf(" -V, --version         Show version information\n");
    printf(" --quiet               Suppress program output\n");
    printf(" --rate n              Force decoding at sampling rate n Hz\n");
+   printf(" --resample-quality n  Resampler quality 0-10 (default 5), or one of\n");
+   printf("                         fast (3), default (5), high (7), best (10)\n");
    printf(" --force-stereo        Force decoding to stereo\n");
+   printf(" --channels list       Only decode the listed channels, e.g. 0 or 2,3\n");
+   printf(" --streams list        Only decode the listed elementary streams\n");
    printf(" --gain n              Adjust output volume n dB (negative is quieter)\n");
    printf(" --no-dither           Do not dither 16-bit output\n");
    printf(" --float               Output 32-bit floating-point samples\n");
    printf(" --force-wav           Force Wave header on output\n");
+   printf(" --planar              Write raw output in blocks of 16384 samples\n");
+   printf("                         per channel instead of interleaved\n");
+   printf(" --split-channels      Write each channel to its own mono file,\n");
+   printf("                         named output-0.wav, output-1.wav, ...\n");
+   printf(" --output r:c:f:file   Also write the audio to file, resampled to r Hz\n");
+   printf("                         with c channels in format f (s16 or float).\n");
+   printf("                         Empty fields keep the defaults, e.g. 16000:1::a.wav.\n");
+   printf("                         May be used multiple times; the output argument\n");
+   printf("                         is then optional\n");
+   printf(" --threads             Write each --output in its own thread\n");
    printf(" --packet-loss n       Simulate n %% random packet loss\n");
+   printf(" --loss-model spec     Simulate packet loss with a model:\n");
+   printf("                         bernoulli:P (random, P %%),\n");
+   printf("                         ge:P:R[:BAD[:GOOD]] (Gilbert-Elliott bursts)\n");
+   printf("                         or trace:file (replay 0/1 per packet)\n");
+   printf(" --loss-seed n         Seed for the random loss models (default 0)\n");
+   printf(" --fec                 Rebuild lost packets from the forward error\n");
+   printf("                         correction in the packet after them; needs\n");
+   printf("                         --packet-loss or --loss-model\n");
+   printf(" --follow              Keep reading an input file that is still being\n");
+   printf("                         written, for live monitoring\n");
+   printf(" --follow-timeout n    Stop following after n seconds without new data\n");
+   printf("                         (default 10, 0 waits forever)\n");
+   printf(" --follow-sentinel f   Stop following once the file f exists\n");
    printf(" --save-range file     Save check values for every frame to a file\n");
+   printf(" --validate            Decode each input without writing any output and\n");
+   printf("                         report holes, bad packets and length errors\n");
+   printf(" --jobs n              Validate up to n inputs at once (default 1)\n");
+   printf(" --bench               Decode the input from memory to a null output and\n");
+   printf("                         report the time spent in each stage\n");
+   printf(" --repeat n            Decode the input n times with --bench\n");
+   printf(" --cpu-info            Show the detected CPU features and kernels\n");
    printf("\n");
 }
 
@@ -495,9 +449,117 @@ void version_short(void)
    version();
 }
 
+/*Presets for --resample-quality, picked from the resample_bench table:
+  fast is the cheapest level that is flat to 0.02 dB over 80% of the band
+  with ~90 dB rejection, high is the cheapest that stays flat to 90%, and
+  best switches to double precision accumulation for ~125 dB.*/
+static const struct {
+   const char *name;
+   int quality;
+} resample_presets[] = {
+   {"fast", 3},
+   {"default", 5},
+   {"high", 7},
+   {"best", 10}
+};
+
+static int parse_resample_quality(const char *arg)
+{
+   char *end;
+   long quality;
+   size_t i;
+   for (i=0;i<sizeof(resample_presets)/sizeof(resample_presets[0]);i++)
+   {
+      if (strcmp(arg,resample_presets[i].name)==0)
+         return resample_presets[i].quality;
+   }
+   quality=strtol(arg,&end,10);
+   if (end==arg || *end || quality<0 || quality>10) return -1;
+   return (int)quality;
+}
+
+static void print_cpu_info(void)
+{
+   cpu_print_info(stdout);
+   printf("Kernels:\n");
+   pcm_kernels_print_info(stdout);
+   text_kernels_print_info(stdout);
+   printf("  resampler:       %s\n", speex_resampler_get_kernel_name());
+}
+
+/*Time spent in each stage with --bench. The time since the last mark is
+  added to the named stage.*/
+typedef struct {
+   double mark;
+   double decode;
+   double resample;
+   double convert;
+   double output;
+} bench_times;
+
+static bench_times *bench=NULL;
+
+#define BENCH_MARK(_stage) \
+   do { \
+      if (bench) { \
+         double bench_now=bench_clock(); \
+         bench->_stage+=bench_now-bench->mark; \
+         bench->mark=bench_now; \
+      } \
+   } while (0)
+
+/*Converts n frames straight into the planar blocks, deinterleaving in the
+  same pass. Returns the number of frames written.*/
+static int planar_write(pcm_planar *planar, const float *in, int n,
+ int channels, int fp, shapestate *shapemem)
+{
+   int offsets[255];
+   int done=0;
+   int c;
+   for (c=0;c<channels;c++)
+      offsets[planar->map[c]]=c*PCM_PLANAR_BLOCK;
+   while (done<n)
+   {
+      int count;
+      void *dst=pcm_planar_buffer(planar, &count);
+      const float *src=in+done*channels;
+      if (count>n-done) count=n-done;
+      if (fp) {
+         int i;
+         for (c=0;c<channels;c++)
+         {
+            float *o=(float *)dst+offsets[c];
+            for (i=0;i<count;i++)
+               put_le_float(o+i, src[i*channels+c]);
+         }
+      } else {
+         if (shapemem) {
+            pcm_kernels()->shape_dither(shapemem,(short *)dst,src,count,
+             channels,offsets);
+         } else {
+            float_to_short_planar((short *)dst,src,count,channels,offsets);
+         }
+         if (le_short(1)!=(1)) {
+            int i;
+            for (c=0;c<channels;c++)
+            {
+               short *o=(short *)dst+offsets[c];
+               for (i=0;i<count;i++)
+                  o[i]=le_short(o[i]);
+            }
+         }
+      }
+      if (pcm_planar_commit(planar, count)<0) break;
+      done+=count;
+   }
+   return done;
+}
+
 opus_int64 audio_write(float *pcm, int channels, int frame_size, FILE *fout,
- SpeexResamplerState *resampler, float *clipmem, shapestate *shapemem,
- int file, int rate, opus_int64 link_read, opus_int64 link_out, int fp)
+ pcm_prealloc *prealloc, pcm_planar *planar,
+ SpeexResamplerState *resampler, float *clipmem,
+ shapestate *shapemem, int file, int rate, opus_int64 link_read,
+ opus_int64 link_out, int fp)
 {
    opus_int64 sampout=0;
    opus_int64 maxout;
@@ -521,13 +583,21 @@ opus_int64 audio_write(float *pcm, int channels, int frame_size, FILE *fout,
         pcm, &in_len, buf, &out_len);
        pcm += channels*(in_len);
        frame_size -= in_len;
+       BENCH_MARK(resample);
      } else {
        output=pcm;
        out_len=frame_size<maxout?(unsigned)frame_size:(unsigned)maxout;
        frame_size=0;
      }
 
-     if (!file||!fp)
+     if (planar)
+     {
+        /*The samples are converted as they are written out below.*/
+#if defined(HAVE_SOFT_CLIP)
+        if (!fp) opus_pcm_soft_clip(output,out_len,channels,clipmem);
+#endif
+     }
+     else if (!file||!fp)
      {
         /*Convert to short and save to output file*/
 #if defined(HAVE_SOFT_CLIP)
@@ -536,10 +606,10 @@ opus_int64 audio_write(float *pcm, int channels, int frame_size, FILE *fout,
         (void)clipmem;
 #endif
         if (shapemem) {
-          shape_dither_toshort(shapemem,out,output,out_len,channels);
+          pcm_kernels()->shape_dither(shapemem,out,output,out_len,channels,
+           NULL);
         } else {
-          for (i=0;i<(int)out_len*channels;i++)
-            out[i]=(short)float2int(fmaxf(-32768,fminf(output[i]*32768.f,32767)));
+          pcm_kernels()->float_to_short(out,output,out_len*channels);
         }
         if ((le_short(1)!=(1))&&file) {
           for (i=0;i<(int)out_len*channels;i++)
@@ -552,6 +622,7 @@ opus_int64 audio_write(float *pcm, int channels, int frame_size, FILE *fout,
          put_le_float(buf+i, output[i]);
        output = buf;
      }
+     BENCH_MARK(convert);
 
      if (maxout>0)
      {
@@ -568,62 +639,380 @@ opus_int64 audio_write(float *pcm, int channels, int frame_size, FILE *fout,
          else fprintf(stderr, "Error playing audio.\n");
        } else
 #endif
+       if (bench) {
+         /*--bench writes to a null sink.*/
+         ret=out_len;
+       } else if (planar) {
+         ret=planar_write(planar, output, out_len, channels, fp, shapemem);
+       } else if (prealloc) {
+         ret=pcm_prealloc_write(prealloc, fp?(char *)output:(char *)out,
+          (fp?sizeof(float):sizeof(short))*channels, out_len);
+       } else {
          ret=fwrite(fp?(char *)output:(char *)out,
           (fp?sizeof(float):sizeof(short))*channels, out_len, fout);
+       }
        sampout+=ret;
        maxout-=ret;
+       BENCH_MARK(output);
      }
    } while (frame_size>0 && maxout>0);
    return sampout;
 }
 
+/*Parses a comma-separated list of channel or stream numbers. Returns the
+  number of entries, or -1 if the list is invalid.*/
+static int parse_index_list(const char *arg, int *list, int max)
+{
+   int n=0;
+   for (;;)
+   {
+      char *end;
+      long val;
+      val=strtol(arg,&end,10);
+      if (end==arg || val<0 || val>=max || n>=max) return -1;
+      list[n++]=(int)val;
+      if (*end=='\0') return n;
+      if (*end!=',') return -1;
+      arg=end+1;
+   }
+}
+
+/*Returns the elementary stream that a channel mapping entry refers to.*/
+static int mapping_stream(const OpusHead *head, int m)
+{
+   return m<2*head->coupled_count?m/2:m-head->coupled_count;
+}
+
+/*Works out, for one link, which input channels make up the output of
+  --channels or --streams (in map), and which elementary streams have to be
+  decoded for them (in decode). Returns the number of output channels, or
+  -1 if the list does not fit the link.*/
+static int select_channels(const int *list, int nlist, int by_stream,
+ const OpusHead *head, unsigned char *map, unsigned char *decode)
+{
+   int nmap=0;
+   int ci;
+   int i;
+   memset(decode, 0, OPUS_CHANNEL_COUNT_MAX);
+   if (by_stream)
+   {
+      for (i=0;i<nlist;i++)
+      {
+         if (list[i]>=head->stream_count) return -1;
+         decode[list[i]]=1;
+      }
+      for (ci=0;ci<head->channel_count;ci++)
+      {
+         int m=head->mapping[ci];
+         if (m!=255 && decode[mapping_stream(head, m)]) map[nmap++]=ci;
+      }
+   } else {
+      for (i=0;i<nlist;i++)
+      {
+         int m;
+         if (list[i]>=head->channel_count) return -1;
+         map[nmap++]=list[i];
+         m=head->mapping[list[i]];
+         if (m!=255) decode[mapping_stream(head, m)]=1;
+      }
+   }
+   return nmap>0?nmap:-1;
+}
+
+/*A copy of one packet, kept by the --fec lookahead.*/
+typedef struct {
+   unsigned char *data;
+   opus_int32 len;
+   opus_int32 size;
+   ogg_int64_t packetno;
+   opus_int64 index;
+   int e_o_s;
+   int li;
+} held_packet;
+
+/*What happened to a packet when simulating loss.*/
+enum {
+   PACKET_DECODED,
+   PACKET_RECOVERED,
+   PACKET_CONCEALED,
+   PACKET_OUTCOMES
+};
+
 typedef struct decode_cb_ctx decode_cb_ctx;
 struct decode_cb_ctx {
    FILE *frange;
-   float loss_percent;
+   loss_model *loss;
+   /*Packets are numbered in decoding order, so that a loss decided early
+     for the --fec lookahead is applied to the right packet.*/
+   opus_int64 packet_index;
+   opus_int64 decided_index;
+   int decided_lost;
+   /*Packets and time spent in the decoder for each outcome.*/
+   opus_int64 nb_packets[PACKET_OUTCOMES];
+   double decode_time[PACKET_OUTCOMES];
+   /*--fec: a second handle on the same input runs one packet ahead of the
+     decoder, so that a lost packet can be rebuilt from the in-band forward
+     error correction carried by the packet after it.*/
+   OggOpusFile *peek;
+   held_packet next;
+   /*--channels or --streams: only the selected streams are decoded.*/
+   OggOpusFile *of;
+   const int *select_list;
+   int nselect;
+   int select_streams;
+   int select_li;
+   unsigned char decode[OPUS_CHANNEL_COUNT_MAX];
+   unsigned char *packet_buf;
+   opus_int32 packet_buf_size;
+   float stream_pcm[MAX_FRAME_SIZE*2];
 };
 
+/*Splits a multistream packet into one packet per elementary stream, in
+  ctx->packet_buf.*/
+static int split_packet(decode_cb_ctx *ctx, const OpusHead *head,
+ const unsigned char *data, opus_int32 len, const unsigned char **packets,
+ opus_int32 *sizes)
+{
+   if (len>ctx->packet_buf_size)
+   {
+      unsigned char *buf;
+      buf=realloc(ctx->packet_buf, len);
+      if (!buf) return OPUS_ALLOC_FAIL;
+      ctx->packet_buf=buf;
+      ctx->packet_buf_size=len;
+   }
+   return ms_packet_split(data, len, head->stream_count, ctx->packet_buf,
+    packets, sizes);
+}
+
+/*Brings the selected channel list up to date for link li.*/
+static int update_selection(decode_cb_ctx *ctx, const OpusHead *head, int li)
+{
+   if (li!=ctx->select_li)
+   {
+      unsigned char map[OPUS_CHANNEL_COUNT_MAX];
+      if (select_channels(ctx->select_list, ctx->nselect,
+           ctx->select_streams, head, map, ctx->decode)<0)
+         return OPUS_BAD_ARG;
+      ctx->select_li=li;
+   }
+   return 0;
+}
+
+/*Decodes only the elementary streams that feed the selected channels,
+  using the per-stream decoders inside the multistream decoder. The other
+  channels are left silent. Returns the number of samples decoded or an
+  error, like opus_multistream_decode().*/
+static int decode_selected(decode_cb_ctx *ctx, OpusMSDecoder *decoder,
+ void *pcm, const unsigned char *data, opus_int32 len, int nsamples,
+ int nchannels, int format, int li, int decode_fec)
+{
+   const OpusHead *head;
+   const unsigned char *packets[OPUS_CHANNEL_COUNT_MAX];
+   opus_int32 sizes[OPUS_CHANNEL_COUNT_MAX];
+   int si;
+   if (nsamples>MAX_FRAME_SIZE) return OPUS_BUFFER_TOO_SMALL;
+   head=op_head(ctx->of, li);
+   if (update_selection(ctx, head, li)<0) return OPUS_BAD_ARG;
+   if (data)
+   {
+      int ret;
+      ret=split_packet(ctx, head, data, len, packets, sizes);
+      if (ret<0) return ret;
+   }
+   memset(pcm, 0, (format==OP_DEC_FORMAT_SHORT?sizeof(opus_int16):
+    sizeof(float))*nsamples*nchannels);
+   for (si=0;si<head->stream_count;si++)
+   {
+      OpusDecoder *od;
+      int stream_channels;
+      int ci;
+      int ret;
+      if (!ctx->decode[si]) continue;
+      ret=opus_multistream_decoder_ctl(decoder,
+       OPUS_MULTISTREAM_GET_DECODER_STATE(si, &od));
+      if (ret<0) return ret;
+      stream_channels=si<head->coupled_count?2:1;
+      if (format==OP_DEC_FORMAT_SHORT)
+      {
+         ret=opus_decode(od, data?packets[si]:NULL, data?sizes[si]:0,
+          (opus_int16 *)ctx->stream_pcm, nsamples, decode_fec);
+      } else {
+         ret=opus_decode_float(od, data?packets[si]:NULL, data?sizes[si]:0,
+          ctx->stream_pcm, nsamples, decode_fec);
+      }
+      if (ret<0) return ret;
+      if (ret!=nsamples) return OPUS_INTERNAL_ERROR;
+      for (ci=0;ci<nchannels;ci++)
+      {
+         int m=head->mapping[ci];
+         int sub;
+         int i;
+         if (m==255 || mapping_stream(head, m)!=si) continue;
+         sub=si<head->coupled_count?(m&1):0;
+         if (format==OP_DEC_FORMAT_SHORT)
+         {
+            const opus_int16 *src=(const opus_int16 *)ctx->stream_pcm;
+            opus_int16 *dst=(opus_int16 *)pcm;
+            for (i=0;i<nsamples;i++)
+               dst[i*nchannels+ci]=src[i*stream_channels+sub];
+         } else {
+            float *dst=(float *)pcm;
+            for (i=0;i<nsamples;i++)
+               dst[i*nchannels+ci]=ctx->stream_pcm[i*stream_channels+sub];
+         }
+      }
+   }
+   return nsamples;
+}
+
+/*Decides whether the loss model drops the packet with the given index.
+  Each packet is decided once, in order, so the loss pattern for a given
+  seed is the same with and without --fec.*/
+static int packet_lost(decode_cb_ctx *ctx, opus_int64 index)
+{
+   if (index==ctx->decided_index) return ctx->decided_lost;
+   ctx->decided_index=index;
+   ctx->decided_lost=ctx->loss!=NULL && loss_model_next(ctx->loss);
+   return ctx->decided_lost;
+}
+
+static int hold_packet(held_packet *held, const ogg_packet *op,
+ opus_int64 index, int li)
+{
+   if (op->bytes>held->size)
+   {
+      unsigned char *data;
+      data=realloc(held->data, op->bytes);
+      if (!data) return OPUS_ALLOC_FAIL;
+      held->data=data;
+      held->size=op->bytes;
+   }
+   memcpy(held->data, op->packet, op->bytes);
+   held->len=op->bytes;
+   held->packetno=op->packetno;
+   held->index=index;
+   held->e_o_s=op->e_o_s;
+   held->li=li;
+   return 0;
+}
+
+/*Decode callback for the --fec lookahead handle: it only keeps a copy of
+  each packet. The audio it returns is never used.*/
+static int peek_cb(void *user_data, OpusMSDecoder *decoder, void *pcm,
+ const ogg_packet *op, int nsamples, int nchannels, int format, int li)
+{
+   decode_cb_ctx *ctx = (decode_cb_ctx *)user_data;
+   (void)decoder;
+   memset(pcm, 0, (format==OP_DEC_FORMAT_SHORT?sizeof(opus_int16):
+    sizeof(float))*nsamples*nchannels);
+   return hold_packet(&ctx->next, op, ctx->next.index+1, li);
+}
+
+/*Returns the packet that follows the current one in the same link, if it
+  is there and was not lost itself, or NULL.*/
+static const held_packet *next_packet(decode_cb_ctx *ctx,
+ const ogg_packet *op, int li)
+{
+   if (op->e_o_s) return NULL;
+   /*Each read of the lookahead handle decodes at most one packet, so it
+     stops exactly on the next one.*/
+   while (ctx->next.index<=ctx->packet_index)
+   {
+      int ret;
+      ret=op_read_float(ctx->peek, ctx->stream_pcm,
+       sizeof(ctx->stream_pcm)/sizeof(*ctx->stream_pcm), NULL);
+      if (ret==OP_HOLE) continue;
+      if (ret<=0) return NULL;
+   }
+   if (ctx->next.li!=li || ctx->next.packetno!=op->packetno+1) return NULL;
+   if (packet_lost(ctx, ctx->next.index)) return NULL;
+   return &ctx->next;
+}
+
+/*Returns 1 if every stream we decode carries forward error correction.*/
+static int packet_has_fec(decode_cb_ctx *ctx, const held_packet *next,
+ int li)
+{
+   const OpusHead *head;
+   const unsigned char *packets[OPUS_CHANNEL_COUNT_MAX];
+   opus_int32 sizes[OPUS_CHANNEL_COUNT_MAX];
+   int si;
+   head=op_head(ctx->of, li);
+   if (ctx->nselect>0 && update_selection(ctx, head, li)<0) return 0;
+   if (split_packet(ctx, head, next->data, next->len, packets, sizes)<0)
+      return 0;
+   for (si=0;si<head->stream_count;si++)
+   {
+      if (ctx->nselect>0 && !ctx->decode[si]) continue;
+      if (!ms_packet_has_lbrr(packets[si], sizes[si])) return 0;
+   }
+   return 1;
+}
+
 static int decode_cb(void *user_data, OpusMSDecoder *decoder, void *pcm,
  const ogg_packet *op, int nsamples, int nchannels, int format, int li)
 {
    decode_cb_ctx *ctx = (decode_cb_ctx *)user_data;
-   int lost;
+   const unsigned char *data;
+   opus_int32 len;
+   int decode_fec;
+   int outcome;
+   double start;
    int ret;
-   (void)nchannels;
-   (void)li;
-   lost = ctx->loss_percent>0
-    && 100*(float)rand()/(float)RAND_MAX<ctx->loss_percent;
-   switch (format)
+   ctx->packet_index++;
+   data=op->packet;
+   len=op->bytes;
+   decode_fec=0;
+   outcome=PACKET_DECODED;
+   if (packet_lost(ctx, ctx->packet_index))
    {
-      case OP_DEC_FORMAT_SHORT:
+      const held_packet *next;
+      outcome=PACKET_CONCEALED;
+      data=NULL;
+      len=0;
+      next=ctx->peek!=NULL?next_packet(ctx, op, li):NULL;
+      if (next!=NULL)
       {
-         if (lost)
+         /*libopus conceals the frame itself if the next packet turns out
+           to have no forward error correction, so only count real
+           recoveries.*/
+         if (packet_has_fec(ctx, next, li)) outcome=PACKET_RECOVERED;
+         data=next->data;
+         len=next->len;
+         decode_fec=1;
+      }
+   }
+   start=bench_clock();
+   if (ctx->nselect>0)
+   {
+      if (format!=OP_DEC_FORMAT_SHORT && format!=OP_DEC_FORMAT_FLOAT)
+         return OPUS_BAD_ARG;
+      ret = decode_selected(ctx, decoder, pcm, data, len, nsamples,
+       nchannels, format, li, decode_fec);
+   } else {
+      switch (format)
+      {
+         case OP_DEC_FORMAT_SHORT:
          {
             ret = opus_multistream_decode(decoder,
-             NULL, 0, pcm, nsamples, 0);
-         } else {
-            ret = opus_multistream_decode(decoder,
-             op->packet, op->bytes, pcm, nsamples, 0);
+             data, len, pcm, nsamples, decode_fec);
+            break;
          }
-         break;
-      }
-      case OP_DEC_FORMAT_FLOAT:
-      {
-         if (lost)
+         case OP_DEC_FORMAT_FLOAT:
          {
             ret = opus_multistream_decode_float(decoder,
-             NULL, 0, pcm, nsamples, 0);
-         } else {
-            ret = opus_multistream_decode_float(decoder,
-             op->packet, op->bytes, pcm, nsamples, 0);
+             data, len, pcm, nsamples, decode_fec);
+            break;
+         }
+         default:
+         {
+            return OPUS_BAD_ARG;
          }
-         break;
-      }
-      default:
-      {
-         return OPUS_BAD_ARG;
       }
    }
+   ctx->decode_time[outcome]+=bench_clock()-start;
+   ctx->nb_packets[outcome]++;
    /*On success, either we got as many samples as we wanted, or something went
      wrong.*/
    if (ret >= 0)
@@ -652,26 +1041,400 @@ static int decode_cb(void *user_data, OpusMSDecoder *decoder, void *pcm,
    return ret;
 }
 
-static void drain_resampler(FILE *fout, int file_output,
- SpeexResamplerState *resampler, int channels, int rate,
+/*Opens one file per channel for --split-channels, named after outFile with
+  the channel number before the extension (out.wav gives out-0.wav,
+  out-1.wav, ...). Returns the Wave header format, 0 for raw output, or -1
+  on error, in which case no file is left open.*/
+static int split_files_open(const char *outFile, int wav_format, int rate,
+ int channels, int fp, opus_int64 audio_size, FILE **files)
+{
+   const char *ext;
+   const char *p;
+   char *name;
+   size_t base_len;
+   int format=0;
+   int ci;
+   ext=NULL;
+   for (p=outFile;*p;p++)
+   {
+      if (*p=='.') ext=p;
+      else if (*p=='/' || *p=='\\') ext=NULL;
+   }
+   if (!ext) ext=p;
+   base_len=ext-outFile;
+   name=malloc(strlen(outFile)+8);
+   if (!name)
+   {
+      fprintf(stderr, "Memory allocation failure.\n");
+      return -1;
+   }
+   for (ci=0;ci<channels;ci++)
+   {
+      memcpy(name, outFile, base_len);
+      sprintf(name+base_len, "-%d%s", ci, ext);
+      files[ci]=fopen_utf8(name, "wb");
+      if (!files[ci])
+      {
+         perror(name);
+         break;
+      }
+      if (wav_format)
+      {
+         format=write_wav_header(files[ci], rate, 0, 1, fp, audio_size);
+         if (format<0)
+         {
+            fprintf(stderr, "Error writing WAV header.\n");
+            fclose(files[ci]);
+            break;
+         }
+      }
+   }
+   free(name);
+   if (ci<channels)
+   {
+      while (ci-->0) fclose(files[ci]);
+      return -1;
+   }
+   return format;
+}
+
+/*Returns the total output length at the given rate, if the source is
+  seekable and every link has a known length, or -1 otherwise.*/
+static opus_int64 expected_samples(OggOpusFile *st, int rate)
+{
+   opus_int64 total=0;
+   int nlinks;
+   int li;
+   if (!op_seekable(st)) return -1;
+   nlinks=op_link_count(st);
+   for (li=0;li<nlinks;li++)
+   {
+      ogg_int64_t link_total;
+      link_total=op_pcm_total(st,li);
+      if (link_total<0) return -1;
+      total+=(link_total/48000)*rate + (link_total%48000)*rate/48000;
+   }
+   return total;
+}
+
+static void drain_resampler(FILE *fout, pcm_prealloc *prealloc,
+ pcm_planar *planar, int file_output, SpeexResamplerState *resampler, int channels, int rate,
  opus_int64 link_read, opus_int64 link_out, float *clipmem,
  shapestate *shapemem, opus_int64 *audio_size, int fp)
 {
    float *zeros;
    int drain;
-   zeros=(float *)calloc(100*channels,sizeof(float));
+   zeros=alloca(sizeof(float)*100*channels);
+   memset(zeros, 0, sizeof(float)*100*channels);
    drain=speex_resampler_get_input_latency(resampler);
    do
    {
       opus_int64 outsamp;
       int tmp=MINI(drain, 100);
-      outsamp=audio_write(zeros, channels, tmp, fout, resampler, clipmem,
-       shapemem, file_output, rate, link_read, link_out, fp);
+      outsamp=audio_write(zeros, channels, tmp, fout, prealloc, planar,
+       resampler, clipmem, shapemem, file_output, rate, link_read, link_out, fp);
       link_out+=outsamp;
       (*audio_size)+=(fp?sizeof(float):sizeof(short))*outsamp*channels;
       drain-=tmp;
    } while (drain>0);
-   free(zeros);
+}
+
+/*Input for --follow: a file that is still being written, read as an
+  unseekable stream so that opusfile does not look for the end of it.*/
+typedef struct {
+   FILE *f;
+   follow_state follow;
+} follow_source;
+
+static int follow_read(void *stream, unsigned char *ptr, int nbytes)
+{
+   follow_source *src=(follow_source *)stream;
+   size_t ret;
+   for (;;)
+   {
+      ret=fread(ptr, 1, nbytes, src->f);
+      if (ret>0 || nbytes<=0) return (int)ret;
+      if (ferror(src->f)) return -1;
+      if (!follow_wait(&src->follow, src->f)) return 0;
+   }
+}
+
+static int follow_close(void *stream)
+{
+   follow_source *src=(follow_source *)stream;
+   int ret;
+   ret=fclose(src->f);
+   follow_clear(&src->follow);
+   free(src);
+   return ret;
+}
+
+static OggOpusFile *follow_open(const char *path, double timeout,
+ const char *sentinel)
+{
+   static const OpusFileCallbacks follow_cb={follow_read, NULL, NULL,
+    follow_close};
+   follow_source *src;
+   OggOpusFile *of;
+   src=malloc(sizeof(*src));
+   if (!src) return NULL;
+   src->f=fopen_utf8(path, "rb");
+   if (!src->f)
+   {
+      free(src);
+      return NULL;
+   }
+   if (follow_init(&src->follow, path, timeout, sentinel)<0)
+   {
+      fclose(src->f);
+      free(src);
+      return NULL;
+   }
+   of=op_open_callbacks(src, &follow_cb, NULL, 0, NULL);
+   /*opusfile only takes ownership of the stream when it succeeds.*/
+   if (!of) follow_close(src);
+   return of;
+}
+
+/*Reads the whole input into memory for --bench, so that file I/O is not
+  part of the timings.*/
+static unsigned char *load_input(const char *path, size_t *size)
+{
+   FILE *fin;
+   unsigned char *data=NULL;
+   size_t len=0;
+   size_t cap=0;
+   if (strcmp(path,"-")==0)
+   {
+#if defined WIN32 || defined _WIN32
+      _setmode(_fileno(stdin), _O_BINARY);
+#endif
+      fin=stdin;
+   } else {
+      fin=fopen_utf8(path, "rb");
+      if (!fin)
+      {
+         perror(path);
+         return NULL;
+      }
+   }
+   for (;;)
+   {
+      size_t nread;
+      if (len==cap)
+      {
+         unsigned char *new_data;
+         cap=cap?2*cap:1<<20;
+         new_data=realloc(data, cap);
+         if (!new_data)
+         {
+            fprintf(stderr, "Memory allocation failure.\n");
+            free(data);
+            data=NULL;
+            break;
+         }
+         data=new_data;
+      }
+      nread=fread(data+len, 1, cap-len, fin);
+      len+=nread;
+      if (nread==0)
+      {
+         if (ferror(fin))
+         {
+            perror(path);
+            free(data);
+            data=NULL;
+         }
+         break;
+      }
+   }
+   if (fin!=stdin) fclose(fin);
+   *size=len;
+   return data;
+}
+
+static void print_json_string(FILE *f, const char *str)
+{
+   fputc('"', f);
+   for (;*str;str++)
+   {
+      unsigned char c=(unsigned char)*str;
+      if (c=='"' || c=='\\') fprintf(f, "\\%c", c);
+      else if (c<0x20) fprintf(f, "\\u%04x", c);
+      else fputc(c, f);
+   }
+   fputc('"', f);
+}
+
+/*--bench: decodes the input, held in memory, repeat times through the
+  normal conversion path with the output discarded, and reports the time
+  spent in each stage. Returns the exit code.*/
+static int run_bench(const char *inFile, int repeat, int rate, int quality,
+ int fp, int dither, int force_stereo, int quiet)
+{
+   bench_times times;
+   unsigned char *data;
+   size_t size;
+   opus_int64 samples=0;
+   double start;
+   double total;
+   double audio_seconds;
+   int channels=0;
+   int out_rate=rate;
+   int pass;
+   int ret=0;
+   data=load_input(inFile, &size);
+   if (!data) return 1;
+   memset(&times, 0, sizeof(times));
+   bench=&times;
+   start=bench_clock();
+   for (pass=0;pass<repeat && ret==0;pass++)
+   {
+      OggOpusFile *st;
+      const OpusHead *head;
+      SpeexResamplerState *resampler=NULL;
+      shapestate shapemem;
+      float *output;
+      float *clipmem;
+      opus_int64 link_read=0;
+      opus_int64 link_out=0;
+      opus_int64 audio_size=0;
+      int old_li=-1;
+      int err;
+      st=op_open_memory(data, size, &err);
+      if (!st)
+      {
+         fprintf(stderr, "Failed to open '%s'.\n", inFile);
+         ret=1;
+         break;
+      }
+      head=op_head(st, 0);
+      channels=force_stereo?2:head->channel_count;
+      if (rate==0)
+      {
+         out_rate=head->input_sample_rate;
+         if (out_rate<8000 || out_rate>192000) out_rate=48000;
+      }
+      output=malloc(sizeof(float)*MAX_FRAME_SIZE*channels);
+      clipmem=calloc(channels, sizeof(float));
+      shapemem.a_buf=calloc(channels, sizeof(float)*4);
+      shapemem.b_buf=calloc(channels, sizeof(float)*4);
+      shapemem.mute=960;
+      shapemem.fs=out_rate;
+      shapemem.rng=SHAPESTATE_RNG_SEED;
+      if (out_rate!=48000)
+      {
+         resampler=speex_resampler_init(channels, 48000, out_rate, quality,
+          &err);
+         if (resampler) speex_resampler_skip_zeros(resampler);
+      }
+      if (!output || !clipmem || !shapemem.a_buf || !shapemem.b_buf
+       || (out_rate!=48000 && !resampler))
+      {
+         fprintf(stderr, "Memory allocation failure.\n");
+         ret=1;
+      }
+      while (ret==0)
+      {
+         int nb_read;
+         int li;
+         times.mark=bench_clock();
+         if (force_stereo)
+         {
+            nb_read=op_read_float_stereo(st, output, MAX_FRAME_SIZE*channels);
+            li=op_current_link(st);
+         } else {
+            nb_read=op_read_float(st, output, MAX_FRAME_SIZE*channels, &li);
+         }
+         BENCH_MARK(decode);
+         if (nb_read==OP_HOLE) continue;
+         if (nb_read<0)
+         {
+            fprintf(stderr, "Decoding error.\n");
+            ret=1;
+            break;
+         }
+         if (nb_read==0) break;
+         if (li!=old_li)
+         {
+            if (!force_stereo && op_head(st, li)->channel_count!=channels)
+            {
+               fprintf(stderr, "Error: channel count changed in a chained "
+                "stream; use --force-stereo.\n");
+               ret=1;
+               break;
+            }
+            if (resampler && old_li>=0)
+            {
+               drain_resampler(NULL, NULL, NULL, 1, resampler, channels,
+                out_rate, link_read, link_out, clipmem,
+                dither?&shapemem:NULL, &audio_size, fp);
+               speex_resampler_reset_mem(resampler);
+               speex_resampler_skip_zeros(resampler);
+            }
+            link_read=link_out=0;
+            old_li=li;
+         }
+         link_read+=nb_read;
+         samples+=nb_read;
+         link_out+=audio_write(output, channels, nb_read, NULL, NULL, NULL,
+          resampler, clipmem, dither?&shapemem:NULL, 1, out_rate, link_read,
+          link_out, fp);
+      }
+      if (resampler)
+      {
+         if (ret==0)
+         {
+            drain_resampler(NULL, NULL, NULL, 1, resampler, channels,
+             out_rate, link_read, link_out, clipmem, dither?&shapemem:NULL,
+             &audio_size, fp);
+         }
+         speex_resampler_destroy(resampler);
+      }
+      free(output);
+      free(clipmem);
+      free(shapemem.a_buf);
+      free(shapemem.b_buf);
+      op_free(st);
+   }
+   total=bench_clock()-start;
+   bench=NULL;
+   free(data);
+   if (ret!=0) return ret;
+   audio_seconds=samples/48000.;
+   if (total<=0) total=1e-9;
+   if (!quiet)
+   {
+      double stages=times.decode+times.resample+times.convert+times.output;
+      if (stages<=0) stages=1e-9;
+      fprintf(stderr, "Decoded %.2f s of audio in %.3f s (%d %s): "
+       "%.1fx realtime\n", audio_seconds, total, pass,
+       pass>1?"passes":"pass", audio_seconds/total);
+      fprintf(stderr, "  decode    %8.3f s  %5.1f%%\n", times.decode,
+       100*times.decode/stages);
+      fprintf(stderr, "  resample  %8.3f s  %5.1f%%\n", times.resample,
+       100*times.resample/stages);
+      fprintf(stderr, "  convert   %8.3f s  %5.1f%%\n", times.convert,
+       100*times.convert/stages);
+      fprintf(stderr, "  output    %8.3f s  %5.1f%%\n", times.output,
+       100*times.output/stages);
+   }
+   printf("{\"input\": ");
+   print_json_string(stdout, inFile);
+   printf(", \"passes\": %d, \"channels\": %d, \"rate\": %d, ",
+    pass, channels, out_rate);
+   /*The quality is null when the output is not resampled.*/
+   if (out_rate!=48000) printf("\"resample_quality\": %d, ", quality);
+   else printf("\"resample_quality\": null, ");
+   printf("\"format\": \"%s\", "
+    "\"audio_seconds\": %.6f, \"wall_seconds\": %.6f, "
+    "\"decode_seconds\": %.6f, \"resample_seconds\": %.6f, "
+    "\"convert_seconds\": %.6f, \"output_seconds\": %.6f, "
+    "\"samples_per_second\": %.0f, \"realtime_factor\": %.3f}\n",
+    fp?"float":(dither?"s16-dither":"s16"), audio_seconds, total,
+    times.decode, times.resample, times.convert, times.output,
+    samples/total, audio_seconds/total);
+   return 0;
 }
 
 int main(int argc, char **argv)
@@ -683,6 +1446,21 @@ int main(int argc, char **argv)
    int exit_code = 0;
    const char *inFile, *outFile, *rangeFile=NULL;
    FILE *fout=NULL, *frange=NULL;
+   pcm_prealloc prealloc_buf;
+   pcm_prealloc *prealloc=NULL;
+   pcm_planar planar_buf;
+   pcm_planar *planar=NULL;
+   FILE **split_files=NULL;
+   int planar_output=0;
+   int select_list[OPUS_CHANNEL_COUNT_MAX];
+   unsigned char select_map[OPUS_CHANNEL_COUNT_MAX];
+   unsigned char select_decode[OPUS_CHANNEL_COUNT_MAX];
+   int nselect=0;
+   int select_streams=0;
+   float *decoded=NULL;
+   int decoded_channels=0;
+   int mapping_family;
+   int split_channels=0;
    float *output;
    float *permuted_output;
    OggOpusFile *st=NULL;
@@ -703,29 +1481,66 @@ int main(int argc, char **argv)
       {"version", no_argument, NULL, 0},
       {"version-short", no_argument, NULL, 0},
       {"rate", required_argument, NULL, 0},
+      {"resample-quality", required_argument, NULL, 0},
       {"force-stereo", no_argument, NULL, 0},
+      {"channels", required_argument, NULL, 0},
+      {"streams", required_argument, NULL, 0},
       {"gain", required_argument, NULL, 0},
       {"no-dither", no_argument, NULL, 0},
       {"float", no_argument, NULL, 0},
       {"force-wav", no_argument, NULL, 0},
+      {"planar", no_argument, NULL, 0},
+      {"split-channels", no_argument, NULL, 0},
+      {"output", required_argument, NULL, 0},
+      {"threads", no_argument, NULL, 0},
+      {"validate", no_argument, NULL, 0},
+      {"jobs", required_argument, NULL, 0},
+      {"bench", no_argument, NULL, 0},
+      {"repeat", required_argument, NULL, 0},
       {"packet-loss", required_argument, NULL, 0},
+      {"loss-model", required_argument, NULL, 0},
+      {"loss-seed", required_argument, NULL, 0},
+      {"fec", no_argument, NULL, 0},
+      {"follow", no_argument, NULL, 0},
+      {"follow-timeout", required_argument, NULL, 0},
+      {"follow-sentinel", required_argument, NULL, 0},
       {"save-range", required_argument, NULL, 0},
+      {"cpu-info", no_argument, NULL, 0},
       {0, 0, 0, 0}
    };
    opus_int64 audio_size=0;
+   opus_int64 expected_size=-1;
    opus_int64 last_coded_seconds=-1;
-   float loss_percent=-1;
+   const char *loss_spec=NULL;
+   char loss_arg[64];
+   unsigned loss_seed=0;
+   loss_model *loss=NULL;
+   int fec=0;
+   int follow=0;
+   double follow_timeout=10;
+   const char *follow_sentinel=NULL;
    float manual_gain=0;
    int force_rate=0;
    int force_stereo=0;
    int requested_channels=-1;
    int channels=-1;
    int rate=0;
+   int resample_quality=5;
    int wav_format=0;
    int dither=1;
    int fp=0;
    shapestate shapemem;
    SpeexResamplerState *resampler=NULL;
+   output_sink *sinks=NULL;
+   sink_group *sinkgroup=NULL;
+   int nsinks=0;
+   int sink_threads=0;
+   int sink_dither;
+   int main_output=1;
+   int validate=0;
+   int bench_mode=0;
+   int bench_repeat=1;
+   int jobs=1;
    size_t last_spin=0;
 #ifdef WIN_UNICODE
    int argc_utf8;
@@ -771,6 +1586,10 @@ int main(int argc, char **argv)
          {
             version_short();
             goto done;
+         } else if (strcmp(long_options[option_index].name,"cpu-info")==0)
+         {
+            print_cpu_info();
+            goto done;
          } else if (strcmp(long_options[option_index].name,"no-dither")==0)
          {
             dither=0;
@@ -780,12 +1599,86 @@ int main(int argc, char **argv)
          } else if (strcmp(long_options[option_index].name,"force-wav")==0)
          {
             forcewav=1;
+         } else if (strcmp(long_options[option_index].name,"planar")==0)
+         {
+            planar_output=1;
+         } else if (strcmp(long_options[option_index].name,"split-channels")==0)
+         {
+            split_channels=1;
+         } else if (strcmp(long_options[option_index].name,"output")==0)
+         {
+            output_sink *new_sinks;
+            new_sinks=realloc(sinks,sizeof(*sinks)*(nsinks+1));
+            if (!new_sinks)
+            {
+               fprintf(stderr, "Memory allocation failure.\n");
+               exit_code=1;
+               goto done;
+            }
+            sinks=new_sinks;
+            if (output_sink_parse(&sinks[nsinks],optarg)<0)
+            {
+               fprintf(stderr,"Invalid output: %s\n"
+                "Must be of the form rate:channels:format:file\n",optarg);
+               exit_code=1;
+               goto done;
+            }
+            nsinks++;
+         } else if (strcmp(long_options[option_index].name,"threads")==0)
+         {
+            sink_threads=1;
+         } else if (strcmp(long_options[option_index].name,"validate")==0)
+         {
+            validate=1;
+         } else if (strcmp(long_options[option_index].name,"bench")==0)
+         {
+            bench_mode=1;
+         } else if (strcmp(long_options[option_index].name,"repeat")==0)
+         {
+            bench_repeat=atoi(optarg);
+            if (bench_repeat<1)
+            {
+               fprintf(stderr,"Invalid repeat count: %s\n",optarg);
+               exit_code=1;
+               goto done;
+            }
+         } else if (strcmp(long_options[option_index].name,"jobs")==0)
+         {
+            jobs=atoi(optarg);
+            if (jobs<1)
+            {
+               fprintf(stderr,"Invalid number of jobs: %s\n",optarg);
+               exit_code=1;
+               goto done;
+            }
          } else if (strcmp(long_options[option_index].name,"rate")==0)
          {
             rate=atoi(optarg);
+         } else if (strcmp(long_options[option_index].name,"resample-quality")==0)
+         {
+            resample_quality=parse_resample_quality(optarg);
+            if (resample_quality<0)
+            {
+               fprintf(stderr,"Invalid resampler quality: %s\n",optarg);
+               exit_code=1;
+               goto done;
+            }
          } else if (strcmp(long_options[option_index].name,"force-stereo")==0)
          {
             force_stereo=1;
+         } else if (strcmp(long_options[option_index].name,"channels")==0
+          || strcmp(long_options[option_index].name,"streams")==0)
+         {
+            select_streams=long_options[option_index].name[0]=='s';
+            nselect=parse_index_list(optarg, select_list,
+             OPUS_CHANNEL_COUNT_MAX);
+            if (nselect<=0)
+            {
+               fprintf(stderr,"Invalid %s list: %s\n",
+                long_options[option_index].name,optarg);
+               exit_code=1;
+               goto done;
+            }
          } else if (strcmp(long_options[option_index].name,"gain")==0)
          {
             manual_gain = (float)atof(optarg);
@@ -794,7 +1687,34 @@ int main(int argc, char **argv)
             rangeFile=optarg;
          } else if (strcmp(long_options[option_index].name,"packet-loss")==0)
          {
-            loss_percent = (float)atof(optarg);
+            snprintf(loss_arg, sizeof(loss_arg), "bernoulli:%s", optarg);
+            loss_spec=loss_arg;
+         } else if (strcmp(long_options[option_index].name,"loss-model")==0)
+         {
+            loss_spec=optarg;
+         } else if (strcmp(long_options[option_index].name,"loss-seed")==0)
+         {
+            loss_seed=(unsigned)strtoul(optarg, NULL, 10);
+         } else if (strcmp(long_options[option_index].name,"fec")==0)
+         {
+            fec=1;
+         } else if (strcmp(long_options[option_index].name,"follow")==0)
+         {
+            follow=1;
+         } else if (strcmp(long_options[option_index].name,
+                     "follow-timeout")==0)
+         {
+            follow_timeout=atof(optarg);
+            if (follow_timeout<0)
+            {
+               fprintf(stderr,"Invalid follow timeout: %s\n",optarg);
+               exit_code=1;
+               goto done;
+            }
+         } else if (strcmp(long_options[option_index].name,
+                     "follow-sentinel")==0)
+         {
+            follow_sentinel=optarg;
          }
          break;
       case 'h':
@@ -809,6 +1729,40 @@ int main(int argc, char **argv)
          goto done;
       }
    }
+   if (validate)
+   {
+      int nfiles;
+      int failed;
+      /*Every argument is an input; only the decoder runs, with no
+        resampling, dithering or output.*/
+      nfiles=argc_utf8-optind;
+      if (nfiles<1)
+      {
+         usage();
+         exit_code=1;
+         goto done;
+      }
+      failed=validate_files(argv_utf8+optind, nfiles, jobs, quiet);
+      if (!quiet && nfiles>1)
+      {
+         fprintf(stderr, "%d of %d files failed validation.\n",
+          failed, nfiles);
+      }
+      exit_code=failed>0;
+      goto done;
+   }
+   if (bench_mode)
+   {
+      if (argc_utf8-optind!=1)
+      {
+         usage();
+         exit_code=1;
+         goto done;
+      }
+      exit_code=run_bench(argv_utf8[optind], bench_repeat, rate,
+       resample_quality, fp, dither && !fp, force_stereo, quiet);
+      goto done;
+   }
    if (argc_utf8-optind!=2 && argc_utf8-optind!=1)
    {
       usage();
@@ -819,6 +1773,9 @@ int main(int argc, char **argv)
 
    /*Output to a file or playback?*/
    file_output=argc_utf8-optind==2;
+   /*With --output and no output argument, only the --output files are
+     written.*/
+   main_output=file_output||nsinks==0;
    if (file_output) {
      /*If we're outputting to a file, should we apply a wav header?*/
      outFile=argv_utf8[optind+1];
@@ -843,10 +1800,83 @@ int main(int argc, char **argv)
      if (rate==0) rate=48000;
      /*Playback is 16-bit only.*/
      fp=0;
+     if (!main_output) file_output=1;
+   }
+   if (planar_output && split_channels)
+   {
+      fprintf(stderr, "Error: --planar and --split-channels cannot be "
+       "used together.\n");
+      exit_code=1;
+      goto done;
+   }
+   if ((planar_output || split_channels) && outFile==NULL)
+   {
+      fprintf(stderr, "Error: --%s needs an output file.\n",
+       planar_output?"planar":"split-channels");
+      exit_code=1;
+      goto done;
+   }
+   if (split_channels && strcmp(outFile,"-")==0)
+   {
+      fprintf(stderr, "Error: --split-channels cannot write to stdout.\n");
+      exit_code=1;
+      goto done;
+   }
+   if (fec && !loss_spec)
+   {
+      /*FEC data is only used to rebuild the packets the loss model drops;
+        opusfile skips over holes in the input without handing us a lost
+        packet to rebuild.*/
+      fprintf(stderr, "Error: --fec needs --packet-loss or --loss-model.\n");
+      exit_code=1;
+      goto done;
+   }
+   if (loss_spec)
+   {
+      loss=loss_model_create(loss_spec, loss_seed);
+      if (!loss)
+      {
+         exit_code=1;
+         goto done;
+      }
    }
-   /*If the output is floating point, don't dither.*/
+   if (follow && (fec || strcmp(inFile,"-")==0))
+   {
+      fprintf(stderr, "Error: --follow needs an input file and cannot be "
+       "used with %s.\n", fec?"--fec":"stdin");
+      exit_code=1;
+      goto done;
+   }
+   if (fec && strcmp(inFile,"-")==0)
+   {
+      fprintf(stderr, "Error: --fec reads the input twice and cannot be "
+       "used with stdin.\n");
+      exit_code=1;
+      goto done;
+   }
+   if (nselect>0 && (force_stereo || rangeFile))
+   {
+      fprintf(stderr, "Error: --channels and --streams cannot be used with "
+       "%s.\n", force_stereo?"--force-stereo":"--save-range");
+      exit_code=1;
+      goto done;
+   }
+   if (planar_output && wav_format)
+   {
+      fprintf(stderr, "Error: --planar writes raw PCM; use --split-channels "
+       "for Wave output.\n");
+      exit_code=1;
+      goto done;
+   }
+   /*If the output is floating point, don't dither. The --output sinks pick
+     their own sample format, so they keep the requested setting.*/
+   sink_dither=dither;
    if (fp) dither=0;
 
+   cb_ctx.packet_buf=NULL;
+   cb_ctx.peek=NULL;
+   cb_ctx.next.data=NULL;
+
    /*Open input file*/
    if (strcmp(inFile, "-")==0)
    {
@@ -860,6 +1890,10 @@ int main(int argc, char **argv)
 #endif
       st=op_open_callbacks(op_fdopen(&cb, fd, "rb"), &cb, NULL, 0, NULL);
    }
+   else if (follow)
+   {
+      st=follow_open(inFile, follow_timeout, follow_sentinel);
+   }
    else
    {
       st=op_open_url(inFile,NULL,NULL);
@@ -914,7 +1948,8 @@ int main(int argc, char **argv)
             }
          }
       }
-      if (!force_stereo)
+      /*With --channels or --streams, each link is checked on its own.*/
+      if (!force_stereo && nselect==0)
       {
          int initial_channels;
          initial_channels = head->channel_count;
@@ -968,39 +2003,135 @@ int main(int argc, char **argv)
    }
 
    requested_channels=force_stereo?2:head->channel_count;
-   /*TODO: For seekable sources, write the output length in the WAV header.*/
+   mapping_family=head->mapping_family;
+   if (nselect>0)
+   {
+      requested_channels=select_channels(select_list, nselect, select_streams,
+       head, select_map, select_decode);
+      if (requested_channels<0)
+      {
+         fprintf(stderr, "Error: The %s list does not match the stream "
+          "(%d channels in %d streams).\n",
+          select_streams?"--streams":"--channels",
+          head->channel_count, head->stream_count);
+         exit_code=1;
+         goto done;
+      }
+      /*The selected channels no longer form a known layout.*/
+      mapping_family=255;
+   }
+   /*For seekable sources decoded to a named file, we know the exact output
+     length up front: write it into the header and reserve the space.*/
+   if (outFile && strcmp(outFile,"-")!=0)
+   {
+      expected_size=expected_samples(st, rate);
+      if (expected_size>=0)
+         expected_size*=(fp?sizeof(float):sizeof(short))*requested_channels;
+   }
    channels=requested_channels;
-   if (!out_file_open(outFile, &wav_format, rate, head->mapping_family,
-        &channels, fp, &fout))
+   if (split_channels)
+   {
+      split_files=malloc(sizeof(*split_files)*channels);
+      if (!split_files)
+      {
+         fprintf(stderr, "Memory allocation failure.\n");
+         exit_code=1;
+         goto done;
+      }
+      wav_format=split_files_open(outFile, wav_format, rate, channels, fp,
+       expected_size>=0?expected_size/channels:-1, split_files);
+      if (wav_format<0)
+      {
+         exit_code=1;
+         goto done;
+      }
+   }
+   else if (main_output && !out_file_open(outFile, &wav_format, rate,
+        mapping_family, &channels, fp, expected_size, &fout))
    {
       exit_code=1;
       goto done;
    }
-   if (channels!=requested_channels) force_stereo=1;
+   if (channels!=requested_channels)
+   {
+      if (nselect>0)
+      {
+         fprintf(stderr, "Error: Cannot play %d channels.\n",
+          requested_channels);
+         if (fout) fclose(fout);
+         exit_code=1;
+         goto done;
+      }
+      force_stereo=1;
+   }
+   if (fout && expected_size>=0 && !planar_output)
+   {
+      int ret;
+      ret=pcm_prealloc_init(&prealloc_buf, fout, wav_format, expected_size);
+      if (ret<0)
+      {
+         fprintf(stderr, "Warning: Cannot preallocate output file;"
+            " falling back to buffered writes.\n");
+      }
+      if (ret>0) prealloc=&prealloc_buf;
+   }
 
    /*Setup the memory for the dithered output*/
    shapemem.a_buf=calloc(channels,sizeof(float)*4);
    shapemem.b_buf=calloc(channels,sizeof(float)*4);
    shapemem.mute=960;
    shapemem.fs=rate;
+   shapemem.rng=SHAPESTATE_RNG_SEED;
 
    output=malloc(sizeof(float)*MAX_FRAME_SIZE*channels);
    permuted_output=NULL;
-   if (!shapemem.a_buf || !shapemem.b_buf || !output)
+   if (nselect>0)
+   {
+      /*Every channel of the link is decoded into here (the unselected ones
+        as silence) and the selected ones are then picked out.*/
+      decoded_channels=head->channel_count;
+      decoded=malloc(sizeof(float)*MAX_FRAME_SIZE*decoded_channels);
+   }
+   if (!shapemem.a_buf || !shapemem.b_buf || !output
+    || (nselect>0 && !decoded))
    {
       fprintf(stderr, "Memory allocation failure.\n");
       exit_code=1;
       goto cleanup;
    }
 
-   if (wav_format&&(channels==3||channels>4))
+   if (planar_output || split_channels)
    {
       int ci;
       for (ci=0;ci<channels;ci++)
       {
          channel_map[ci]=ci;
       }
-      adjust_wav_mapping(head->mapping_family, channels, channel_map);
+      /*Each split file takes the place its channel would have in an
+        interleaved Wave file. The planar writer reads through the map, so
+        no separate permuting pass is needed.*/
+      if (wav_format&&(channels==3||channels>4))
+         adjust_wav_mapping(mapping_family, channels, channel_map);
+      if (pcm_planar_init(&planar_buf, split_files?split_files:&fout,
+           split_files?channels:1, channels, fp?sizeof(float):sizeof(short),
+           wav_format, channel_map, expected_size>=0?expected_size/
+           ((opus_int64)(fp?sizeof(float):sizeof(short))*channels):-1)<0)
+      {
+         fprintf(stderr, "Memory allocation failure.\n");
+         pcm_planar_clear(&planar_buf);
+         exit_code=1;
+         goto cleanup;
+      }
+      planar=&planar_buf;
+   }
+   else if (wav_format&&(channels==3||channels>4))
+   {
+      int ci;
+      for (ci=0;ci<channels;ci++)
+      {
+         channel_map[ci]=ci;
+      }
+      adjust_wav_mapping(mapping_family, channels, channel_map);
       permuted_output=malloc(sizeof(float)*MAX_FRAME_SIZE*channels);
       if (!permuted_output)
       {
@@ -1010,12 +2141,95 @@ int main(int argc, char **argv)
       }
    }
 
+   /*Normal players should just play at 48000 or their maximum rate,
+     as described in the OggOpus spec.  But for commandline tools
+     like opusdec it can be desirable to exactly preserve the original
+     sampling rate and duration, so we have a resampler here.*/
+   if (main_output && rate!=48000)
+   {
+      int err;
+      resampler = speex_resampler_init(channels, 48000, rate,
+       resample_quality, &err);
+      if (err!=0)
+      {
+         fprintf(stderr, "resampler error: %s\n",
+          speex_resampler_strerror(err));
+         exit_code=1;
+         goto cleanup;
+      }
+      /*Playback is live, so trade some passband for half the filter delay.*/
+      if (!file_output) speex_resampler_set_low_latency(resampler, 1);
+      speex_resampler_skip_zeros(resampler);
+   }
+
+   if (nsinks>0)
+   {
+      int si;
+      for (si=0;si<nsinks;si++)
+      {
+         opus_int64 sink_samples=-1;
+         if (strcmp(sinks[si].path,"-")!=0)
+            sink_samples=expected_samples(st, sinks[si].rate);
+         if (output_sink_open(&sinks[si], channels, mapping_family,
+              MAX_FRAME_SIZE, resample_quality, sink_dither, sink_samples)<0)
+         {
+            while (si>=0) output_sink_close(&sinks[si--], 0);
+            exit_code=1;
+            goto cleanup;
+         }
+         if (!quiet)
+         {
+            fprintf(stderr, "Writing %s: %d Hz, %d %s, %s\n", sinks[si].path,
+             sinks[si].rate, sinks[si].channels,
+             sinks[si].channels>1?"channels":"channel",
+             sinks[si].fp?"float":"16-bit");
+         }
+      }
+      sinkgroup=sink_group_create(sinks, nsinks, channels, MAX_FRAME_SIZE,
+       sink_threads);
+      if (!sinkgroup)
+      {
+         fprintf(stderr, "Memory allocation failure.\n");
+         for (si=0;si<nsinks;si++) output_sink_close(&sinks[si], 0);
+         exit_code=1;
+         goto cleanup;
+      }
+   }
+
    /*If we're simulating packet loss or saving range data, then we need to
      install a decoder callback.*/
-   if (loss_percent>0 || frange!=NULL)
+   if (loss!=NULL || frange!=NULL || nselect>0)
    {
-      cb_ctx.loss_percent=loss_percent;
+      cb_ctx.loss=loss;
       cb_ctx.frange=frange;
+      cb_ctx.of=st;
+      cb_ctx.select_list=select_list;
+      cb_ctx.nselect=nselect;
+      cb_ctx.select_streams=select_streams;
+      cb_ctx.select_li=-1;
+      cb_ctx.packet_buf_size=0;
+      cb_ctx.packet_index=0;
+      cb_ctx.decided_index=0;
+      memset(cb_ctx.nb_packets, 0, sizeof(cb_ctx.nb_packets));
+      memset(cb_ctx.decode_time, 0, sizeof(cb_ctx.decode_time));
+      if (fec)
+      {
+         cb_ctx.peek=op_open_url(inFile,NULL,NULL);
+         if (cb_ctx.peek==NULL)
+         {
+            cb_ctx.peek=op_open_file(inFile,NULL);
+         }
+         if (cb_ctx.peek==NULL)
+         {
+            fprintf(stderr, "Failed to open '%s' for --fec.\n", inFile);
+            exit_code=1;
+            goto cleanup;
+         }
+         cb_ctx.next.size=0;
+         cb_ctx.next.index=0;
+         op_set_decode_callback(cb_ctx.peek, (op_decode_cb_func)peek_cb,
+          &cb_ctx);
+      }
       op_set_decode_callback(st, (op_decode_cb_func)decode_cb, &cb_ctx);
    }
 
@@ -1023,6 +2237,8 @@ int main(int argc, char **argv)
    while (1)
    {
       opus_int64 outsamp;
+      opus_int64 prev_link_read=0;
+      int new_link;
       int nb_read;
       int i;
       if (force_stereo)
@@ -1030,6 +2246,9 @@ int main(int argc, char **argv)
          nb_read=op_read_float_stereo(st,
           output, MAX_FRAME_SIZE*channels);
          li = op_current_link(st);
+      } else if (decoded) {
+         nb_read=op_read_float(st,
+          decoded, MAX_FRAME_SIZE*decoded_channels, &li);
       } else {
          nb_read=op_read_float(st,
           output, MAX_FRAME_SIZE*channels, &li);
@@ -1054,26 +2273,41 @@ int main(int argc, char **argv)
          }
          break;
       }
+      new_link=0;
       if (li!=old_li)
       {
+         /*The --output sinks flush the previous link with the next frame.*/
+         new_link=old_li>=0;
+         prev_link_read=link_read;
          /*Drain and reset the resampler to be sure we get an accurate number
            of output samples.*/
          if (resampler!=NULL)
          {
-            drain_resampler(fout, file_output, resampler, channels, rate,
-             link_read, link_out, clipmem, dither?&shapemem:NULL, &audio_size,
-             fp);
-            /*Neither speex_resampler_reset_mem() nor
-              speex_resampler_skip_zeros() clear the number of fractional
-              samples properly, so we just destroy it. It will get re-created
-              below.*/
-            speex_resampler_destroy(resampler);
-            resampler=NULL;
+            drain_resampler(fout, prealloc, planar, file_output, resampler, channels,
+             rate, link_read, link_out, clipmem, dither?&shapemem:NULL,
+             &audio_size, fp);
+            /*The output rate and channel count never change between links,
+              so the same resampler (and its filter table) can be reused once
+              its history is cleared.*/
+            speex_resampler_reset_mem(resampler);
+            speex_resampler_skip_zeros(resampler);
          }
          /*We've encountered a new link.*/
          link_read=link_out=0;
          head=op_head(st, li);
-         if (!force_stereo && channels!=head->channel_count)
+         if (nselect>0)
+         {
+            if (select_channels(select_list, nselect, select_streams, head,
+                 select_map, select_decode)!=channels)
+            {
+               fprintf(stderr,
+                "Error: the %s list does not match a chained stream: "
+                "aborting.\n", select_streams?"--streams":"--channels");
+               exit_code=1;
+               break;
+            }
+         }
+         else if (!force_stereo && channels!=head->channel_count)
          {
             /*In theory if the first link was stereo, we could downmix the
               remaining links, but we've already decoded the first packet, and
@@ -1101,8 +2335,22 @@ int main(int argc, char **argv)
                /*Clear the progress indicator from the previous link.*/
                fprintf(stderr, "\r");
             }
-            fprintf(stderr, "Decoding to %d Hz (%d %s)", rate,
-              channels, channels>1?"channels":"channel");
+            if (main_output)
+            {
+               fprintf(stderr, "Decoding to %d Hz (%d %s)", rate,
+                 channels, channels>1?"channels":"channel");
+            } else {
+               fprintf(stderr, "Decoding (%d %s)",
+                 channels, channels>1?"channels":"channel");
+            }
+            if (resampler)
+            {
+               int low_latency;
+               speex_resampler_get_low_latency(resampler, &low_latency);
+               fprintf(stderr, ", resampler delay %.2f ms%s",
+                speex_resampler_get_input_latency(resampler)*1000./48000,
+                low_latency?" (low latency)":"");
+            }
             if (head->version!=1)
             {
                fprintf(stderr, ", Header v%d",head->version);
@@ -1140,6 +2388,26 @@ int main(int argc, char **argv)
          }
       }
       old_li=li;
+      if (decoded)
+      {
+         int link_channels;
+         int ci;
+         link_channels=head->channel_count;
+         for (i=0;i<nb_read;i++)
+         {
+            for (ci=0;ci<channels;ci++)
+            {
+               output[i*channels+ci]=
+                decoded[i*link_channels+select_map[ci]];
+            }
+         }
+      }
+      if (sinkgroup)
+      {
+         sink_group_write(sinkgroup, output, nb_read, new_link,
+          prev_link_read, link_read);
+      }
+      if (!main_output) continue;
       if (permuted_output!=NULL)
       {
          int ci;
@@ -1152,37 +2420,69 @@ int main(int argc, char **argv)
             }
          }
       }
-      /*Normal players should just play at 48000 or their maximum rate,
-        as described in the OggOpus spec.  But for commandline tools
-        like opusdec it can be desirable to exactly preserve the original
-        sampling rate and duration, so we have a resampler here.*/
-      if (rate!=48000 && resampler==NULL)
-      {
-         int err;
-         resampler = speex_resampler_init(channels, 48000, rate, 5, &err);
-         if (err!=0)
-         {
-            fprintf(stderr, "resampler error: %s\n",
-             speex_resampler_strerror(err));
-         }
-         speex_resampler_skip_zeros(resampler);
-      }
       outsamp=audio_write(permuted_output?permuted_output:output, channels,
-       nb_read, fout, resampler, clipmem, dither?&shapemem:0, file_output,
-       rate, link_read, link_out, fp);
+       nb_read, fout, prealloc, planar, resampler, clipmem, dither?&shapemem:0,
+       file_output, rate, link_read, link_out, fp);
       link_out+=outsamp;
       audio_size+=(fp?sizeof(float):sizeof(short))*outsamp*channels;
+      /*With --follow, whatever reads the output is usually live too.*/
+      if (follow && fout) fflush(fout);
    }
 
    if (resampler!=NULL)
    {
-      drain_resampler(fout, file_output, resampler, channels, rate,
-       link_read, link_out, clipmem, dither?&shapemem:NULL, &audio_size, fp);
+      drain_resampler(fout, prealloc, planar, file_output, resampler, channels,
+       rate, link_read, link_out, clipmem, dither?&shapemem:NULL, &audio_size,
+       fp);
       speex_resampler_destroy(resampler);
    }
 
+   if (sinkgroup && sink_group_close(sinkgroup, link_read)>0) exit_code=1;
+   sinkgroup=NULL;
+
+   if (!quiet && loss!=NULL)
+   {
+      static const char *outcome_names[PACKET_OUTCOMES]={
+         "decoded", "FEC", "concealed"
+      };
+      int outcome;
+      fprintf(stderr, "Lost %" I64FORMAT " of %" I64FORMAT " packets: "
+       "%" I64FORMAT " recovered with FEC, %" I64FORMAT " concealed.\n",
+       cb_ctx.nb_packets[PACKET_RECOVERED]+cb_ctx.nb_packets[PACKET_CONCEALED],
+       cb_ctx.packet_index, cb_ctx.nb_packets[PACKET_RECOVERED],
+       cb_ctx.nb_packets[PACKET_CONCEALED]);
+      /*Concealment usually costs much less than decoding, and FEC a little
+        more, which matters when sizing receivers for lossy networks.*/
+      fprintf(stderr, "Decoder time per packet:\n");
+      for (outcome=0;outcome<PACKET_OUTCOMES;outcome++)
+      {
+         if (cb_ctx.nb_packets[outcome]==0) continue;
+         fprintf(stderr, "  %-10s %8.1f us  (%" I64FORMAT " packets)\n",
+          outcome_names[outcome],
+          1e6*cb_ctx.decode_time[outcome]/cb_ctx.nb_packets[outcome],
+          cb_ctx.nb_packets[outcome]);
+      }
+   }
+
    /*If we were writing wav, go set the duration.*/
-   if (fout && wav_format>0 && update_wav_header(fout, wav_format, audio_size)<0)
+   if (planar)
+   {
+      if (pcm_planar_finish(planar)<0)
+      {
+         fprintf(stderr, "Error writing output.\n");
+         exit_code=1;
+      }
+   }
+   else if (prealloc)
+   {
+      if (pcm_prealloc_finish(prealloc, fout, wav_format, audio_size)<0)
+      {
+         fprintf(stderr, "Warning: Cannot update audio size in output file;"
+            " size will be incorrect.\n");
+      }
+   }
+   else if (fout && wav_format>0
+      && update_wav_header(fout, wav_format, audio_size)<0)
    {
       fprintf(stderr, "Warning: Cannot update audio size in output file;"
          " size will be incorrect.\n");
@@ -1197,11 +2497,25 @@ cleanup:
    if (shapemem.b_buf) free(shapemem.b_buf);
    if (output) free(output);
    if (permuted_output) free(permuted_output);
+   free(decoded);
+   free(cb_ctx.packet_buf);
+   free(cb_ctx.next.data);
+   if (cb_ctx.peek) op_free(cb_ctx.peek);
    if (fout) fclose(fout);
+   if (planar) pcm_planar_clear(planar);
+   if (split_files)
+   {
+      int ci;
+      for (ci=0;ci<channels;ci++) fclose(split_files[ci]);
+   }
+   if (sinkgroup) sink_group_close(sinkgroup, link_read);
 
 done:
+   free(sinks);
+   free(split_files);
    if (frange) fclose(frange);
    if (st) op_free(st);
+   loss_model_destroy(loss);
 #ifdef WIN_UNICODE
    free_commandline_arguments_utf8(&argc_utf8, &argv_utf8);
    uninit_console_utf8();
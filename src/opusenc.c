@@ -76,6 +76,7 @@
 #include "encoder.h"
 #include "diag_range.h"
 #include "cpusupport.h"
+#include "pcm_kernels.h"
 
 /* printf format specifier for opus_int64 */
 #if !defined opus_int64 && defined PRId64
@@ -182,10 +183,16 @@ static void usage(void)
   printf(" --raw-chan n       Set number of channels for raw input (default: 2)\n");
   printf(" --raw-endianness n 1 for big endian, 0 for little (default: 0)\n");
   printf(" --ignorelength     Ignore the data length in Wave headers\n");
+  printf(" --follow           Keep reading a Wave or raw input file that is still\n");
+  printf("                      being written, and flush each page as it is made\n");
+  printf(" --follow-timeout n Stop following after n seconds without new data\n");
+  printf("                      (default: 10, 0 waits forever)\n");
+  printf(" --follow-sentinel f Stop following once the file f exists\n");
   printf(" --channels fmt     Override the format of the input channels (ambix, discrete)\n");
   printf("\nDiagnostic options:\n");
   printf(" --serial n         Force use of a specific stream serial number\n");
   printf(" --save-range file  Save check values for every frame to a file\n");
+  printf(" --cpu-info         Show the detected CPU features and kernels\n");
   printf(" --set-ctl-int x=y  Pass the encoder control x with value y (advanced)\n");
   printf("                      Preface with s: to direct the ctl to multistream s\n");
   printf("                      This may be used multiple times\n");
@@ -273,6 +280,7 @@ typedef struct {
   opus_int32 nb_streams;
   opus_int32 nb_coupled;
   FILE *frange;
+  int flush;
 } EncData;
 
 static int write_callback(void *user_data, const unsigned char *ptr, opus_int32 len)
@@ -280,7 +288,9 @@ static int write_callback(void *user_data, const unsigned char *ptr, opus_int32
   EncData *data = (EncData*)user_data;
   data->bytes_written += len;
   data->pages_out++;
-  return fwrite(ptr, 1, len, data->fout) != (size_t)len;
+  if (fwrite(ptr, 1, len, data->fout) != (size_t)len) return 1;
+  /*With --follow, readers should see each page as soon as it is muxed.*/
+  return data->flush && fflush(data->fout) != 0;
 }
 
 static int close_callback(void *user_data)
@@ -413,6 +423,7 @@ int main(int argc, char **argv)
     {"max-delay", required_argument, NULL, 0},
     {"serial", required_argument, NULL, 0},
     {"save-range", required_argument, NULL, 0},
+    {"cpu-info", no_argument, NULL, 0},
     {"set-ctl-int", required_argument, NULL, 0},
     {"help", no_argument, NULL, 0},
     {"help-picture", no_argument, NULL, 0},
@@ -424,6 +435,9 @@ int main(int argc, char **argv)
     {"raw-endianness", required_argument, NULL, 0},
     {"raw-float", no_argument, NULL, 0},
     {"ignorelength", no_argument, NULL, 0},
+    {"follow", no_argument, NULL, 0},
+    {"follow-timeout", required_argument, NULL, 0},
+    {"follow-sentinel", required_argument, NULL, 0},
     {"version", no_argument, NULL, 0},
     {"version-short", no_argument, NULL, 0},
     {"comment", required_argument, NULL, 0},
@@ -453,6 +467,7 @@ int main(int argc, char **argv)
   char               *outFile;
   char               *range_file;
   FILE               *fin;
+  follow_state       follow_st;
   char               ENCODER_string[1024];
   /*Counters*/
   int                nb_samples;
@@ -462,6 +477,9 @@ int main(int argc, char **argv)
   int                last_spin_len=0;
   /*Settings*/
   int                quiet=0;
+  int                follow=0;
+  double             follow_timeout=10;
+  const char         *follow_sentinel=NULL;
   opus_int32         bitrate=-1;
   opus_int32         rate=48000;
   int                frame_size=960;
@@ -514,6 +532,7 @@ int main(int argc, char **argv)
   inopt.rawmode=0;
   inopt.rawmode_f=0;
   inopt.ignorelength=0;
+  inopt.follow=NULL;
   inopt.copy_comments=1;
   inopt.copy_pictures=1;
 
@@ -545,6 +564,7 @@ int main(int argc, char **argv)
   data.nb_streams = 1;
   data.nb_coupled = 0;
   data.frange = NULL;
+  data.flush = 0;
 
   /*Process command-line options*/
   cline_size=0;
@@ -588,9 +608,27 @@ int main(int argc, char **argv)
         } else if (strcmp(optname, "version-short")==0) {
           opustoolsversion_short(opus_version);
           exit(0);
+        } else if (strcmp(optname, "cpu-info")==0) {
+          cpu_print_info(stdout);
+          printf("Kernels:\n");
+          pcm_kernels_print_info(stdout);
+          exit(0);
         } else if (strcmp(optname, "ignorelength")==0) {
           inopt.ignorelength=1;
           save_cmd=0;
+        } else if (strcmp(optname, "follow")==0) {
+          follow=1;
+          save_cmd=0;
+        } else if (strcmp(optname, "follow-timeout")==0) {
+          follow_timeout=atof(optarg);
+          if (follow_timeout<0) {
+            fatal("Invalid follow-timeout: %s\n"
+              "Value is in seconds and must not be negative.\n", optarg);
+          }
+          save_cmd=0;
+        } else if (strcmp(optname, "follow-sentinel")==0) {
+          follow_sentinel=optarg;
+          save_cmd=0;
         } else if (strcmp(optname, "raw")==0) {
           inopt.rawmode=1;
           save_cmd=0;
@@ -905,6 +943,17 @@ int main(int argc, char **argv)
     }
   }
 
+  if (follow) {
+    if (fin==stdin) {
+      fatal("Error: --follow needs an input file, not stdin\n");
+    }
+    if (follow_init(&follow_st, inFile, follow_timeout, follow_sentinel)<0) {
+      fatal("Error: cannot watch %s for --follow\n", inFile);
+    }
+    inopt.follow=&follow_st;
+    data.flush=1;
+  }
+
   if (inopt.rawmode) {
     in_format = &raw_format;
     in_format->open_func(fin, &inopt, NULL, 0);
@@ -914,6 +963,11 @@ int main(int argc, char **argv)
     fatal("Error: unsupported input file: %s\n", inFile);
   }
 
+  if (follow && in_format->open_func!=wav_open
+      && in_format->open_func!=raw_open) {
+    fatal("Error: --follow only works with Wave and raw input\n");
+  }
+
   if (inopt.rate<100||inopt.rate>768000) {
     /*Crazy rates excluded to avoid excessive memory usage for padding/resampling.*/
     fatal("Error: unsupported sample rate in input file: %ld Hz\n", inopt.rate);
@@ -1235,6 +1289,7 @@ int main(int argc, char **argv)
   if (downmix) clear_downmix(&inopt);
   in_format->close_func(inopt.readdata);
   if (fin) fclose(fin);
+  if (follow) follow_clear(&follow_st);
   if (data.frange) fclose(data.frange);
 #ifdef WIN_UNICODE
   free_commandline_arguments_utf8(&argc_utf8, &argv_utf8);
@@ -0,0 +1,96 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: opusindex.c
+   Looks up seek positions in an opusinfo --write-index file
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Prints the links of a seek index written by opusinfo --write-index, or,
+   given times in seconds, the byte offset to read from for each of them,
+   as a player or an HTTP range server would find it. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "opus_index.h"
+
+int main(int argc, char **argv)
+{
+  opus_index *index;
+  FILE *file;
+  int i;
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s index.idx [seconds ...]\n", argv[0]);
+    return 1;
+  }
+  file = fopen(argv[1], "rb");
+  if (!file)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  index = opus_index_read(file);
+  fclose(file);
+  if (!index)
+  {
+    fprintf(stderr, "%s: not a valid seek index\n", argv[1]);
+    return 1;
+  }
+  if (argc == 2)
+  {
+    printf("Interval: %d ms\n", index->interval_ms);
+    for (i = 0; i < index->nlinks; i++)
+    {
+      const opus_index_link *link = &index->links[i];
+      printf("Link %d: serial %08lx, headers at %lld, %.3f s, %d entries\n",
+        i, (unsigned long)link->serial, (long long)link->offset,
+        link->start_granule < 0 ? 0 :
+        (link->last_granule - link->start_granule)/48000.,
+        link->nentries);
+    }
+  }
+  for (i = 2; i < argc; i++)
+  {
+    int link;
+    ogg_int64_t offset;
+    ogg_int64_t granulepos;
+    if (opus_index_seek(index, atof(argv[i]), &link, &offset,
+        &granulepos) != 0)
+    {
+      printf("%s: past the end\n", argv[i]);
+      continue;
+    }
+    printf("%s: link %d, headers at %lld, read from %lld (granule %lld)\n",
+      argv[i], link, (long long)index->links[link].offset,
+      (long long)offset, (long long)granulepos);
+  }
+  opus_index_free(index);
+  return 0;
+}
@@ -27,11 +27,21 @@
 /*No NLS support for now*/
 #define _(X) (X)
 
+#include "arena.h"
 #include "opusinfo.h"
 #include "opus_header.h"
+#include "packet_stats.h"
 #include "info_opus.h"
 #include "picture.h"
 #include "tagcompare.h"
+#include "text_kernels.h"
+#include "page_scan.h"
+#include "opus_index.h"
+#include "file_reader.h"
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #if defined WIN32 || defined _WIN32
 # include "unicode_support.h"
@@ -41,62 +51,331 @@
 # define argv_utf8 argv
 #endif
 
+/* Macros for handling potentially large file offsets */
+#if defined WIN32 || defined _WIN32
+# define OFF_T __int64
+# define FSEEK _fseeki64
+# define FTELL _ftelli64
+#elif defined HAVE_FSEEKO
+# define OFF_T off_t
+# define FSEEK fseeko
+# define FTELL ftello
+#else
+# define OFF_T long
+# define FSEEK fseek
+# define FTELL ftell
+#endif
+
 #define CHUNK 4500
 
-static int printlots = 0;
-static int printinfo = 1;
-static int printwarn = 1;
-static int verbose = 1;
+/* The first and largest amounts read at a time by --quick when looking
+   backwards from the end of the file, as in libopusfile. */
+#define QUICK_CHUNK (65536)
+#define QUICK_CHUNK_MAX (1024*1024)
+/* The largest possible Ogg page. */
+#define MAX_PAGE_SIZE (65307)
 
-static int flawed;
+static int quick = 0;
+static int threads = 1;
+static int stats = 0;
+static char *index_path = NULL;
+static int index_interval_ms = 1000;
 
 #define CONSTRAINT_PAGE_AFTER_EOS   1
 #define CONSTRAINT_MUXING_VIOLATED  2
 
-static stream_set *create_stream_set(void)
+typedef struct {
+    const char *code;
+    int count;
+} oi_code_count;
+
+typedef struct {
+    oi_code_count *codes;
+    int used;
+    int allocated;
+} oi_code_list;
+
+struct oi_report {
+    int printinfo;
+    int printwarn;
+    int json;
+    int stats;
+    int flawed;
+    int open_failed;
+    /* With --jobs, the text is kept until the files before are printed. */
+    int buffered;
+    char *text;
+    size_t text_len;
+    size_t text_size;
+    oi_code_list warnings;
+    oi_code_list errors;
+    oi_stream_summary *streams;
+    int nstreams;
+    int streams_allocated;
+    int finished;
+};
+
+static void code_add(oi_code_list *list, const char *code, int count)
+{
+    int i;
+    for(i=0; i < list->used; i++) {
+        if(strcmp(list->codes[i].code, code) == 0) {
+            list->codes[i].count += count;
+            return;
+        }
+    }
+    if(list->used == list->allocated) {
+        int allocated = list->allocated ? 2*list->allocated : 8;
+        oi_code_count *codes = realloc(list->codes,
+                sizeof(*codes)*allocated);
+        if(!codes)
+            return;
+        list->codes = codes;
+        list->allocated = allocated;
+    }
+    list->codes[list->used].code = code;
+    list->codes[list->used].count = count;
+    list->used++;
+}
+
+static void report_init(oi_report *report, int verbose, int json,
+        int buffered)
+{
+    memset(report, 0, sizeof(*report));
+    report->printinfo = verbose >= 1 && !json;
+    report->printwarn = verbose >= 0 && !json;
+    report->json = json;
+    report->stats = stats && !quick;
+    report->buffered = buffered;
+}
+
+static void report_clear(oi_report *report)
+{
+    int i;
+    for(i=0; i < report->nstreams; i++)
+        free(report->streams[i].stats);
+    free(report->text);
+    free(report->warnings.codes);
+    free(report->errors.codes);
+    free(report->streams);
+}
+
+static void report_vprint(oi_report *report, const char *format, va_list ap)
+{
+    va_list aq;
+    int len;
+
+    if(report->json)
+        return;
+    if(!report->buffered) {
+        vfprintf(stdout, format, ap);
+        return;
+    }
+    va_copy(aq, ap);
+    len = vsnprintf(NULL, 0, format, aq);
+    va_end(aq);
+    if(len < 0)
+        return;
+    if(report->text_len + len + 1 > report->text_size) {
+        size_t size = 2*report->text_size + len + 1;
+        char *text = realloc(report->text, size);
+        if(!text)
+            return;
+        report->text = text;
+        report->text_size = size;
+    }
+    vsnprintf(report->text + report->text_len, len + 1, format, ap);
+    report->text_len += len;
+}
+
+static void report_print(oi_report *report, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    report_vprint(report, format, ap);
+    va_end(ap);
+}
+
+oi_stream_summary *oi_stream(oi_report *report, int num)
+{
+    if(num > report->streams_allocated) {
+        int allocated = report->streams_allocated ?
+                2*report->streams_allocated : 8;
+        oi_stream_summary *streams;
+        if(allocated < num)
+            allocated = num;
+        streams = realloc(report->streams, sizeof(*streams)*allocated);
+        if(!streams)
+            return NULL;
+        report->streams = streams;
+        report->streams_allocated = allocated;
+    }
+    if(num > report->nstreams) {
+        oi_stream_summary *streams = report->streams;
+        while(report->nstreams < num) {
+            oi_stream_summary *stream = &streams[report->nstreams++];
+            stream->num = report->nstreams;
+            stream->serial = 0;
+            stream->type = "unknown";
+            stream->channels = -1;
+            stream->preskip = -1;
+            stream->input_sample_rate = -1;
+            stream->duration = -1;
+            stream->bitrate = -1;
+            stream->stats = NULL;
+        }
+    }
+    return &report->streams[num-1];
+}
+
+/* An entry of the index of a stream_set. Once a stream has ended, its
+   processor is freed, and the entry keeps what is needed to report pages
+   found after the end. Empty entries have a num of 0. */
+struct _stream_entry {
+    ogg_uint32_t serial;
+    int num;
+    stream_processor *stream;
+    long seqno;
+    int lostseq;
+    int start;
+};
+
+#define INDEX_SIZE (64)
+
+int oi_want_stats(oi_report *report)
+{
+    return report->stats;
+}
+
+static stream_set *create_stream_set(oi_report *report, arena *mem)
 {
     stream_set *set = calloc(1, sizeof(stream_set));
 
-    set->streams = calloc(5, sizeof(stream_processor));
-    set->allocated = 5;
+    set->streams = calloc(8, sizeof(*set->streams));
+    set->allocated = 8;
     set->used = 0;
+    set->index = calloc(INDEX_SIZE, sizeof(*set->index));
+    set->index_size = INDEX_SIZE;
+    set->count = 0;
+    set->report = report;
+    set->mem = mem;
 
     return set;
 }
 
-void oi_info(char *format, ...)
+/* Returns the entry for serial, or the empty entry where it would go. */
+static stream_entry *index_lookup(stream_set *set, ogg_uint32_t serial)
+{
+    ogg_uint32_t mask = set->index_size - 1;
+    ogg_uint32_t i = serial*0x9E3779B1U;
+
+    for(i = (i ^ i >> 16) & mask; ; i = (i + 1) & mask) {
+        stream_entry *entry = &set->index[i];
+        if(!entry->num || entry->serial == serial)
+            return entry;
+    }
+}
+
+/* Makes room for one more entry, keeping the index at most half full. */
+static int index_reserve(stream_set *set)
+{
+    stream_entry *old = set->index;
+    int old_size = set->index_size;
+    int i;
+
+    if(2*(set->count + 1) <= set->index_size)
+        return 0;
+    set->index = calloc(2*old_size, sizeof(*set->index));
+    if(!set->index) {
+        set->index = old;
+        return -1;
+    }
+    set->index_size = 2*old_size;
+    for(i=0; i < old_size; i++) {
+        if(old[i].num)
+            *index_lookup(set, old[i].serial) = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+/* Adds a processor to the streams that have not ended. */
+static stream_processor *add_stream(stream_set *set)
+{
+    stream_processor *stream;
+
+    if(set->used == set->allocated) {
+        stream_processor **streams = realloc(set->streams,
+                sizeof(*streams)*2*set->allocated);
+        if(!streams)
+            return NULL;
+        set->streams = streams;
+        set->allocated *= 2;
+    }
+    stream = arena_calloc(set->mem, sizeof(*stream));
+    if(!stream)
+        return NULL;
+    stream->mem = set->mem;
+    set->streams[set->used++] = stream;
+    return stream;
+}
+
+/* Recycles a stream once it has ended, so that chained files with many
+   links do not keep every link in memory. Its summary is already in the
+   report. */
+static void retire_stream(stream_set *set, stream_processor *stream)
+{
+    stream_entry *entry = index_lookup(set, stream->serial);
+    int i;
+
+    entry->stream = NULL;
+    entry->seqno = stream->seqno;
+    entry->lostseq = stream->lostseq;
+    entry->start = stream->start;
+    for(i=0; set->streams[i] != stream; i++);
+    memmove(&set->streams[i], &set->streams[i+1],
+            sizeof(*set->streams)*(set->used - i - 1));
+    set->used--;
+    ogg_stream_clear(&stream->os);
+    arena_recycle(set->mem, stream, sizeof(*stream));
+}
+
+void oi_info(oi_report *report, char *format, ...)
 {
     va_list ap;
 
-    if(!printinfo)
+    if(!report->printinfo)
         return;
 
     va_start(ap, format);
-    vfprintf(stdout, format, ap);
+    report_vprint(report, format, ap);
     va_end(ap);
 }
 
-void oi_warn(char *format, ...)
+void oi_warn(oi_report *report, const char *code, char *format, ...)
 {
     va_list ap;
 
-    flawed = 1;
-    if(!printwarn)
+    report->flawed = 1;
+    code_add(&report->warnings, code, 1);
+    if(!report->printwarn)
         return;
 
     va_start(ap, format);
-    vfprintf(stdout, format, ap);
+    report_vprint(report, format, ap);
     va_end(ap);
 }
 
-void oi_error(char *format, ...)
+void oi_error(oi_report *report, const char *code, char *format, ...)
 {
     va_list ap;
 
-    flawed = 1;
+    report->flawed = 1;
+    code_add(&report->errors, code, 1);
 
     va_start(ap, format);
-    vfprintf(stdout, format, ap);
+    report_vprint(report, format, ap);
     va_end(ap);
 }
 
@@ -106,7 +385,11 @@ void oi_error(char *format, ...)
 void check_xiph_comment(stream_processor *stream, int i, const char *comment,
     int comment_length)
 {
-    const char *sep = strchr(comment, '=');
+    /* The comment is read where it is in the packet, so it is not NUL
+       terminated. Only the text up to any NUL is printed. */
+    const char *nul = memchr(comment, 0, comment_length);
+    int text_length = nul ? (int)(nul - comment) : comment_length;
+    const char *sep = memchr(comment, '=', text_length);
     int j;
     int broken = 0;
     unsigned char *val;
@@ -114,17 +397,17 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
     int remaining;
 
     if(sep == NULL) {
-        oi_warn(_("WARNING: Comment %d in stream %d has invalid "
-              "format, does not contain '=': \"%s\"\n"),
-              i, stream->num, comment);
+        oi_warn(stream->report, "comment_no_equals", _("WARNING: Comment %d in stream %d has invalid "
+              "format, does not contain '=': \"%.*s\"\n"),
+              i, stream->num, text_length, comment);
              return;
     }
 
     for(j=0; j < sep-comment; j++) {
         if(comment[j] < 0x20 || comment[j] > 0x7D) {
-            oi_warn(_("WARNING: Invalid comment tag in "
-                   "comment %d (stream %d): \"%s\"\n"),
-                   i, stream->num, comment);
+            oi_warn(stream->report, "comment_bad_tag", _("WARNING: Invalid comment tag in "
+                   "comment %d (stream %d): \"%.*s\"\n"),
+                   i, stream->num, text_length, comment);
             return;
         }
     }
@@ -132,6 +415,10 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
     val = (unsigned char *)comment;
 
     j = sep-comment+1;
+    /* Most comments are valid, so check them quickly first, and only walk
+       the sequences one at a time to report what is wrong. */
+    if(text_kernels()->utf8_valid(val+j, comment_length-j))
+        j = comment_length;
     while(j < comment_length)
     {
         remaining = comment_length - j;
@@ -149,7 +436,7 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
             else if((val[j] & 0x02) == 0)
                 bytes = 6;
             else {
-                oi_warn(_("WARNING: Illegal UTF-8 sequence in "
+                oi_warn(stream->report, "comment_bad_utf8", _("WARNING: Illegal UTF-8 sequence in "
                     "comment %d (stream %d): length marker wrong\n"),
                     i, stream->num);
                 broken = 1;
@@ -157,14 +444,14 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
             }
         }
         else {
-            oi_warn(_("WARNING: Illegal UTF-8 sequence in comment "
+            oi_warn(stream->report, "comment_bad_utf8", _("WARNING: Illegal UTF-8 sequence in comment "
                 "%d (stream %d): length marker wrong\n"), i, stream->num);
             broken = 1;
             break;
         }
 
         if(bytes > remaining) {
-            oi_warn(_("WARNING: Illegal UTF-8 sequence in comment "
+            oi_warn(stream->report, "comment_bad_utf8", _("WARNING: Illegal UTF-8 sequence in comment "
                 "%d (stream %d): too few bytes\n"), i, stream->num);
             broken = 1;
             break;
@@ -223,11 +510,19 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
          }
 
          if(broken) {
-             char *simple = malloc(comment_length + 1);
-             char *seq = malloc(comment_length * 3 + 1);
+             arena_mark mark;
+             char *simple;
+             char *seq;
              static char hex[] = {'0', '1', '2', '3', '4', '5', '6', '7',
                                   '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
              int k, c1 = 0, c2 = 0;
+             arena_get_mark(stream->mem, &mark);
+             simple = arena_alloc(stream->mem, comment_length + 1);
+             seq = arena_alloc(stream->mem, (size_t)comment_length * 3 + 1);
+             if(simple == NULL || seq == NULL) {
+                 arena_release(stream->mem, &mark);
+                 break;
+             }
              for (k = 0; k < comment_length; k++) {
                seq[c1++] = hex[((unsigned char)comment[k]) >> 4];
                seq[c1++] = hex[((unsigned char)comment[k]) & 0xf];
@@ -240,12 +535,11 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
              }
              seq[c1] = 0;
              simple[c2] = 0;
-             oi_warn(_("WARNING: Illegal UTF-8 sequence in comment "
+             oi_warn(stream->report, "comment_bad_utf8", _("WARNING: Illegal UTF-8 sequence in comment "
                    "%d (stream %d): invalid sequence \"%s\": %s\n"), i,
                    stream->num, simple, seq);
              broken = 1;
-             free(simple);
-             free(seq);
+             arena_release(stream->mem, &mark);
              break;
          }
 
@@ -266,104 +560,73 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
          ogg_uint32_t   file_height;
          ogg_uint32_t   file_depth;
          ogg_uint32_t   file_colors;
-         unsigned char *data;
+         base64_data    b64;
+         arena_mark     mark;
+         unsigned char  buf[256];
+         char          *mime_type;
+         char          *description;
          int            data_sz;
          int            len;
+         int            n;
          int            is_url;
          int            format;
          int            has_palette;
          int            colors_set;
          len=comment_length - (sep+1-comment);
-         /*Decode the Base64 encoded data.*/
+         /*The Base64 encoded data is checked here, but only the parts that
+           are needed are decoded, so that a large picture is never copied.*/
          if(len&3) {
-             oi_warn(_("WARNING: Illegal Base64 length in "
+             oi_warn(stream->report, "picture_bad_base64", _("WARNING: Illegal Base64 length in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): %i is not "
                    "divisible by 4\n"), i, stream->num, len);
          }
-         len>>=2;
-         data_sz=3*len;
-         if(data_sz > 2) {
-             if(comment[comment_length - 1] == '=') {
-                 data_sz--;
-                 if(comment[comment_length - 2] == '=') {
-                     data_sz--;
-                 }
+         base64_data_init(&b64, sep+1, len);
+         data_sz=(int)b64.length;
+         for (j = 0; j < (len&~3); j++) {
+             unsigned c;
+             j += (int)text_kernels()->base64_span(sep+1+j, (len&~3)-j);
+             if(j >= (len&~3)) {
+                 break;
              }
-         }
-         data=data_sz>0?(unsigned char *)malloc(data_sz*sizeof(*data)):NULL;
-         for (j = 0; j < len; j++) {
-             ogg_uint32_t value;
-             int          k;
-             value = 0;
-             for (k = 1; k <= 4; k++) {
-                 unsigned c;
-                 unsigned d;
-                 c = (unsigned char)sep[4*j+k];
-                 if(c == '+') {
-                     d = 62;
-                 }
-                 else if(c == '/') {
-                     d = 63;
-                 }
-                 else if(c >= '0' && c <= '9') {
-                     d = 52+c-'0';
-                 }
-                 else if(c >= 'a' && c <= 'z') {
-                     d = 26+c-'a';
-                 }
-                 else if(c >= 'A' && c <= 'Z') {
-                     d = c-'A';
-                 }
-                 else if(c == '=') {
-                     if(3*j+k-1 < data_sz) {
-                         oi_warn(_("WARNING: Terminating '=' in illegal "
-                               "position in Base64 encoded "
-                               "METADATA_BLOCK_PICTURE comment %d (stream %d): "
-                               "%i characters before the end.\n"), i,
-                               stream->num, data_sz - (3*j+k-1));
-                         free(data);
-                         return;
-                     }
-                     d = 0;
-                 }
-                 else {
-                     oi_warn(_("WARNING: Illegal Base64 character in "
+             c = (unsigned char)sep[j+1];
+             if(c == '=') {
+                 if(3*(j>>2)+(j&3) < data_sz) {
+                     oi_warn(stream->report, "picture_bad_base64", _("WARNING: Terminating '=' in illegal "
+                           "position in Base64 encoded "
                            "METADATA_BLOCK_PICTURE comment %d (stream %d): "
-                           "'%c' (0x%02X)\n"), i, stream->num,
-                           (char)(c<0x20||c>0x7E?'?':c), c);
-                     free(data);
+                           "%i characters before the end.\n"), i,
+                           stream->num, data_sz - (3*(j>>2)+(j&3)));
                      return;
                  }
-                 value = value << 6 | d;
              }
-             data[3*j] = (unsigned char)(value>>16);
-             if(3*j+1 < data_sz) {
-                 data[3*j+1] = (unsigned char)(value>>8);
-                 if(3*j+2 < data_sz) {
-                     data[3*j+2] = (unsigned char)value;
-                 }
+             else if(!(c == '+' || c == '/' || (c >= '0' && c <= '9')
+                   || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+                 oi_warn(stream->report, "picture_bad_base64", _("WARNING: Illegal Base64 character in "
+                       "METADATA_BLOCK_PICTURE comment %d (stream %d): "
+                       "'%c' (0x%02X)\n"), i, stream->num,
+                       (char)(c<0x20||c>0x7E?'?':c), c);
+                 return;
              }
          }
          /*Now validate the METADATA_BLOCK_PICTURE structure.*/
          if(data_sz < 32) {
-             oi_warn(_("WARNING: Not enough data for "
+             oi_warn(stream->report, "picture_truncated", _("WARNING: Not enough data for "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "expected at least 32 bytes, got %i\n"), i, stream->num,
                    data_sz);
-             free(data);
              return;
          }
-         j = 0;
-         picture_type = READ_U32_BE(data+j);
+         base64_read(&b64, 0, buf, 8);
+         picture_type = READ_U32_BE(buf);
          if(picture_type > 20) {
-             oi_warn(_("WARNING: Unknown picture type in "
+             oi_warn(stream->report, "picture_bad_type", _("WARNING: Unknown picture type in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "%li\n"), i, stream->num, (long)picture_type);
              broken = 1;
          }
          if(picture_type >= 1 && picture_type <= 2) {
              if(stream->seen_file_icons & picture_type) {
-                 oi_warn(_("WARNING: Duplicate picture type in "
+                 oi_warn(stream->report, "picture_duplicate_icon", _("WARNING: Duplicate picture type in "
                        "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                        " %s\n"), i, stream->num, picture_type == 1 ?
                        _("only one picture of type 1 (32x32 icon) allowed") :
@@ -372,50 +635,64 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
              }
              stream->seen_file_icons |= picture_type;
          }
-         j += 4;
-         mime_type_length = READ_U32_BE(data+j);
+         mime_type_length = READ_U32_BE(buf+4);
          if(mime_type_length > (size_t)data_sz-32) {
-             oi_warn(_("WARNING: Invalid media type length in "
+             oi_warn(stream->report, "picture_bad_length", _("WARNING: Invalid media type length in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "%lu bytes when %i are available\n"), i, stream->num,
                    (long)mime_type_length, data_sz-32);
-             free(data);
              return;
          }
-         for (j += 4; j < 8+(int)mime_type_length; j++) {
-             if(data[j] < 0x20 || data[j] > 0x7E) {
-                 oi_warn(_("WARNING: Invalid character in media type of "
+         arena_get_mark(stream->mem, &mark);
+         mime_type = arena_alloc(stream->mem, (size_t)mime_type_length + 1);
+         if(mime_type == NULL) {
+             return;
+         }
+         base64_read(&b64, 8, (unsigned char *)mime_type, mime_type_length);
+         mime_type[mime_type_length] = '\0';
+         for (j = 0; j < (int)mime_type_length; j++) {
+             unsigned char c = (unsigned char)mime_type[j];
+             if(c < 0x20 || c > 0x7E) {
+                 oi_warn(stream->report, "picture_bad_mime", _("WARNING: Invalid character in media type of "
                        "METADATA_BLOCK_PICTURE comment %d (stream %d): "
-                       "0x%02X\n"), i, stream->num, data[j]);
+                       "0x%02X\n"), i, stream->num, c);
                  broken = 1;
              }
          }
-         description_length = READ_U32_BE(data+j);
+         j = 8+mime_type_length;
+         base64_read(&b64, j, buf, 4);
+         description_length = READ_U32_BE(buf);
          if(description_length > (size_t)data_sz-mime_type_length-32) {
-             oi_warn(_("WARNING: Invalid description length in "
+             oi_warn(stream->report, "picture_bad_length", _("WARNING: Invalid description length in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "%lu bytes when %i are available\n"), i, stream->num,
                    (long)description_length, data_sz-mime_type_length-32);
-             free(data);
+             arena_release(stream->mem, &mark);
              return;
          }
          /*TODO: Validate that description is UTF-8.*/
+         description = arena_alloc(stream->mem,
+               (size_t)description_length + 1);
+         if(description == NULL) {
+             arena_release(stream->mem, &mark);
+             return;
+         }
+         base64_read(&b64, j+4, (unsigned char *)description,
+               description_length);
+         description[description_length] = '\0';
          j += 4+description_length;
-         width = READ_U32_BE(data+j);
-         j += 4;
-         height = READ_U32_BE(data+j);
-         j += 4;
-         depth = READ_U32_BE(data+j);
-         j += 4;
-         colors = READ_U32_BE(data+j);
-         j += 4;
+         base64_read(&b64, j, buf, 20);
+         width = READ_U32_BE(buf);
+         height = READ_U32_BE(buf+4);
+         depth = READ_U32_BE(buf+8);
+         colors = READ_U32_BE(buf+12);
          /*If any value is non-zero, then they all MUST be valid values, and
            so colors should be treated as set (even if zero).*/
          colors_set = width != 0 || height != 0 || depth != 0 || colors != 0;
          /*This isn't triggered if colors == 0, since that can be a valid
            value.*/
          if((width == 0 || height == 0 || depth == 0) && colors_set) {
-             oi_warn(_("WARNING: Invalid picture parameters in "
+             oi_warn(stream->report, "picture_bad_params", _("WARNING: Invalid picture parameters in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "width (%i), height (%i), depth (%i), and colors (%i) MUST "
                    "either be set to valid values or all set to 0\n"), i,
@@ -423,138 +700,122 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
                    (int)colors);
              broken = 1;
          }
-         image_length = READ_U32_BE(data+j);
-         j += 4;
+         image_length = READ_U32_BE(buf+16);
+         j += 20;
          /*This one should match exactly.*/
          if(image_length != (size_t)data_sz-j) {
-             oi_warn(_("WARNING: Invalid image data size in "
+             oi_warn(stream->report, "picture_bad_length", _("WARNING: Invalid image data size in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "%lu bytes when %i are available\n"), i, stream->num,
                    (long)image_length, data_sz-j);
-             free(data);
+             arena_release(stream->mem, &mark);
              return;
          }
+         /*The first bytes of the image are enough to tell its format.*/
+         n = (int)base64_read(&b64, j, buf, 8);
          is_url = 0;
          format = -1;
          if(mime_type_length == 10
-               && tagcompare((const char*)data+8, "image/jpeg",
-                     mime_type_length) == 0) {
-             if(!is_jpeg(data+j, image_length)) {
-                 oi_warn(_("WARNING: Invalid image data in "
+               && tagcompare(mime_type, "image/jpeg", mime_type_length) == 0) {
+             if(!is_jpeg(buf, n)) {
+                 oi_warn(stream->report, "picture_bad_image", _("WARNING: Invalid image data in "
                        "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                        "media type is %.*s but image does not appear to be "
-                       "JPEG\n"), i, stream->num, mime_type_length, data+8);
-                 free(data);
+                       "JPEG\n"), i, stream->num, mime_type_length, mime_type);
+                 arena_release(stream->mem, &mark);
                  return;
              }
              format = PIC_FORMAT_JPEG;
          }
          else if(mime_type_length == 9
-               && tagcompare((const char *)data+8, "image/png",
-                     mime_type_length) == 0) {
-             if(!is_png(data+j, image_length)) {
-                 oi_warn(_("WARNING: Invalid image data in "
+               && tagcompare(mime_type, "image/png", mime_type_length) == 0) {
+             if(!is_png(buf, n)) {
+                 oi_warn(stream->report, "picture_bad_image", _("WARNING: Invalid image data in "
                        "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                        "media type is %.*s but image does not appear to be "
-                       "PNG\n"), i, stream->num, mime_type_length, data+8);
-                 free(data);
+                       "PNG\n"), i, stream->num, mime_type_length, mime_type);
+                 arena_release(stream->mem, &mark);
                  return;
              }
              format = PIC_FORMAT_PNG;
          }
          else if(mime_type_length == 9
-               && tagcompare((const char *)data+8, "image/gif",
-                     mime_type_length) == 0) {
-             if(!is_gif(data+j, image_length)) {
-                 oi_warn(_("WARNING: Invalid image data in "
+               && tagcompare(mime_type, "image/gif", mime_type_length) == 0) {
+             if(!is_gif(buf, n)) {
+                 oi_warn(stream->report, "picture_bad_image", _("WARNING: Invalid image data in "
                        "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                        "media type is %.*s but image does not appear to be "
-                       "PNG\n"), i, stream->num, mime_type_length, data+8);
-                 free(data);
+                       "PNG\n"), i, stream->num, mime_type_length, mime_type);
+                 arena_release(stream->mem, &mark);
                  return;
              }
              format = PIC_FORMAT_GIF;
          }
          else if(mime_type_length == 3
-               && strncmp((const char *)data+8, "-->", mime_type_length) == 0) {
+               && strncmp(mime_type, "-->", mime_type_length) == 0) {
              is_url = 1;
              /*TODO: validate URL.*/
          }
          else if(mime_type_length == 0 || (mime_type_length == 6 &&
-               tagcompare((const char *)data+8, "image/",
-                     mime_type_length) == 0)) {
-             if(is_jpeg(data+j, image_length)) {
+               tagcompare(mime_type, "image/", mime_type_length) == 0)) {
+             if(is_jpeg(buf, n)) {
                  format = PIC_FORMAT_JPEG;
              }
-             else if(is_png(data+j, image_length)) {
+             else if(is_png(buf, n)) {
                  format = PIC_FORMAT_PNG;
              }
-             else if(is_gif(data+j, image_length)) {
+             else if(is_gif(buf, n)) {
                  format = PIC_FORMAT_GIF;
              }
              else {
-                 oi_warn(_("WARNING: Unknown image format in "
+                 oi_warn(stream->report, "picture_unknown_format", _("WARNING: Unknown image format in "
                        "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                        "\"%.*s\" may not be well-supported\n"), i, stream->num,
-                       mime_type_length, data+8);
+                       mime_type_length, mime_type);
              }
          }
          else {
-             oi_warn(_("WARNING: Unknown media type in "
+             oi_warn(stream->report, "picture_unknown_mime", _("WARNING: Unknown media type in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "\"%.*s\" may not be well-supported\n"), i, stream->num,
-                   mime_type_length, data+8);
+                   mime_type_length, mime_type);
          }
          file_width = file_height = file_depth = file_colors = 0;
          has_palette = -1;
-         switch(format) {
-             case PIC_FORMAT_JPEG:
-                extract_jpeg_params(data+j, image_length,
-                      &file_width, &file_height, &file_depth, &file_colors,
-                      &has_palette);
-                break;
-             case PIC_FORMAT_PNG:
-                extract_png_params(data+j, image_length,
-                      &file_width, &file_height, &file_depth, &file_colors,
-                      &has_palette);
-                break;
-             case PIC_FORMAT_GIF:
-                extract_gif_params(data+j, image_length,
-                      &file_width, &file_height, &file_depth, &file_colors,
-                      &has_palette);
-                break;
-         }
+         extract_base64_params(&b64, j, image_length, format,
+               &file_width, &file_height, &file_depth, &file_colors,
+               &has_palette);
          if(format >= 0 && has_palette < 0) {
              /*We should have been able to affirmatively determine whether or
                not there was a palette if we parsed the image successfully.*/
-             oi_warn(_("WARNING: Could not parse image parameters in"
+             oi_warn(stream->report, "picture_bad_image", _("WARNING: Could not parse image parameters in"
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "possibly corrupt image?\n"), i, stream->num);
              broken = 1;
          }
          if(width && width != file_width) {
-             oi_warn(_("WARNING: Mismatched picture parameters in "
+             oi_warn(stream->report, "picture_mismatch", _("WARNING: Mismatched picture parameters in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "width declared as %u but appears to be %u\n"), i,
                    stream->num, (unsigned)width, (unsigned)file_width);
              broken = 1;
          }
          if(height && height != file_height) {
-             oi_warn(_("WARNING: Mismatched picture parameters in "
+             oi_warn(stream->report, "picture_mismatch", _("WARNING: Mismatched picture parameters in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "height declared as %u but appears to be %u\n"), i,
                    stream->num, (unsigned)height, (unsigned)file_height);
              broken = 1;
          }
          if(depth && depth != file_depth) {
-             oi_warn(_("WARNING: Mismatched picture parameters in "
+             oi_warn(stream->report, "picture_mismatch", _("WARNING: Mismatched picture parameters in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "depth declared as %u but appears to be %u\n"), i,
                    stream->num, (unsigned)depth, (unsigned)file_depth);
              broken = 1;
          }
          if(has_palette >= 0 && colors_set && colors != file_colors) {
-             oi_warn(_("WARNING: Mismatched picture parameters in "
+             oi_warn(stream->report, "picture_mismatch", _("WARNING: Mismatched picture parameters in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "palette size declared as %u but appears to be %u\n"), i,
                    stream->num, (unsigned)colors, (unsigned)file_colors);
@@ -564,7 +825,7 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
                && ((is_url && (width != 0 || height != 0)
                            && (width != 32 || height != 32))
                      || (!is_url && (file_width != 32 || file_height != 32)))) {
-             oi_warn(_("WARNING: Invalid picture in "
+             oi_warn(stream->report, "picture_bad_icon", _("WARNING: Invalid picture in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "picture of type 1 (32x32 icon) MUST be a 32x32 PNG, but "
                    "the image has dimensions %ux%u\n"), i, stream->num,
@@ -573,7 +834,7 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
              broken = 1;
          }
          if(picture_type == 1 && !is_url && format != PIC_FORMAT_PNG) {
-             oi_warn(_("WARNING: Invalid picture in "
+             oi_warn(stream->report, "picture_bad_icon", _("WARNING: Invalid picture in "
                    "METADATA_BLOCK_PICTURE comment %d (stream %d): "
                    "picture of type 1 (32x32 icon) MUST be a 32x32 PNG, but "
                    "the image does not appear to be a PNG\n"), i, stream->num);
@@ -582,26 +843,38 @@ void check_xiph_comment(stream_processor *stream, int i, const char *comment,
          /*Print the contents of the block using the same format as the
            SPECIFICATION argument to opusenc/flac/etc. (except without an image
            filename, since we don't know the original).*/
-         oi_info("\t%.*s%u|%.*s|%.*s|%ux%ux%u",
+         oi_info(stream->report, "\t%.*s%u|%.*s|%.*s|%ux%ux%u",
                (int)(sep+1-comment), comment, (unsigned)picture_type,
-               mime_type_length, data+8,
-               description_length, data+12+mime_type_length,
+               mime_type_length, mime_type,
+               description_length, description,
                (unsigned)width, (unsigned)height, (unsigned)depth);
          if(colors) {
-             oi_info("/%u", (unsigned)colors);
+             oi_info(stream->report, "/%u", (unsigned)colors);
          }
          if(is_url) {
-             oi_info("|%.*s\n", image_length, data+j);
+             /*Print the URL a piece at a time, up to any NUL.*/
+             oi_info(stream->report, "|");
+             while(image_length > 0) {
+                 n = (int)base64_read(&b64, j, buf, image_length < sizeof(buf) ?
+                       image_length : sizeof(buf));
+                 oi_info(stream->report, "%.*s", n, buf);
+                 if(memchr(buf, 0, n)) {
+                     break;
+                 }
+                 j += n;
+                 image_length -= n;
+             }
+             oi_info(stream->report, "\n");
          }
          else {
-             oi_info("|<%u bytes of image data>\n",(unsigned)image_length);
+             oi_info(stream->report, "|<%u bytes of image data>\n",(unsigned)image_length);
          }
-         free(data);
+         arena_release(stream->mem, &mark);
          return;
      }
 
      if(!broken) {
-         oi_info("\t%s\n", comment);
+         oi_info(stream->report, "\t%.*s\n", text_length, comment);
      }
 }
 
@@ -628,16 +901,19 @@ static void free_stream_set(stream_set *set)
 {
     int i;
     for(i=0; i < set->used; i++) {
-        if(!set->streams[i].end) {
-            oi_warn(_("WARNING: EOS not set on stream %d (normal for live streams)\n"),
-                    set->streams[i].num);
-            if(set->streams[i].process_end)
-                set->streams[i].process_end(&set->streams[i]);
+        stream_processor *stream = set->streams[i];
+        if(!stream->end) {
+            oi_warn(set->report, "no_eos", _("WARNING: EOS not set on stream %d (normal for live streams)\n"),
+                    stream->num);
+            if(stream->process_end)
+                stream->process_end(stream);
         }
-        ogg_stream_clear(&set->streams[i].os);
+        ogg_stream_clear(&stream->os);
     }
+    /* The processors themselves go with the arena. */
 
     free(set->streams);
+    free(set->index);
     free(set);
 }
 
@@ -646,7 +922,7 @@ static int streams_open(stream_set *set)
     int i;
     int res=0;
     for(i=0; i < set->used; i++) {
-        if(!set->streams[i].end)
+        if(!set->streams[i]->end)
             res++;
     }
 
@@ -673,30 +949,47 @@ static void other_start(stream_processor *stream, char *type)
 static stream_processor *find_stream_processor(stream_set *set, ogg_page *page)
 {
     ogg_uint32_t serial = ogg_page_serialno(page);
-    int i;
     int invalid = 0;
     int constraint = 0;
     stream_processor *stream;
-
-    for(i=0; i < set->used; i++) {
-        if(serial == set->streams[i].serial) {
-            /* We have a match! */
-            stream = &(set->streams[i]);
-
-            set->in_headers = 0;
-            /* if we have detected EOS, then this can't occur here. */
-            if(stream->end) {
-                stream->isillegal = 1;
-                stream->constraint_violated = CONSTRAINT_PAGE_AFTER_EOS;
-                return stream;
-            }
-
-            stream->isnew = 0;
-            stream->start = ogg_page_bos(page);
-            stream->end = ogg_page_eos(page);
+    stream_entry *entry;
+    oi_stream_summary *summary;
+
+    entry = index_lookup(set, serial);
+    if(entry->num) {
+        /* We have a match! */
+        stream = entry->stream;
+        if(!stream) {
+            /* A page of a retired stream: bring back enough of it to
+               report the pages found after its end. */
+            stream = add_stream(set);
+            if(!stream)
+                return NULL;
+            null_start(stream);
+            ogg_stream_init(&stream->os, serial);
+            stream->report = set->report;
+            stream->num = entry->num;
             stream->serial = serial;
+            stream->seqno = entry->seqno;
+            stream->lostseq = entry->lostseq;
+            stream->start = entry->start;
+            stream->end = 1;
+            entry->stream = stream;
+        }
+
+        set->in_headers = 0;
+        /* if we have detected EOS, then this can't occur here. */
+        if(stream->end) {
+            stream->isillegal = 1;
+            stream->constraint_violated = CONSTRAINT_PAGE_AFTER_EOS;
             return stream;
         }
+
+        stream->isnew = 0;
+        stream->start = ogg_page_bos(page);
+        stream->end = ogg_page_eos(page);
+        stream->serial = serial;
+        return stream;
     }
 
     /* If there are streams open, and we've reached the end of the
@@ -711,18 +1004,20 @@ static stream_processor *find_stream_processor(stream_set *set, ogg_page *page)
 
     set->in_headers = 1;
 
-    if(set->allocated < set->used)
-        stream = &set->streams[set->used];
-    else {
-        set->allocated += 5;
-        set->streams = realloc(set->streams, sizeof(stream_processor)*
-                set->allocated);
-        stream = &set->streams[set->used];
-    }
-    set->used++;
-    stream->num = set->used; /* We count from 1 */
+    if(index_reserve(set) != 0)
+        return NULL;
+    stream = add_stream(set);
+    if(!stream)
+        return NULL;
+    set->count++;
+    stream->num = set->count; /* We count from 1 */
+    entry = index_lookup(set, serial);
+    entry->serial = serial;
+    entry->num = stream->num;
+    entry->stream = stream;
 
     stream->isnew = 1;
+    stream->report = set->report;
     stream->isillegal = invalid;
     stream->constraint_violated = constraint;
     stream->seen_file_icons = 0;
@@ -737,7 +1032,7 @@ static stream_processor *find_stream_processor(stream_set *set, ogg_page *page)
         ogg_stream_pagein(&stream->os, page);
         res = ogg_stream_packetout(&stream->os, &packet);
         if(res <= 0) {
-            oi_warn(_("WARNING: Invalid header page, no packet found\n"));
+            oi_warn(set->report, "empty_header_page", _("WARNING: Invalid header page, no packet found\n"));
             null_start(stream);
         }
         else if(packet.bytes >= 19 && memcmp(packet.packet, "OpusHead", 8)==0)
@@ -770,10 +1065,10 @@ static stream_processor *find_stream_processor(stream_set *set, ogg_page *page)
 
         res = ogg_stream_packetout(&stream->os, &packet);
         if(res > 0) {
-            oi_warn(_("WARNING: Invalid header page in stream %d, "
+            oi_warn(set->report, "multiple_header_packets", _("WARNING: Invalid header page in stream %d, "
                               "contains multiple packets\n"), stream->num);
         }
-        if(has_oi_supported)oi_info(_("Use ogginfo for more information on this file.\n"));
+        if(has_oi_supported)oi_info(set->report, _("Use ogginfo for more information on this file.\n"));
 
         /* re-init, ready for processing */
         ogg_stream_clear(&stream->os);
@@ -784,10 +1079,15 @@ static stream_processor *find_stream_processor(stream_set *set, ogg_page *page)
    stream->end = ogg_page_eos(page);
    stream->serial = serial;
    stream->shownillegal = 0;
+   summary = oi_stream(set->report, stream->num);
+   if(summary) {
+       summary->serial = serial;
+       summary->type = stream->type;
+   }
    stream->seqno = ogg_page_pageno(page);
 
    if(stream->serial == 0 || stream->serial == 0xFFFFFFFFUL) {
-       oi_info(_("Note: Stream %d has serial number %d, which is legal but may "
+       oi_info(set->report, _("Note: Stream %d has serial number %d, which is legal but may "
               "cause problems with some tools.\n"), stream->num,
                stream->serial);
    }
@@ -795,59 +1095,330 @@ static stream_processor *find_stream_processor(stream_set *set, ogg_page *page)
    return stream;
 }
 
-static int get_next_page(FILE *f, ogg_sync_state *ogsync, ogg_page *page,
-        ogg_int64_t *written)
+/* *consumed counts the bytes of the pages and holes found so far, so that
+   the page returned ends there. */
+static int get_next_page(oi_report *report, file_reader *f,
+        ogg_sync_state *ogsync, ogg_page *page, ogg_int64_t *written,
+        ogg_int64_t *consumed)
 {
     int ret;
     char *buffer;
-    size_t bytes;
+    long bytes;
 
     while((ret = ogg_sync_pageseek(ogsync, page)) <= 0) {
         if(ret < 0) {
             /* unsynced, we jump over bytes to a possible capture - we don't need to read more just yet */
-            oi_warn(_("WARNING: Hole in data (%d bytes) found at approximate offset %" PRId64 " bytes. Corrupted Ogg.\n"), -ret, *written);
+            oi_warn(report, "hole", _("WARNING: Hole in data (%d bytes) found at approximate offset %" PRId64 " bytes. Corrupted Ogg.\n"), -ret, *written);
+            *consumed += -ret;
             continue;
         }
 
         /* zero return, we didn't have enough data to find a whole page, read */
         buffer = ogg_sync_buffer(ogsync, CHUNK);
-        bytes = fread(buffer, 1, CHUNK, f);
-        if(bytes == 0) {
+        bytes = file_reader_read(f, buffer, CHUNK);
+        if(bytes <= 0) {
             ogg_sync_wrote(ogsync, 0);
             return 0;
         }
-        ogg_sync_wrote(ogsync, (long)bytes);
+        ogg_sync_wrote(ogsync, bytes);
         *written += bytes;
     }
+    *consumed += ret;
 
     return 1;
 }
 
-static void process_file(char *filename)
+#define IS_OPUS(stream) (strcmp((stream)->type, "opus") == 0)
+
+/* Returns 1 once every Opus stream of the first link has its headers and
+   its start time, so that --quick can skip to the end of the file. */
+static int quick_ready(stream_set *set)
+{
+    int i;
+    int opus = 0;
+    if(set->in_headers)
+        return 0;
+    for(i=0; i < set->used; i++) {
+        stream_processor *stream = set->streams[i];
+        if(stream->end || stream->isillegal || !IS_OPUS(stream))
+            continue;
+        if(!info_opus_timed(stream))
+            return 0;
+        opus = 1;
+    }
+    return opus;
+}
+
+typedef struct {
+    ogg_int64_t granulepos;
+    int eos;
+    int found;
+} last_page;
+
+/* Captures pages in the part of the file from begin, reading up to a
+   whole page past stop, and keeps the last one with a granule position of
+   each stream in set that starts before stop. Returns the serial number of
+   the last page starting before stop in *last_serial, or leaves it alone
+   if there is none. */
+static void capture_pages(file_reader *f, OFF_T begin, OFF_T stop, OFF_T end,
+        stream_set *set, last_page *window, ogg_uint32_t *last_serial,
+        int *have_last)
+{
+    ogg_sync_state oy;
+    ogg_page page;
+    OFF_T offset;
+    long want;
+    long got;
+    char *buffer;
+    int i;
+
+    want = (long)((stop + MAX_PAGE_SIZE < end ? stop + MAX_PAGE_SIZE : end)
+            - begin);
+    if(file_reader_seek(f, begin, SEEK_SET) < 0)
+        return;
+    ogg_sync_init(&oy);
+    buffer = ogg_sync_buffer(&oy, want);
+    got = file_reader_read(f, buffer, want);
+    ogg_sync_wrote(&oy, got > 0 ? got : 0);
+    offset = begin;
+    while(offset < stop) {
+        long ret = ogg_sync_pageseek(&oy, &page);
+        if(ret == 0)
+            break;
+        if(ret < 0) {
+            offset += -ret;
+            continue;
+        }
+        for(i=0; i < set->used; i++) {
+            if(set->streams[i]->serial == (ogg_uint32_t)ogg_page_serialno(&page)
+                    && ogg_page_granulepos(&page) != -1) {
+                window[i].granulepos = ogg_page_granulepos(&page);
+                window[i].eos = ogg_page_eos(&page);
+                window[i].found = 1;
+            }
+        }
+        *last_serial = ogg_page_serialno(&page);
+        *have_last = 1;
+        offset += ret;
+    }
+    ogg_sync_clear(&oy);
+}
+
+#define QUICK_DONE (1)
+#define QUICK_UNSEEKABLE (0)
+#define QUICK_CHAINED (-1)
+#define QUICK_NO_END (-2)
+
+/* The --quick end of a file: looks backwards from the end for the last
+   page of each stream, the way libopusfile finds the end of a link, and
+   prints the reports from what it finds. start is the offset of the first
+   page that has not been processed yet; pages before it may still be in
+   the caller's ogg_sync buffer, ahead of the reader position. Returns
+   QUICK_DONE, or without printing anything QUICK_UNSEEKABLE, QUICK_CHAINED
+   or QUICK_NO_END if the end of a stream could not be found, in which
+   cases the file has to be read in full. */
+static int quick_finish(file_reader *f, stream_set *set, OFF_T start)
+{
+    last_page *pages;
+    last_page *window;
+    ogg_uint32_t last_serial = 0;
+    int have_last = 0;
+    int chained = 0;
+    OFF_T pos;
+    OFF_T end;
+    OFF_T stop;
+    OFF_T chunk;
+    int found;
+    int i;
+
+    pos = (OFF_T)file_reader_tell(f);
+    if(pos < 0 || file_reader_seek(f, 0, SEEK_END) < 0)
+        return QUICK_UNSEEKABLE;
+    end = (OFF_T)file_reader_tell(f);
+    pages = calloc(set->used, sizeof(*pages));
+    window = calloc(set->used, sizeof(*window));
+    found = 0;
+    stop = end;
+    chunk = QUICK_CHUNK;
+    while(found < set->used && stop > start) {
+        OFF_T begin = stop - chunk > start ? stop - chunk : start;
+        int had_last = have_last;
+        memset(window, 0, set->used*sizeof(*window));
+        capture_pages(f, begin, stop, end, set, window, &last_serial,
+                &have_last);
+        if(have_last && !had_last) {
+            /* The last page of the file must belong to the first link,
+               or the file is chained. */
+            for(i=0; i < set->used; i++) {
+                if(set->streams[i]->serial == last_serial)
+                    break;
+            }
+            if(i == set->used) {
+                chained = 1;
+                break;
+            }
+        }
+        for(i=0; i < set->used; i++) {
+            if(!pages[i].found && window[i].found) {
+                pages[i] = window[i];
+                found++;
+            }
+        }
+        stop = begin;
+        if(chunk < QUICK_CHUNK_MAX)
+            chunk *= 2;
+    }
+    free(window);
+    /* Streams that ended before start are already done. */
+    for(i=0; i < set->used; i++) {
+        if(!set->streams[i]->end && !pages[i].found
+                && IS_OPUS(set->streams[i]))
+            break;
+    }
+    if(chained || i < set->used) {
+        free(pages);
+        file_reader_seek(f, pos, SEEK_SET);
+        return chained ? QUICK_CHAINED : QUICK_NO_END;
+    }
+    for(i=0; i < set->used; i++) {
+        stream_processor *stream = set->streams[i];
+        if(stream->end)
+            continue;
+        if(pages[i].found && !pages[i].eos)
+            oi_warn(set->report, "no_eos", _("WARNING: EOS not set on stream %d (normal for live streams)\n"),
+                    stream->num);
+        if(IS_OPUS(stream))
+            info_opus_quick_end(stream, pages[i].granulepos,
+                    set->count == 1 ? (ogg_int64_t)end : -1);
+        if(pages[i].found && pages[i].eos)
+            oi_info(set->report, _("Logical stream %d ended\n"), stream->num);
+        stream->end = 1;
+    }
+    free(pages);
+    return QUICK_DONE;
+}
+
+/* get_next_page() for --threads, where the pages are found by the threads
+   of a page_scan. */
+static int get_next_scanned_page(oi_report *report, page_scan *scan,
+        ogg_page *page, ogg_int64_t *consumed)
 {
-    FILE *file = fopen_utf8(filename, "rb");
+    ogg_int64_t offset;
+    ogg_int64_t hole;
+    int ret;
+
+    ret = page_scan_next(scan, page, &offset, &hole);
+    if(hole > 0)
+        oi_warn(report, "hole", _("WARNING: Hole in data (%" PRId64 " bytes) found at offset %" PRId64 " bytes. Corrupted Ogg.\n"), hole, offset - hole);
+    *consumed = offset + page->header_len + page->body_len;
+    return ret;
+}
+
+/* Adds the page to the --write-index index if it is the first one after
+   an interval of its stream. */
+static void index_page(opus_index *index, stream_processor *stream,
+        ogg_page *page, ogg_int64_t offset)
+{
+    ogg_int64_t granulepos = ogg_page_granulepos(page);
+    opus_index_link *link;
+
+    if(stream->isnew)
+        stream->index_link = IS_OPUS(stream) ?
+                opus_index_add_link(index, stream->serial, offset) : -1;
+    if(stream->index_link < 0)
+        return;
+    link = &index->links[stream->index_link];
+    if(link->start_granule < 0 && info_opus_timed(stream))
+        link->start_granule = info_opus_start_granule(stream);
+    /* As in opusfile, a page is a seek point only if a packet starts on it
+       and the page before it ends at a known granule position: the first
+       packet of a continued page starts later than that position. */
+    if(stream->index_granulepos > 0 && !ogg_page_continued(page)
+            && stream->index_granulepos >= stream->index_next
+            && opus_index_add_entry(index, stream->index_link,
+            stream->index_granulepos, offset) == 0)
+        stream->index_next = stream->index_granulepos
+                + (ogg_int64_t)index->interval_ms*48;
+    stream->index_granulepos = granulepos;
+    if(granulepos > 0)
+        link->last_granule = granulepos;
+}
+
+static void write_index(oi_report *report, opus_index *index)
+{
+    FILE *file = fopen_utf8(index_path, "wb");
+
+    if(!file || opus_index_write(index, file) != 0) {
+        oi_error(report, "index_write_failed", _("ERROR: Cannot write index file \"%s\": %s\n"),
+                index_path, strerror(errno));
+    }
+    if(file)
+        fclose(file);
+}
+
+/* ring is the io_uring of the calling thread, or NULL. */
+/* Everything the file needs while it is read is allocated from mem, which
+   is reset once it is done. */
+static void process_file(char *filename, oi_report *report, file_ring *ring,
+        arena *mem)
+{
+    file_reader *file = mem ? file_reader_open(filename, ring) : NULL;
     ogg_sync_state ogsync;
     ogg_page page;
-    stream_set *processors = create_stream_set();
+    stream_set *processors;
     int gotpage = 0;
+    int tried_quick = 0;
     ogg_int64_t written = 0;
-
-    if(!file) {
-        oi_error(_("Error opening input file \"%s\": %s\n"), filename,
+    ogg_int64_t consumed = 0;
+    page_scan *scan = NULL;
+    opus_index *index = NULL;
+
+    if(!mem)
+        errno = ENOMEM;
+    if(file && threads > 1 && !quick)
+        scan = page_scan_open(filename, threads);
+    if(!file || (threads > 1 && !quick && !scan)) {
+        report->open_failed = 1;
+        oi_error(report, "open_failed", _("Error opening input file \"%s\": %s\n"), filename,
                     strerror(errno));
+        file_reader_close(file);
         return;
     }
 
-    printf(_("Processing file \"%s\"...\n\n"), filename);
+    report_print(report, _("Processing file \"%s\"...\n\n"), filename);
+
+    processors = create_stream_set(report, mem);
+    if(index_path)
+        index = opus_index_create(index_interval_ms);
 
     ogg_sync_init(&ogsync);
 
-    while(get_next_page(file, &ogsync, &page, &written)) {
-        stream_processor *p = find_stream_processor(processors, &page);
+    while(scan ? get_next_scanned_page(report, scan, &page, &consumed)
+            : get_next_page(report, file, &ogsync, &page, &written,
+            &consumed)) {
+        stream_processor *p;
+        if(quick && !tried_quick && quick_ready(processors)) {
+            int ret;
+            tried_quick = 1;
+            /* The search starts at this page, which is not processed yet. */
+            ret = quick_finish(file, processors, (OFF_T)(consumed
+                    - page.header_len - page.body_len));
+            if(ret == QUICK_DONE)
+                break;
+            if(ret == QUICK_CHAINED)
+                oi_info(report, _("Note: File is chained, reading all of it.\n"));
+            else if(ret == QUICK_UNSEEKABLE)
+                oi_info(report, _("Note: File cannot be seeked, reading all of it.\n"));
+            else
+                oi_info(report, _("Note: The end of a stream was not found, "
+                        "reading all of the file.\n"));
+        }
+        p = find_stream_processor(processors, &page);
         gotpage = 1;
 
         if(!p) {
-            oi_error(_("Could not find a processor for stream, bailing\n"));
+            oi_error(report, "no_processor", _("Could not find a processor for stream, bailing\n"));
+            arena_reset(mem);
             return;
         }
 
@@ -865,7 +1436,7 @@ static void process_file(char *filename)
                     constraint = _("Error unknown.");
             }
 
-            oi_warn(_("WARNING: illegally placed page(s) for logical stream %d\n"
+            oi_warn(report, "illegal_page", _("WARNING: illegally placed page(s) for logical stream %d\n"
                    "This indicates a corrupt Ogg file: %s.\n"),
                     p->num, constraint);
             p->shownillegal = 1;
@@ -877,19 +1448,19 @@ static void process_file(char *filename)
         }
 
         if(p->isnew) {
-            oi_info(_("New logical stream (#%d, serial: %08x): type %s\n"),
+            oi_info(report, _("New logical stream (#%d, serial: %08x): type %s\n"),
                     p->num, p->serial, p->type);
             if(!p->start)
-                oi_warn(_("WARNING: stream start flag not set on stream %d\n"),
+                oi_warn(report, "no_bos", _("WARNING: stream start flag not set on stream %d\n"),
                         p->num);
         }
         else if(p->start)
-            oi_warn(_("WARNING: stream start flag found in mid-stream "
+            oi_warn(report, "bos_mid_stream", _("WARNING: stream start flag found in mid-stream "
                       "on stream %d\n"), p->num);
 
         if(p->seqno++ != ogg_page_pageno(&page)) {
             if(!p->lostseq)
-                oi_warn(_("WARNING: sequence number gap in stream %d. Got page "
+                oi_warn(report, "seqno_gap", _("WARNING: sequence number gap in stream %d. Got page "
                        "%ld when expecting page %ld. Indicates missing data.%s\n"
                        ), p->num, ogg_page_pageno(&page), p->seqno - 1, p->seqno-1==2?_(" (normal for live streams)"):"");
             p->seqno = ogg_page_pageno(&page);
@@ -900,26 +1471,318 @@ static void process_file(char *filename)
 
         if(!p->isillegal) {
             p->process_page(p, &page);
+            if(index)
+                index_page(index, p, &page,
+                        consumed - page.header_len - page.body_len);
 
             if(p->end) {
                 if(p->process_end)
                     p->process_end(p);
-                oi_info(_("Logical stream %d ended\n"), p->num);
-                p->isillegal = 1;
-                p->constraint_violated = CONSTRAINT_PAGE_AFTER_EOS;
+                oi_info(report, _("Logical stream %d ended\n"), p->num);
+                retire_stream(processors, p);
             }
         }
     }
 
     if(!gotpage)
-        oi_error(_("ERROR: No Ogg data found in file \"%s\".\n"
+        oi_error(report, "not_ogg", _("ERROR: No Ogg data found in file \"%s\".\n"
                 "Input probably not Ogg.\n"), filename);
 
     free_stream_set(processors);
 
+    if(index) {
+        write_index(report, index);
+        opus_index_free(index);
+    }
+
     ogg_sync_clear(&ogsync);
 
-    fclose(file);
+    page_scan_close(scan);
+    file_reader_close(file);
+    arena_reset(mem);
+}
+
+typedef struct {
+    int files;
+    int flawed;
+    int unreadable;
+    double duration;
+    oi_code_list warnings;
+    oi_code_list errors;
+} oi_totals;
+
+static void json_string(const char *str)
+{
+    const unsigned char *c;
+
+    putchar('"');
+    for(c = (const unsigned char *)str; *c; c++) {
+        if(*c == '"' || *c == '\\')
+            printf("\\%c", *c);
+        else if(*c < 0x20)
+            printf("\\u%04x", *c);
+        else
+            putchar(*c);
+    }
+    putchar('"');
+}
+
+static void json_number(double value, const char *format)
+{
+    if(value < 0)
+        printf("null");
+    else
+        printf(format, value);
+}
+
+static void json_codes(const oi_code_list *list)
+{
+    int i;
+
+    putchar('{');
+    for(i=0; i < list->used; i++) {
+        if(i)
+            putchar(',');
+        json_string(list->codes[i].code);
+        printf(":%d", list->codes[i].count);
+    }
+    putchar('}');
+}
+
+/* Returns the playback length of the Opus streams of a file. */
+static double report_duration(const oi_report *report)
+{
+    double duration = 0;
+    int i;
+
+    for(i=0; i < report->nstreams; i++)
+        if(report->streams[i].duration > 0)
+            duration += report->streams[i].duration;
+    return duration;
+}
+
+static void report_json(const char *filename, const oi_report *report)
+{
+    int i;
+
+    printf("{\"file\":");
+    json_string(filename);
+    printf(",\"ok\":%s,\"duration\":%.3f,\"streams\":[",
+            report->flawed ? "false" : "true", report_duration(report));
+    for(i=0; i < report->nstreams; i++) {
+        const oi_stream_summary *stream = &report->streams[i];
+        if(i)
+            putchar(',');
+        printf("{\"stream\":%d,\"serial\":%lu,\"type\":", stream->num,
+                (unsigned long)stream->serial);
+        json_string(stream->type);
+        printf(",\"channels\":");
+        json_number(stream->channels, "%.0f");
+        printf(",\"preskip\":");
+        json_number(stream->preskip, "%.0f");
+        printf(",\"input_sample_rate\":");
+        json_number(stream->input_sample_rate, "%.0f");
+        printf(",\"duration\":");
+        json_number(stream->duration, "%.3f");
+        printf(",\"bitrate\":");
+        json_number(stream->bitrate, "%.3f");
+        if(stream->stats)
+            printf(",\"stats\":%s", stream->stats);
+        putchar('}');
+    }
+    printf("],\"warnings\":");
+    json_codes(&report->warnings);
+    printf(",\"errors\":");
+    json_codes(&report->errors);
+    printf("}\n");
+}
+
+/* Prints what is left of the report on a file and adds it to the totals. */
+static void report_finish(const char *filename, oi_report *report,
+        oi_totals *totals)
+{
+    int i;
+
+    if(report->json)
+        report_json(filename, report);
+    else if(report->text_len)
+        fwrite(report->text, 1, report->text_len, stdout);
+    fflush(stdout);
+    totals->files++;
+    if(report->flawed)
+        totals->flawed++;
+    if(report->open_failed)
+        totals->unreadable++;
+    totals->duration += report_duration(report);
+    for(i=0; i < report->warnings.used; i++)
+        code_add(&totals->warnings, report->warnings.codes[i].code,
+                report->warnings.codes[i].count);
+    for(i=0; i < report->errors.used; i++)
+        code_add(&totals->errors, report->errors.codes[i].code,
+                report->errors.codes[i].count);
+}
+
+static void totals_json(const oi_totals *totals)
+{
+    printf("{\"summary\":{\"files\":%d,\"ok\":%d,\"flawed\":%d,"
+            "\"unreadable\":%d,\"duration\":%.3f,\"warnings\":",
+            totals->files, totals->files - totals->flawed, totals->flawed,
+            totals->unreadable, totals->duration);
+    json_codes(&totals->warnings);
+    printf(",\"errors\":");
+    json_codes(&totals->errors);
+    printf("}}\n");
+}
+
+#ifdef HAVE_PTHREAD
+/* Files are processed by a pool of threads, and reported in the order of
+   the arguments. Only a few reports per thread are kept waiting, so that
+   memory does not grow with the number of files. */
+#define REPORTS_PER_JOB (4)
+
+typedef struct {
+    char **paths;
+    int npaths;
+    int verbose;
+    int json;
+    oi_report *slots;
+    int nslots;
+    int next;
+    int printed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} file_queue;
+
+static void *file_worker(void *arg)
+{
+    file_queue *queue = (file_queue *)arg;
+    /* One ring keeps the reads of this thread's files in flight, and one
+       arena holds the state of the file it is on. */
+    file_ring *ring = file_ring_create();
+    arena *mem = arena_create();
+
+    for(;;) {
+        oi_report report;
+        int i;
+
+        pthread_mutex_lock(&queue->lock);
+        while(queue->next < queue->npaths
+                && queue->next - queue->printed >= queue->nslots)
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        i = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if(i >= queue->npaths)
+            break;
+        report_init(&report, queue->verbose, queue->json, 1);
+        process_file(queue->paths[i], &report, ring, mem);
+        report.finished = 1;
+        pthread_mutex_lock(&queue->lock);
+        queue->slots[i % queue->nslots] = report;
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+    file_ring_destroy(ring);
+    arena_destroy(mem);
+    return NULL;
+}
+
+/* Returns 0, or -1 if no thread could be started. */
+static int process_parallel(char **paths, int npaths, int jobs, int verbose,
+        int json, oi_totals *totals)
+{
+    file_queue queue;
+    pthread_t *workers;
+    int nworkers;
+    int i;
+
+    queue.paths = paths;
+    queue.npaths = npaths;
+    queue.verbose = verbose;
+    queue.json = json;
+    queue.nslots = REPORTS_PER_JOB*jobs;
+    queue.next = 0;
+    queue.printed = 0;
+    queue.slots = calloc(queue.nslots, sizeof(*queue.slots));
+    workers = malloc(sizeof(*workers)*jobs);
+    if(!queue.slots || !workers) {
+        free(queue.slots);
+        free(workers);
+        return -1;
+    }
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.changed, NULL);
+    for(nworkers = 0; nworkers < jobs; nworkers++) {
+        if(pthread_create(&workers[nworkers], NULL, file_worker, &queue) != 0)
+            break;
+    }
+    if(nworkers > 0) {
+        for(i=0; i < npaths; i++) {
+            oi_report report;
+            oi_report *slot = &queue.slots[i % queue.nslots];
+            pthread_mutex_lock(&queue.lock);
+            while(!slot->finished)
+                pthread_cond_wait(&queue.changed, &queue.lock);
+            report = *slot;
+            slot->finished = 0;
+            queue.printed = i + 1;
+            pthread_cond_broadcast(&queue.changed);
+            pthread_mutex_unlock(&queue.lock);
+            report_finish(paths[i], &report, totals);
+            report_clear(&report);
+        }
+        for(i=0; i < nworkers; i++)
+            pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+    pthread_cond_destroy(&queue.changed);
+    free(queue.slots);
+    free(workers);
+    return nworkers > 0 ? 0 : -1;
+}
+#endif
+
+/* Returns 1 if any file was flawed, 0 otherwise. */
+static int process_files(char **paths, int npaths, int jobs, int verbose,
+        int json)
+{
+    oi_totals totals;
+    file_ring *ring;
+    arena *mem;
+    int done = 0;
+    int i;
+
+    memset(&totals, 0, sizeof(totals));
+    if(jobs > npaths)
+        jobs = npaths;
+#ifdef HAVE_PTHREAD
+    if(jobs > 1) {
+        done = process_parallel(paths, npaths, jobs, verbose, json,
+                &totals) == 0;
+        if(!done)
+            fprintf(stderr, _("Warning: Cannot start threads; "
+                    "processing files in turn.\n"));
+    }
+#else
+    if(jobs > 1)
+        fprintf(stderr, _("Warning: Built without thread support; "
+                "processing files in turn.\n"));
+#endif
+    ring = done ? NULL : file_ring_create();
+    mem = done ? NULL : arena_create();
+    for(i=0; !done && i < npaths; i++) {
+        oi_report report;
+        report_init(&report, verbose, json, 0);
+        process_file(paths[i], &report, ring, mem);
+        report_finish(paths[i], &report, &totals);
+        report_clear(&report);
+    }
+    file_ring_destroy(ring);
+    arena_destroy(mem);
+    if(json)
+        totals_json(&totals);
+    free(totals.warnings.codes);
+    free(totals.errors.codes);
+    return totals.flawed > 0;
 }
 
 static void version(void)
@@ -943,11 +1806,38 @@ static void usage(void)
              "\t-v Make more verbose. This may enable more detailed checks\n"
              "\t   for some stream types.\n"));
     printf(_("\t-V Output version information and exit.\n"));
+    printf(_("\t--quick Only read the headers and the end of each file to\n"
+             "\t   find its duration and bitrate, without checking the rest.\n"
+             "\t--threads N Find the pages of each file with N threads,\n"
+             "\t   for large files on fast storage.\n"
+             "\t--jobs N Process N files at once. The reports are still\n"
+             "\t   printed in the order of the files.\n"
+             "\t--json Print one JSON object per file, then a summary of\n"
+             "\t   all of them, instead of the usual report.\n"
+             "\t--stats Print the mode, bandwidth and frame size of the\n"
+             "\t   packets, and the spread of packet sizes and bitrates.\n"
+             "\t--write-index FILE Write a seek index of the file to FILE.\n"
+             "\t--index-interval SECONDS Seconds of audio between the\n"
+             "\t   entries of the index (default: 1).\n"));
 }
 
+static const struct option long_options[] = {
+    {"quick", no_argument, NULL, 'Q'},
+    {"threads", required_argument, NULL, 'T'},
+    {"jobs", required_argument, NULL, 'J'},
+    {"json", no_argument, NULL, 'j'},
+    {"stats", no_argument, NULL, 'S'},
+    {"write-index", required_argument, NULL, 'I'},
+    {"index-interval", required_argument, NULL, 'D'},
+    {0, 0, 0, 0}
+};
+
 int main(int argc, char **argv)
 {
-    int f, ret;
+    int ret;
+    int verbose = 1;
+    int jobs = 1;
+    int json = 0;
 
 #ifdef WIN_UNICODE
     int argc_utf8;
@@ -973,8 +1863,45 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    while((ret = getopt(argc_utf8, argv_utf8, "hqvV")) >= 0) {
+    while((ret = getopt_long(argc_utf8, argv_utf8, "hqvV", long_options,
+            NULL)) >= 0) {
         switch(ret) {
+            case 'Q':
+                quick = 1;
+                break;
+            case 'T':
+                threads = atoi(optarg);
+                if(threads < 1) {
+                    fprintf(stderr, _("Invalid number of threads: %s\n"),
+                            optarg);
+                    return 1;
+                }
+                break;
+            case 'J':
+                jobs = atoi(optarg);
+                if(jobs < 1) {
+                    fprintf(stderr, _("Invalid number of jobs: %s\n"),
+                            optarg);
+                    return 1;
+                }
+                break;
+            case 'j':
+                json = 1;
+                break;
+            case 'S':
+                stats = 1;
+                break;
+            case 'I':
+                index_path = optarg;
+                break;
+            case 'D':
+                index_interval_ms = (int)(atof(optarg)*1000 + .5);
+                if(index_interval_ms < 1 || atof(optarg) > 86400) {
+                    fprintf(stderr, _("Invalid index interval: %s\n"),
+                            optarg);
+                    return 1;
+                }
+                break;
             case 'h':
                 usage();
                 return 0;
@@ -990,28 +1917,24 @@ int main(int argc, char **argv)
         }
     }
 
-    if(verbose > 1)
-        printlots = 1;
-    if(verbose < 1)
-        printinfo = 0;
-    if(verbose < 0)
-        printwarn = 0;
-
     if(optind >= argc_utf8) {
         fprintf(stderr,
                 _("No input files specified. \"opusinfo -h\" for help\n"));
         return 1;
     }
 
-    ret = 0;
-
-    for(f=optind; f < argc_utf8; f++) {
-        flawed = 0;
-        process_file(argv_utf8[f]);
-        if(flawed != 0)
-            ret = flawed;
+    if(index_path && (quick || argc_utf8 - optind > 1)) {
+        fprintf(stderr, _("--write-index needs a single input file, "
+                "and cannot be used with --quick\n"));
+        return 1;
     }
 
+    /* Select the kernels before any --jobs or --threads threads start. */
+    text_kernels();
+
+    ret = process_files(&argv_utf8[optind], argc_utf8 - optind, jobs,
+            verbose, json);
+
 #ifdef WIN_UNICODE
     free_commandline_arguments_utf8(&argc_utf8, &argv_utf8);
     uninit_console_utf8();
@@ -20,6 +20,24 @@
 # endif
 #endif
 
+/* Everything found in one file: its text, or what --json prints. */
+typedef struct oi_report oi_report;
+
+/* What --json gives for each stream. Values that are not known are
+   negative. */
+typedef struct {
+    int num;
+    ogg_uint32_t serial;
+    const char *type;
+    int channels;
+    int preskip;
+    ogg_int32_t input_sample_rate;
+    double duration;
+    double bitrate;
+    /* The --stats JSON object, or NULL. */
+    char *stats;
+} oi_stream_summary;
+
 typedef struct _stream_processor {
     void (*process_page)(struct _stream_processor *, ogg_page *);
     void (*process_end)(struct _stream_processor *);
@@ -40,23 +58,53 @@ typedef struct _stream_processor {
     ogg_uint32_t serial; /* must be 32 bit unsigned */
     ogg_stream_state os;
     void *data;
+    oi_report *report;
+    /* Where the state of the stream is allocated. */
+    arena *mem;
+
+    /* For --write-index: its link in the index, or -1, the granule
+       position of its last page, and that of the next entry. */
+    int index_link;
+    ogg_int64_t index_granulepos;
+    ogg_int64_t index_next;
 } stream_processor;
 
+typedef struct _stream_entry stream_entry;
+
 typedef struct {
-    stream_processor *streams;
+    /* The streams that have not ended, in the order they were found.
+       Ended streams are retired and only kept in the index. */
+    stream_processor **streams;
     int allocated;
     int used;
+    /* Every stream found so far, by serial number. */
+    stream_entry *index;
+    int index_size;
+    int count;
 
     int in_headers;
+    oi_report *report;
+    /* The processors are allocated here, and freed with it once the file
+       is done. */
+    arena *mem;
 } stream_set;
 
 #if __GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 3)
-# define OI_FORMAT_PRINTF __attribute__((__format__(printf, 1, 2)))
+# define OI_FORMAT_PRINTF(f, a) __attribute__((__format__(printf, f, a)))
 #else
-# define OI_FORMAT_PRINTF
+# define OI_FORMAT_PRINTF(f, a)
 #endif
 
-void oi_info(char *format, ...) OI_FORMAT_PRINTF;
-void oi_warn(char *format, ...) OI_FORMAT_PRINTF;
-void oi_error(char *format, ...) OI_FORMAT_PRINTF;
+/* Warnings and errors carry a short code, which --json reports instead of
+   the message. */
+void oi_info(oi_report *report, char *format, ...) OI_FORMAT_PRINTF(2, 3);
+void oi_warn(oi_report *report, const char *code, char *format, ...)
+    OI_FORMAT_PRINTF(3, 4);
+void oi_error(oi_report *report, const char *code, char *format, ...)
+    OI_FORMAT_PRINTF(3, 4);
+/* Returns the summary of stream num, counted from 1, or NULL if it cannot
+   be allocated. */
+oi_stream_summary *oi_stream(oi_report *report, int num);
+/* Returns 1 if packet statistics were asked for with --stats. */
+int oi_want_stats(oi_report *report);
 void check_xiph_comment(stream_processor *stream, int i, const char *comment, int comment_length);
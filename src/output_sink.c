@@ -0,0 +1,616 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: output_sink.c
+   Additional opusdec outputs at their own rate, channel count and format
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <opus.h>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#if defined WIN32 || defined _WIN32
+# include "unicode_support.h"
+# include <io.h>
+# include <fcntl.h>
+#else
+# define fopen_utf8(_x,_y) fopen((_x),(_y))
+#endif
+
+#include "output_sink.h"
+
+/*We're using this define to test for libopus 1.1 or later until libopus
+  provides a better mechanism.*/
+#if defined(OPUS_GET_EXPERT_FRAME_DURATION_REQUEST)
+/*Enable soft clipping prevention.*/
+# define HAVE_SOFT_CLIP (1)
+#endif
+
+/* How the decoded channels are turned into the sink's channels. */
+#define SINK_COPY    (0)
+#define SINK_PERMUTE (1)
+#define SINK_MONO    (2)
+#define SINK_DUP     (3)
+
+/* Output chunk of the resampler, as in opusdec's audio_write(). */
+#define SINK_CHUNK (1024)
+
+int output_sink_parse(output_sink *sink, const char *spec)
+{
+   const char *field[3];
+   const char *p;
+   char *end;
+   long val;
+   size_t len;
+   int i;
+   memset(sink, 0, sizeof(*sink));
+   /*The path comes last and may contain ':' itself.*/
+   p = spec;
+   for (i = 0; i < 3; i++)
+   {
+      field[i] = p;
+      p = strchr(p, ':');
+      if (!p) return -1;
+      p++;
+   }
+   sink->path = p;
+   if (!*sink->path) return -1;
+   sink->rate = 48000;
+   if (field[0][0] != ':')
+   {
+      val = strtol(field[0], &end, 10);
+      if (end == field[0] || *end != ':' || val < 8000 || val > 192000)
+         return -1;
+      sink->rate = (int)val;
+   }
+   if (field[1][0] != ':')
+   {
+      val = strtol(field[1], &end, 10);
+      if (end == field[1] || *end != ':' || val < 0 || val > SINK_MAX_CHANNELS)
+         return -1;
+      sink->channels = (int)val;
+   }
+   if (strncmp(field[2], "float:", 6) == 0) sink->fp = 1;
+   else if (field[2][0] != ':' && strncmp(field[2], "s16:", 4) != 0)
+      return -1;
+   len = strlen(sink->path);
+   sink->wav_format = len >= 4;
+   for (i = 0; sink->wav_format && i < 4; ++i) {
+      sink->wav_format = tolower((unsigned char)sink->path[len-4+i]) == ".wav"[i];
+   }
+   return 0;
+}
+
+int output_sink_open(output_sink *sink, int in_channels, int mapping_family,
+   int max_frame, int quality, int dither, opus_int64 expected_samples)
+{
+   opus_int64 expected_size=-1;
+   int channels;
+   int ci;
+   if (!sink->channels) sink->channels = in_channels;
+   channels = sink->channels;
+   sink->in_channels = in_channels;
+   if (channels == in_channels)
+   {
+      sink->mix = SINK_COPY;
+      if (sink->wav_format && (channels==3 || channels>4))
+      {
+         for (ci=0;ci<channels;ci++) sink->map[ci]=ci;
+         adjust_wav_mapping(mapping_family, channels, sink->map);
+         sink->mix = SINK_PERMUTE;
+      }
+   }
+   else if (channels == 1) sink->mix = SINK_MONO;
+   else if (channels == 2 && in_channels == 1) sink->mix = SINK_DUP;
+   else
+   {
+      fprintf(stderr, "Cannot write %d channels to %s from a %d channel "
+         "stream (try --force-stereo).\n", channels, sink->path, in_channels);
+      return -1;
+   }
+   if (channels != in_channels) mapping_family = 0;
+
+   sink->mixbuf = malloc(sizeof(float)*max_frame*channels);
+   sink->buf = malloc(sizeof(float)*(max_frame>SINK_CHUNK?max_frame:SINK_CHUNK)
+      *channels);
+   sink->out = malloc(sizeof(short)*(max_frame>SINK_CHUNK?max_frame:SINK_CHUNK)
+      *channels);
+   sink->clipmem = calloc(channels, sizeof(float));
+   if (!sink->mixbuf || !sink->buf || !sink->out || !sink->clipmem)
+   {
+      fprintf(stderr, "Memory allocation failure.\n");
+      return -1;
+   }
+   sink->dither = dither && !sink->fp;
+   if (sink->dither)
+   {
+      sink->shapemem.a_buf = calloc(channels, sizeof(float)*4);
+      sink->shapemem.b_buf = calloc(channels, sizeof(float)*4);
+      sink->shapemem.mute = 960;
+      sink->shapemem.fs = sink->rate;
+      sink->shapemem.rng = SHAPESTATE_RNG_SEED;
+      if (!sink->shapemem.a_buf || !sink->shapemem.b_buf)
+      {
+         fprintf(stderr, "Memory allocation failure.\n");
+         return -1;
+      }
+   }
+   if (sink->rate != 48000)
+   {
+      int err;
+      sink->resampler = speex_resampler_init(channels, 48000, sink->rate,
+         quality, &err);
+      if (!sink->resampler)
+      {
+         fprintf(stderr, "resampler error: %s\n", speex_resampler_strerror(err));
+         return -1;
+      }
+      speex_resampler_skip_zeros(sink->resampler);
+   }
+
+   if (strcmp(sink->path, "-") == 0)
+   {
+#if defined WIN32 || defined _WIN32
+      _setmode(_fileno(stdout), _O_BINARY);
+#endif
+      sink->fout = stdout;
+   }
+   else
+   {
+      sink->fout = fopen_utf8(sink->path, "wb");
+      if (!sink->fout)
+      {
+         perror(sink->path);
+         return -1;
+      }
+      if (expected_samples >= 0)
+         expected_size = expected_samples*channels*(sink->fp?4:2);
+   }
+   if (sink->wav_format)
+   {
+      sink->wav_format = write_wav_header(sink->fout, sink->rate,
+         mapping_family, channels, sink->fp, expected_size);
+      if (sink->wav_format < 0)
+      {
+         fprintf(stderr, "Error writing WAV header.\n");
+         return -1;
+      }
+   }
+   if (expected_size >= 0
+      && pcm_prealloc_init(&sink->prealloc_buf, sink->fout, sink->wav_format,
+      expected_size) > 0)
+   {
+      sink->prealloc = &sink->prealloc_buf;
+   }
+   return 0;
+}
+
+/* Resamples, converts and writes frame_size samples of the sink's channels,
+   stopping at the end of the current link like audio_write() in opusdec. */
+static void sink_emit(output_sink *sink, const float *pcm, int frame_size,
+   opus_int64 link_read)
+{
+   int channels = sink->channels;
+   int rate = sink->rate;
+   opus_int64 maxout;
+   maxout=((link_read/48000)*rate + (link_read%48000)*rate/48000)
+      - sink->link_out;
+   maxout=maxout<0?0:maxout;
+   while (frame_size>0 && maxout>0)
+   {
+      unsigned out_len;
+      size_t ret;
+      int i;
+      if (sink->resampler)
+      {
+         spx_uint32_t in_len = frame_size;
+         out_len = SINK_CHUNK<maxout?SINK_CHUNK:(unsigned)maxout;
+         speex_resampler_process_interleaved_float(sink->resampler,
+            pcm, &in_len, sink->buf, &out_len);
+         pcm += channels*in_len;
+         frame_size -= in_len;
+      }
+      else
+      {
+         /*The input may be shared with other sinks, so work on a copy.*/
+         out_len=frame_size<maxout?(unsigned)frame_size:(unsigned)maxout;
+         memcpy(sink->buf, pcm, sizeof(float)*out_len*channels);
+         frame_size=0;
+      }
+      if (!sink->fp)
+      {
+#if defined(HAVE_SOFT_CLIP)
+         opus_pcm_soft_clip(sink->buf, out_len, channels, sink->clipmem);
+#endif
+         if (sink->dither)
+         {
+            pcm_kernels()->shape_dither(&sink->shapemem, sink->out, sink->buf,
+               out_len, channels, NULL);
+         } else {
+            pcm_kernels()->float_to_short(sink->out, sink->buf,
+               out_len*channels);
+         }
+         if (le_short(1)!=(1))
+         {
+            for (i=0;i<(int)out_len*channels;i++)
+               sink->out[i]=le_short(sink->out[i]);
+         }
+      }
+      else if (le_short(1)!=(1))
+      {
+         for (i=0;i<(int)out_len*channels;i++)
+            put_le_float(sink->buf+i, sink->buf[i]);
+      }
+      if (sink->prealloc)
+      {
+         ret=pcm_prealloc_write(sink->prealloc,
+            sink->fp?(char *)sink->buf:(char *)sink->out,
+            (sink->fp?sizeof(float):sizeof(short))*channels, out_len);
+      } else {
+         ret=fwrite(sink->fp?(char *)sink->buf:(char *)sink->out,
+            (sink->fp?sizeof(float):sizeof(short))*channels, out_len,
+            sink->fout);
+      }
+      sink->link_out+=ret;
+      sink->audio_size+=(sink->fp?sizeof(float):sizeof(short))*ret*channels;
+      maxout-=ret;
+      if (ret<out_len)
+      {
+         fprintf(stderr, "Error writing to %s.\n", sink->path);
+         sink->error=1;
+         break;
+      }
+   }
+}
+
+void output_sink_write(output_sink *sink, const float *pcm, int frame_size,
+   opus_int64 link_read)
+{
+   int channels = sink->channels;
+   int in_channels = sink->in_channels;
+   int i;
+   int ci;
+   if (sink->error) return;
+   switch (sink->mix)
+   {
+      case SINK_PERMUTE:
+         for (i=0;i<frame_size;i++)
+            for (ci=0;ci<channels;ci++)
+               sink->mixbuf[i*channels+ci]=pcm[i*channels+sink->map[ci]];
+         pcm=sink->mixbuf;
+         break;
+      case SINK_MONO:
+         for (i=0;i<frame_size;i++)
+         {
+            float sum=0;
+            for (ci=0;ci<in_channels;ci++) sum+=pcm[i*in_channels+ci];
+            sink->mixbuf[i]=sum*(1.f/in_channels);
+         }
+         pcm=sink->mixbuf;
+         break;
+      case SINK_DUP:
+         for (i=0;i<frame_size;i++)
+            sink->mixbuf[2*i]=sink->mixbuf[2*i+1]=pcm[i];
+         pcm=sink->mixbuf;
+         break;
+   }
+   sink_emit(sink, pcm, frame_size, link_read);
+}
+
+static void sink_drain(output_sink *sink, opus_int64 link_read)
+{
+   int drain;
+   if (!sink->resampler || sink->error) return;
+   memset(sink->mixbuf, 0, sizeof(float)*100*sink->channels);
+   drain=speex_resampler_get_input_latency(sink->resampler);
+   do
+   {
+      int tmp=drain<100?drain:100;
+      sink_emit(sink, sink->mixbuf, tmp, link_read);
+      drain-=tmp;
+   } while (drain>0);
+}
+
+void output_sink_end_link(output_sink *sink, opus_int64 link_read)
+{
+   sink_drain(sink, link_read);
+   if (sink->resampler)
+   {
+      speex_resampler_reset_mem(sink->resampler);
+      speex_resampler_skip_zeros(sink->resampler);
+   }
+   sink->link_out=0;
+}
+
+int output_sink_close(output_sink *sink, opus_int64 link_read)
+{
+   int ret;
+   if (sink->fout) sink_drain(sink, link_read);
+   if (sink->prealloc)
+   {
+      if (pcm_prealloc_finish(sink->prealloc, sink->fout, sink->wav_format,
+         sink->audio_size)<0)
+      {
+         fprintf(stderr, "Warning: Cannot update audio size in %s;"
+            " size will be incorrect.\n", sink->path);
+      }
+   }
+   else if (sink->fout && sink->wav_format>0
+      && update_wav_header(sink->fout, sink->wav_format, sink->audio_size)<0)
+   {
+      fprintf(stderr, "Warning: Cannot update audio size in %s;"
+         " size will be incorrect.\n", sink->path);
+   }
+   if (sink->fout)
+   {
+      if (sink->fout==stdout) ret=fflush(sink->fout);
+      else ret=fclose(sink->fout);
+      if (ret!=0 && !sink->error)
+      {
+         perror(sink->path);
+         sink->error=1;
+      }
+      sink->fout=NULL;
+   }
+   if (sink->resampler) speex_resampler_destroy(sink->resampler);
+   sink->resampler=NULL;
+   free(sink->shapemem.a_buf);
+   free(sink->shapemem.b_buf);
+   free(sink->clipmem);
+   free(sink->mixbuf);
+   free(sink->buf);
+   free(sink->out);
+   sink->shapemem.a_buf=sink->shapemem.b_buf=NULL;
+   sink->clipmem=sink->mixbuf=sink->buf=NULL;
+   sink->out=NULL;
+   return sink->error?-1:0;
+}
+
+typedef struct {
+   float *pcm;
+   int frame_size;
+   int new_link;
+   opus_int64 prev_link_read;
+   opus_int64 link_read;
+} sink_frame;
+
+/* With threads, the decoder fills one frame while the sinks work on the
+   other. */
+#define SINK_FRAMES (2)
+
+struct sink_group {
+   output_sink *sinks;
+   int nsinks;
+   int in_channels;
+   int max_frame;
+   int threaded;
+   sink_frame frames[SINK_FRAMES];
+#ifdef HAVE_PTHREAD
+   pthread_mutex_t lock;
+   pthread_cond_t ready;
+   pthread_cond_t done;
+   pthread_t *threads;
+   struct sink_worker *workers;
+   /*Frames published by the decoder, and finished by each sink.*/
+   opus_int64 published;
+   opus_int64 *consumed;
+   int eof;
+#endif
+};
+
+static void sink_process(output_sink *sink, const sink_frame *frame)
+{
+   if (frame->new_link) output_sink_end_link(sink, frame->prev_link_read);
+   output_sink_write(sink, frame->pcm, frame->frame_size, frame->link_read);
+}
+
+#ifdef HAVE_PTHREAD
+struct sink_worker {
+   sink_group *group;
+   int index;
+};
+
+static void *sink_thread(void *arg)
+{
+   struct sink_worker *worker = (struct sink_worker *)arg;
+   sink_group *group = worker->group;
+   int i = worker->index;
+   pthread_mutex_lock(&group->lock);
+   for (;;)
+   {
+      const sink_frame *frame;
+      while (group->consumed[i]==group->published && !group->eof)
+         pthread_cond_wait(&group->ready, &group->lock);
+      if (group->consumed[i]==group->published) break;
+      frame = &group->frames[group->consumed[i]%SINK_FRAMES];
+      pthread_mutex_unlock(&group->lock);
+      sink_process(&group->sinks[i], frame);
+      pthread_mutex_lock(&group->lock);
+      group->consumed[i]++;
+      pthread_cond_signal(&group->done);
+   }
+   pthread_mutex_unlock(&group->lock);
+   return NULL;
+}
+
+static void sink_group_stop(sink_group *group, int nthreads)
+{
+   int i;
+   pthread_mutex_lock(&group->lock);
+   group->eof=1;
+   pthread_cond_broadcast(&group->ready);
+   pthread_mutex_unlock(&group->lock);
+   for (i=0;i<nthreads;i++) pthread_join(group->threads[i], NULL);
+}
+
+static int sink_group_start(sink_group *group)
+{
+   int i;
+   int f;
+   group->threads = malloc(sizeof(*group->threads)*group->nsinks);
+   group->workers = malloc(sizeof(*group->workers)*group->nsinks);
+   group->consumed = calloc(group->nsinks, sizeof(*group->consumed));
+   if (!group->threads || !group->workers || !group->consumed) return -1;
+   for (f=0;f<SINK_FRAMES;f++)
+   {
+      group->frames[f].pcm = malloc(sizeof(float)*group->max_frame
+         *group->in_channels);
+      if (!group->frames[f].pcm) return -1;
+   }
+   pthread_mutex_init(&group->lock, NULL);
+   pthread_cond_init(&group->ready, NULL);
+   pthread_cond_init(&group->done, NULL);
+   for (i=0;i<group->nsinks;i++)
+   {
+      group->workers[i].group = group;
+      group->workers[i].index = i;
+      if (pthread_create(&group->threads[i], NULL, sink_thread,
+         &group->workers[i])!=0)
+      {
+         sink_group_stop(group, i);
+         pthread_mutex_destroy(&group->lock);
+         pthread_cond_destroy(&group->ready);
+         pthread_cond_destroy(&group->done);
+         return -1;
+      }
+   }
+   return 0;
+}
+
+static void sink_group_free_threads(sink_group *group)
+{
+   int f;
+   free(group->threads);
+   free(group->workers);
+   free(group->consumed);
+   for (f=0;f<SINK_FRAMES;f++)
+   {
+      free(group->frames[f].pcm);
+      group->frames[f].pcm = NULL;
+   }
+}
+#endif
+
+sink_group *sink_group_create(output_sink *sinks, int nsinks,
+   int in_channels, int max_frame, int threads)
+{
+   sink_group *group;
+   group = calloc(1, sizeof(*group));
+   if (!group) return NULL;
+   group->sinks = sinks;
+   group->nsinks = nsinks;
+   group->in_channels = in_channels;
+   group->max_frame = max_frame;
+   /*Select the kernels before any sink thread can race to do it.*/
+   pcm_kernels();
+#ifdef HAVE_PTHREAD
+   if (threads && nsinks > 0)
+   {
+      if (sink_group_start(group) == 0) group->threaded = 1;
+      else
+      {
+         fprintf(stderr, "Warning: Cannot start output threads;"
+            " writing outputs in turn.\n");
+         sink_group_free_threads(group);
+      }
+   }
+#else
+   if (threads)
+      fprintf(stderr, "Warning: Built without thread support;"
+         " writing outputs in turn.\n");
+#endif
+   return group;
+}
+
+void sink_group_write(sink_group *group, const float *pcm, int frame_size,
+   int new_link, opus_int64 prev_link_read, opus_int64 link_read)
+{
+   sink_frame *frame;
+   int i;
+#ifdef HAVE_PTHREAD
+   if (group->threaded)
+   {
+      pthread_mutex_lock(&group->lock);
+      /*Wait until every sink is done with the frame that used this slot.*/
+      for (i=0;i<group->nsinks;i++)
+      {
+         while (group->consumed[i]+SINK_FRAMES<=group->published)
+            pthread_cond_wait(&group->done, &group->lock);
+      }
+      pthread_mutex_unlock(&group->lock);
+      frame = &group->frames[group->published%SINK_FRAMES];
+      memcpy(frame->pcm, pcm, sizeof(float)*frame_size*group->in_channels);
+      frame->frame_size = frame_size;
+      frame->new_link = new_link;
+      frame->prev_link_read = prev_link_read;
+      frame->link_read = link_read;
+      pthread_mutex_lock(&group->lock);
+      group->published++;
+      pthread_cond_broadcast(&group->ready);
+      pthread_mutex_unlock(&group->lock);
+      return;
+   }
+#endif
+   frame = &group->frames[0];
+   frame->pcm = (float *)pcm;
+   frame->frame_size = frame_size;
+   frame->new_link = new_link;
+   frame->prev_link_read = prev_link_read;
+   frame->link_read = link_read;
+   for (i=0;i<group->nsinks;i++) sink_process(&group->sinks[i], frame);
+}
+
+int sink_group_close(sink_group *group, opus_int64 link_read)
+{
+   int failed=0;
+   int i;
+   if (!group) return 0;
+#ifdef HAVE_PTHREAD
+   if (group->threaded)
+   {
+      sink_group_stop(group, group->nsinks);
+      pthread_mutex_destroy(&group->lock);
+      pthread_cond_destroy(&group->ready);
+      pthread_cond_destroy(&group->done);
+      sink_group_free_threads(group);
+   }
+#endif
+   for (i=0;i<group->nsinks;i++)
+   {
+      if (output_sink_close(&group->sinks[i], link_read)<0) failed++;
+   }
+   free(group);
+   return failed;
+}
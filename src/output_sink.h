@@ -0,0 +1,114 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: output_sink.h
+   Additional opusdec outputs at their own rate, channel count and format
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_OUTPUT_SINK_H
+#define OPUSTOOLS_OUTPUT_SINK_H
+
+#include <stdio.h>
+#include <opus_types.h>
+#include "speex_resampler.h"
+#include "pcm_kernels.h"
+#include "wav_io.h"
+
+#define SINK_MAX_CHANNELS (255)
+
+/* One --output rate:channels:format:path of opusdec. A sink takes the
+   decoded 48 kHz float PCM and writes it to its own file at its own
+   sampling rate, channel count and sample format, with its own resampler
+   and dither state. */
+typedef struct output_sink output_sink;
+struct output_sink {
+   const char *path;
+   int rate;
+   /* 0 means the channel count of the decoded stream. */
+   int channels;
+   int fp;
+   int wav_format;
+   int in_channels;
+   int mix;
+   unsigned char map[SINK_MAX_CHANNELS];
+   FILE *fout;
+   pcm_prealloc prealloc_buf;
+   pcm_prealloc *prealloc;
+   SpeexResamplerState *resampler;
+   shapestate shapemem;
+   int dither;
+   float *clipmem;
+   float *mixbuf;
+   float *buf;
+   short *out;
+   opus_int64 link_out;
+   opus_int64 audio_size;
+   int error;
+};
+
+/* Fills in the sink from a rate:channels:format:path specification. The
+   rate defaults to 48000, the channels to those of the stream and the format
+   (s16 or float) to s16. Output is Wave if the path ends in .wav. Returns 0
+   on success or -1 if the specification is invalid. */
+int output_sink_parse(output_sink *sink, const char *spec);
+
+/* Opens the output file and sets up the conversion from in_channels at
+   48 kHz. expected_samples is the total output length at the sink's rate, or
+   -1 if it is not known. Returns 0 on success or -1 on error. */
+int output_sink_open(output_sink *sink, int in_channels, int mapping_family,
+   int max_frame, int quality, int dither, opus_int64 expected_samples);
+
+/* Converts and writes frame_size decoded samples. link_read is the number
+   of 48 kHz samples decoded in the current link so far, including these. */
+void output_sink_write(output_sink *sink, const float *pcm, int frame_size,
+   opus_int64 link_read);
+
+/* Flushes the resampler at the end of a link of link_read samples, so the
+   next link starts from a clean state. */
+void output_sink_end_link(output_sink *sink, opus_int64 link_read);
+
+/* Flushes the last link, completes the Wave header and closes the file.
+   Returns 0 on success or -1 if writing failed at any point. */
+int output_sink_close(output_sink *sink, opus_int64 link_read);
+
+/* Feeds every sink from the one decode loop. With threads, each sink runs in
+   its own thread and the decoder can work on the next frame while the sinks
+   convert the current one. */
+typedef struct sink_group sink_group;
+
+/* Sinks must be opened first. Returns NULL on allocation failure. If the
+   threads cannot be started, the sinks are fed from the calling thread. */
+sink_group *sink_group_create(output_sink *sinks, int nsinks,
+   int in_channels, int max_frame, int threads);
+
+/* Passes one decoded frame to all sinks. If new_link is set, the previous
+   link (of prev_link_read samples) is flushed first. */
+void sink_group_write(sink_group *group, const float *pcm, int frame_size,
+   int new_link, opus_int64 prev_link_read, opus_int64 link_read);
+
+/* Waits for the sinks and closes them. Returns the number of sinks that
+   failed. */
+int sink_group_close(sink_group *group, opus_int64 link_read);
+
+#endif
@@ -0,0 +1,247 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: packet_stats.c
+   Streaming statistics on the packets of an Opus stream
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet_stats.h"
+
+static int sketch_bin(ogg_int32_t value)
+{
+   int k;
+   if (value < SKETCH_SUB) return value < 0 ? 0 : value;
+   for (k = SKETCH_SUB_BITS; (value >> k) >= 2; k++);
+   return SKETCH_SUB*(k - SKETCH_SUB_BITS + 1)
+      + ((value >> (k - SKETCH_SUB_BITS)) & (SKETCH_SUB - 1));
+}
+
+/* Returns the middle of the values that fall in a bin. */
+static ogg_int32_t sketch_value(int bin)
+{
+   int k;
+   ogg_int32_t low;
+   if (bin < SKETCH_SUB) return bin;
+   k = bin/SKETCH_SUB - 1 + SKETCH_SUB_BITS;
+   low = (ogg_int32_t)(SKETCH_SUB + (bin & (SKETCH_SUB - 1)))
+      << (k - SKETCH_SUB_BITS);
+   return low + ((1 << (k - SKETCH_SUB_BITS)) >> 1);
+}
+
+void value_sketch_add(value_sketch *sketch, ogg_int32_t value)
+{
+   if (value < 0) value = 0;
+   if (!sketch->count || value < sketch->min) sketch->min = value;
+   if (!sketch->count || value > sketch->max) sketch->max = value;
+   sketch->count++;
+   sketch->bins[sketch_bin(value)]++;
+}
+
+ogg_int32_t value_sketch_quantile(const value_sketch *sketch, double q)
+{
+   ogg_int64_t rank;
+   ogg_int64_t seen;
+   ogg_int32_t value;
+   int bin;
+   if (!sketch->count) return -1;
+   rank = (ogg_int64_t)(q*sketch->count + .5);
+   if (rank < 1) rank = 1;
+   if (rank > sketch->count) rank = sketch->count;
+   seen = 0;
+   for (bin = 0; bin < SKETCH_BINS - 1; bin++)
+   {
+      seen += sketch->bins[bin];
+      if (seen >= rank) break;
+   }
+   value = sketch_value(bin);
+   if (value < sketch->min) value = sketch->min;
+   if (value > sketch->max) value = sketch->max;
+   return value;
+}
+
+void packet_stats_init(packet_stats *stats)
+{
+   memset(stats, 0, sizeof(*stats));
+}
+
+/* Adds the bitrate over a window of packets, in bits per second. */
+static void add_window(packet_stats *stats)
+{
+   value_sketch_add(&stats->rates, (ogg_int32_t)
+      (stats->window_bytes*8*48000/stats->window_samples));
+   stats->window_samples = 0;
+   stats->window_bytes = 0;
+}
+
+void packet_stats_add(packet_stats *stats, const unsigned char *data,
+   ogg_int32_t len, int frames, int samples)
+{
+   stats->packets++;
+   stats->configs[data[0] >> 3]++;
+   if (data[0] & 0x4) stats->stereo++;
+   if (frames >= 0 && frames < 49) stats->frames[frames]++;
+   /* Packets of one or two bytes carry no audio (RFC 6716 section 3.2.1). */
+   if (len <= 2) stats->dtx++;
+   value_sketch_add(&stats->sizes, len);
+   stats->window_samples += samples;
+   stats->window_bytes += len;
+   if (stats->window_samples >= 48000) add_window(stats);
+}
+
+void packet_stats_add_empty(packet_stats *stats)
+{
+   stats->empty++;
+}
+
+void packet_stats_finish(packet_stats *stats)
+{
+   if (!stats->rates.count && stats->window_samples > 0) add_window(stats);
+}
+
+void packet_stats_config_name(int config, char *name, int size)
+{
+   static const char *const modes[3] = {"SILK", "Hybrid", "CELT"};
+   static const char *const bandwidths[5] = {"NB", "MB", "WB", "SWB", "FB"};
+   static const char *const silk_sizes[4] = {"10", "20", "40", "60"};
+   static const char *const celt_sizes[4] = {"2.5", "5", "10", "20"};
+   int mode;
+   int bandwidth;
+   const char *frame;
+   if (config < 12)
+   {
+      mode = 0;
+      bandwidth = config >> 2;
+      frame = silk_sizes[config & 3];
+   }
+   else if (config < 16)
+   {
+      mode = 1;
+      bandwidth = 3 + ((config - 12) >> 1);
+      frame = silk_sizes[config & 1];
+   }
+   else
+   {
+      mode = 2;
+      bandwidth = (config - 16) >> 2;
+      if (bandwidth > 0) bandwidth++;
+      frame = celt_sizes[config & 3];
+   }
+   snprintf(name, size, "%s %s %sms", modes[mode], bandwidths[bandwidth],
+      frame);
+}
+
+typedef struct {
+   char *text;
+   size_t len;
+   size_t size;
+} json_buffer;
+
+static void json_append(json_buffer *out, const char *format, ...)
+{
+   va_list ap;
+   int len;
+   if (!out->text) return;
+   va_start(ap, format);
+   len = vsnprintf(out->text + out->len, out->size - out->len, format, ap);
+   va_end(ap);
+   if (len < 0 || (size_t)len >= out->size - out->len)
+   {
+      char *text;
+      size_t size = 2*out->size + (len < 0 ? 0 : len);
+      text = len < 0 ? NULL : realloc(out->text, size);
+      if (!text)
+      {
+         free(out->text);
+         out->text = NULL;
+         return;
+      }
+      out->text = text;
+      out->size = size;
+      va_start(ap, format);
+      vsnprintf(out->text + out->len, out->size - out->len, format, ap);
+      va_end(ap);
+   }
+   out->len += len;
+}
+
+static void json_sketch(json_buffer *out, const value_sketch *sketch)
+{
+   if (!sketch->count)
+   {
+      json_append(out, "null");
+      return;
+   }
+   json_append(out, "{\"min\":%ld,\"p10\":%ld,\"p50\":%ld,\"p90\":%ld,"
+      "\"p99\":%ld,\"max\":%ld}", (long)sketch->min,
+      (long)value_sketch_quantile(sketch, .1),
+      (long)value_sketch_quantile(sketch, .5),
+      (long)value_sketch_quantile(sketch, .9),
+      (long)value_sketch_quantile(sketch, .99), (long)sketch->max);
+}
+
+char *packet_stats_json(const packet_stats *stats)
+{
+   json_buffer out;
+   char name[32];
+   int first;
+   int i;
+   out.size = 1024;
+   out.len = 0;
+   out.text = malloc(out.size);
+   json_append(&out, "{\"packets\":%ld,\"configs\":{", (long)stats->packets);
+   first = 1;
+   for (i = 0; i < 32; i++)
+   {
+      if (!stats->configs[i]) continue;
+      packet_stats_config_name(i, name, sizeof(name));
+      json_append(&out, "%s\"%s\":%ld", first ? "" : ",", name,
+         (long)stats->configs[i]);
+      first = 0;
+   }
+   json_append(&out, "},\"stereo\":%ld,\"frames\":{", (long)stats->stereo);
+   first = 1;
+   for (i = 0; i < 49; i++)
+   {
+      if (!stats->frames[i]) continue;
+      json_append(&out, "%s\"%d\":%ld", first ? "" : ",", i,
+         (long)stats->frames[i]);
+      first = 0;
+   }
+   json_append(&out, "},\"dtx\":%ld,\"empty\":%ld,\"packet_bytes\":",
+      (long)stats->dtx, (long)stats->empty);
+   json_sketch(&out, &stats->sizes);
+   json_append(&out, ",\"bits_per_second\":");
+   json_sketch(&out, &stats->rates);
+   json_append(&out, "}");
+   return out.text;
+}
@@ -0,0 +1,86 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: packet_stats.h
+   Streaming statistics on the packets of an Opus stream
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_PACKET_STATS_H
+#define OPUSTOOLS_PACKET_STATS_H
+
+#include <ogg/ogg.h>
+
+/* Values up to 15 have a bin each; larger ones have 16 bins for each
+   power of two, so quantiles are within 1/16 of the true value. */
+#define SKETCH_SUB_BITS (4)
+#define SKETCH_SUB (1<<SKETCH_SUB_BITS)
+#define SKETCH_BINS (SKETCH_SUB*(32 - SKETCH_SUB_BITS))
+
+typedef struct {
+   ogg_int64_t count;
+   ogg_int32_t min;
+   ogg_int32_t max;
+   ogg_int64_t bins[SKETCH_BINS];
+} value_sketch;
+
+/* Counts of the TOC fields of each packet, and the distributions of the
+   packet sizes and of the bitrate over each second, in a fixed amount of
+   memory whatever the length of the stream. Multistream packets are
+   counted by the TOC of their first stream. */
+typedef struct {
+   ogg_int64_t packets;
+   ogg_int64_t configs[32];
+   ogg_int64_t stereo;
+   ogg_int64_t frames[49];
+   ogg_int64_t dtx;
+   ogg_int64_t empty;
+   value_sketch sizes;
+   value_sketch rates;
+   ogg_int64_t window_samples;
+   ogg_int64_t window_bytes;
+} packet_stats;
+
+void value_sketch_add(value_sketch *sketch, ogg_int32_t value);
+/* Returns the value below which a fraction q of the values lie, or -1 if
+   there are none. */
+ogg_int32_t value_sketch_quantile(const value_sketch *sketch, double q);
+
+void packet_stats_init(packet_stats *stats);
+/* Adds a packet of len bytes with a valid TOC, holding frames frames and
+   samples samples at 48 kHz. */
+void packet_stats_add(packet_stats *stats, const unsigned char *data,
+   ogg_int32_t len, int frames, int samples);
+/* Counts a packet of zero bytes. */
+void packet_stats_add_empty(packet_stats *stats);
+/* Adds the last second of the stream, if the stream is shorter than a
+   second. */
+void packet_stats_finish(packet_stats *stats);
+
+/* Writes a name such as "CELT FB 20ms" for a TOC configuration. */
+void packet_stats_config_name(int config, char *name, int size);
+/* Returns the statistics as a JSON object, to be freed by the caller, or
+   NULL if out of memory. */
+char *packet_stats_json(const packet_stats *stats);
+
+#endif
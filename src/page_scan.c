@@ -0,0 +1,318 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: page_scan.c
+   Finding the pages of an Ogg file with several threads
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#if defined WIN32 || defined _WIN32
+# include "unicode_support.h"
+#else
+# define fopen_utf8(_x,_y) fopen((_x),(_y))
+#endif
+
+#include "page_scan.h"
+
+/* Macros for handling potentially large file offsets */
+#if defined WIN32 || defined _WIN32
+# define OFF_T __int64
+# define FSEEK _fseeki64
+# define FTELL _ftelli64
+#elif defined HAVE_FSEEKO
+# define OFF_T off_t
+# define FSEEK fseeko
+# define FTELL ftello
+#else
+# define OFF_T long
+# define FSEEK fseek
+# define FTELL ftell
+#endif
+
+/* The bytes given to each thread in a round. */
+#define SCAN_RANGE (4*1024*1024)
+/* The largest possible Ogg page. */
+#define MAX_PAGE_SIZE (65307)
+
+typedef struct {
+   ogg_int64_t offset;
+   ogg_page page;
+} scan_entry;
+
+/* The pages starting in [begin, end), read by one thread. */
+typedef struct {
+   FILE *f;
+   ogg_int64_t begin;
+   ogg_int64_t end;
+   ogg_int64_t size;
+   ogg_sync_state oy;
+   scan_entry *pages;
+   int npages;
+   int apages;
+} scan_range;
+
+typedef struct {
+   scan_range *ranges;
+   int nranges;
+} scan_round;
+
+struct page_scan {
+   int threads;
+   ogg_int64_t size;
+   /* Rounds are filled into one set of ranges while the caller reads the
+      pages of the other one. */
+   scan_round rounds[2];
+   int current;
+   int pending;
+   ogg_int64_t next_begin;
+#ifdef HAVE_PTHREAD
+   pthread_t *workers;
+   int *started;
+#endif
+   int range;
+   int page;
+   ogg_int64_t last_end;
+};
+
+static void range_fill(scan_range *r)
+{
+   ogg_int64_t stop;
+   ogg_int64_t pos;
+   long want;
+   long got;
+   char *buffer;
+   ogg_sync_reset(&r->oy);
+   r->npages = 0;
+   /* A page starting just before end runs past it. */
+   stop = r->end + MAX_PAGE_SIZE < r->size ? r->end + MAX_PAGE_SIZE : r->size;
+   want = (long)(stop - r->begin);
+   if (FSEEK(r->f, (OFF_T)r->begin, SEEK_SET) != 0) return;
+   buffer = ogg_sync_buffer(&r->oy, want);
+   got = (long)fread(buffer, 1, want, r->f);
+   ogg_sync_wrote(&r->oy, got);
+   pos = r->begin;
+   /* The buffer is only written once, so the pages stay where they are. */
+   while (pos < r->end)
+   {
+      long ret;
+      ogg_page page;
+      ret = ogg_sync_pageseek(&r->oy, &page);
+      if (ret == 0) break;
+      if (ret < 0)
+      {
+         pos += -ret;
+         continue;
+      }
+      if (r->npages == r->apages)
+      {
+         int apages = r->apages ? 2*r->apages : 256;
+         scan_entry *pages = realloc(r->pages, sizeof(*pages)*apages);
+         if (!pages) break;
+         r->pages = pages;
+         r->apages = apages;
+      }
+      r->pages[r->npages].offset = pos;
+      r->pages[r->npages].page = page;
+      r->npages++;
+      pos += ret;
+   }
+}
+
+#ifdef HAVE_PTHREAD
+static void *range_worker(void *arg)
+{
+   range_fill((scan_range *)arg);
+   return NULL;
+}
+#endif
+
+/* Starts reading the round at scan->next_begin into the set that is not
+   being read. */
+static void round_start(page_scan *scan)
+{
+   scan_round *round = &scan->rounds[!scan->current];
+   int i;
+   round->nranges = 0;
+   for (i = 0; i < scan->threads; i++)
+   {
+      scan_range *r = &round->ranges[i];
+      if (scan->next_begin >= scan->size) break;
+      r->begin = scan->next_begin;
+      r->end = r->begin + SCAN_RANGE < scan->size ?
+         r->begin + SCAN_RANGE : scan->size;
+      r->size = scan->size;
+      scan->next_begin = r->end;
+      round->nranges++;
+#ifdef HAVE_PTHREAD
+      scan->started[i] = pthread_create(&scan->workers[i], NULL,
+         range_worker, r) == 0;
+      if (!scan->started[i])
+#endif
+         range_fill(r);
+   }
+   scan->pending = 1;
+}
+
+/* Waits for the round being read and makes it the current one. */
+static void round_finish(page_scan *scan)
+{
+#ifdef HAVE_PTHREAD
+   int i;
+   for (i = 0; i < scan->rounds[!scan->current].nranges; i++)
+      if (scan->started[i]) pthread_join(scan->workers[i], NULL);
+#endif
+   scan->current = !scan->current;
+   scan->pending = 0;
+   scan->range = 0;
+   scan->page = 0;
+}
+
+page_scan *page_scan_open(const char *path, int threads)
+{
+   page_scan *scan;
+   FILE *f;
+   int k;
+   int i;
+   if (threads < 1) threads = 1;
+   f = fopen_utf8(path, "rb");
+   if (!f) return NULL;
+   scan = calloc(1, sizeof(*scan));
+   if (!scan || FSEEK(f, 0, SEEK_END) != 0)
+   {
+      free(scan);
+      fclose(f);
+      return NULL;
+   }
+   scan->size = FTELL(f);
+   fclose(f);
+   scan->threads = threads;
+#ifdef HAVE_PTHREAD
+   scan->workers = calloc(threads, sizeof(*scan->workers));
+   scan->started = calloc(threads, sizeof(*scan->started));
+#endif
+   for (k = 0; k < 2; k++)
+   {
+      scan->rounds[k].ranges = calloc(threads, sizeof(scan_range));
+      if (!scan->rounds[k].ranges) break;
+      for (i = 0; i < threads; i++)
+      {
+         scan_range *r = &scan->rounds[k].ranges[i];
+         ogg_sync_init(&r->oy);
+         /* Each thread seeks on its own handle. */
+         r->f = fopen_utf8(path, "rb");
+         if (!r->f) break;
+      }
+      if (i < threads) break;
+   }
+#ifdef HAVE_PTHREAD
+   if (k < 2 || !scan->workers || !scan->started)
+#else
+   if (k < 2)
+#endif
+   {
+      page_scan_close(scan);
+      return NULL;
+   }
+   round_start(scan);
+   round_finish(scan);
+   round_start(scan);
+   return scan;
+}
+
+int page_scan_next(page_scan *scan, ogg_page *page, ogg_int64_t *offset,
+   ogg_int64_t *hole)
+{
+   for (;;)
+   {
+      scan_round *round = &scan->rounds[scan->current];
+      scan_range *r;
+      scan_entry *e;
+      if (scan->range >= round->nranges)
+      {
+         if (!scan->pending || scan->rounds[!scan->current].nranges == 0)
+         {
+            if (scan->pending) round_finish(scan);
+            *offset = scan->size;
+            *hole = scan->size - scan->last_end;
+            scan->last_end = scan->size;
+            return 0;
+         }
+         round_finish(scan);
+         round_start(scan);
+         continue;
+      }
+      r = &round->ranges[scan->range];
+      if (scan->page >= r->npages)
+      {
+         scan->range++;
+         scan->page = 0;
+         continue;
+      }
+      e = &r->pages[scan->page++];
+      /* A capture that overlaps the last page of the previous range is not
+         a real page. */
+      if (e->offset < scan->last_end) continue;
+      *page = e->page;
+      *offset = e->offset;
+      *hole = e->offset - scan->last_end;
+      scan->last_end = e->offset + e->page.header_len + e->page.body_len;
+      return 1;
+   }
+}
+
+void page_scan_close(page_scan *scan)
+{
+   int k;
+   int i;
+   if (!scan) return;
+   if (scan->pending) round_finish(scan);
+   for (k = 0; k < 2; k++)
+   {
+      if (!scan->rounds[k].ranges) continue;
+      for (i = 0; i < scan->threads; i++)
+      {
+         scan_range *r = &scan->rounds[k].ranges[i];
+         if (r->f) fclose(r->f);
+         ogg_sync_clear(&r->oy);
+         free(r->pages);
+      }
+      free(scan->rounds[k].ranges);
+   }
+#ifdef HAVE_PTHREAD
+   free(scan->workers);
+   free(scan->started);
+#endif
+   free(scan);
+}
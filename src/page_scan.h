@@ -0,0 +1,53 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: page_scan.h
+   Finding the pages of an Ogg file with several threads
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_PAGE_SCAN_H
+#define OPUSTOOLS_PAGE_SCAN_H
+
+#include <ogg/ogg.h>
+
+typedef struct page_scan page_scan;
+
+/* Opens path to return its pages in order. The file is read in rounds of
+   one range of bytes per thread; the threads capture the pages of their
+   range, checking their CRCs, while the caller works on the pages of the
+   previous round. Returns NULL if the file cannot be opened, with errno
+   set. */
+page_scan *page_scan_open(const char *path, int threads);
+
+/* Stores the next page of the file in page, which stays valid until the
+   next call. *offset receives where it starts, and *hole the number of
+   bytes before it that are not part of any page. Returns 1 on success, or 0
+   at the end of the file, where *offset receives the size of the file and
+   *hole the number of bytes after the last page. */
+int page_scan_next(page_scan *scan, ogg_page *page, ogg_int64_t *offset,
+   ogg_int64_t *hole);
+
+void page_scan_close(page_scan *scan);
+
+#endif
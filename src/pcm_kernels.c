@@ -0,0 +1,407 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: pcm_kernels.c
+   PCM conversion, dither and downmix kernels with run-time dispatch
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "pcm_kernels.h"
+#include "cpusupport.h"
+
+#ifdef HAVE_LRINTF
+# define float2int(x) lrintf(x)
+#else
+# define float2int(flt) ((int)(floor(.5+flt)))
+#endif
+
+#ifndef HAVE_FMINF
+# define fminf(_x,_y) ((_x)<(_y)?(_x):(_y))
+#endif
+
+#ifndef HAVE_FMAXF
+# define fmaxf(_x,_y) ((_x)>(_y)?(_x):(_y))
+#endif
+
+#define MINI(_a,_b)      ((_a)<(_b)?(_a):(_b))
+
+/* x86 variants are built with per-function target attributes when the
+   compiler supports them (see configure), so they can be selected at run
+   time regardless of the baseline ISA. */
+#if defined(HAVE_AVX2_TARGET)
+# include <immintrin.h>
+# define PCM_SSE2
+# define PCM_AVX2
+# define PCM_TARGET_SSE2 __attribute__((target("sse2")))
+# define PCM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define PCM_SSE2
+# define PCM_TARGET_SSE2
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+# define PCM_NEON
+#endif
+
+static void float_to_short_c(short *out, const float *in, int n)
+{
+  int i;
+  for (i=0;i<n;i++)
+    out[i]=(short)float2int(fmaxf(-32768,fminf(in[i]*32768.f,32767)));
+}
+
+/* The vector variants of float_to_short() round the same way, so this
+   gives the same samples whichever one is selected. */
+void float_to_short_planar(short *out, const float *in, int n, int channels,
+ const int *out_offsets)
+{
+  int c;
+  for (c=0;c<channels;c++)
+  {
+    short *o=out+out_offsets[c];
+    int i;
+    for (i=0;i<n;i++)
+      o[i]=(short)float2int(fmaxf(-32768,fminf(in[i*channels+c]*32768.f,32767)));
+  }
+}
+
+#ifdef PCM_SSE2
+/* _mm_min_ps() returns its second operand for NaN, like fminf() above. */
+PCM_TARGET_SSE2
+static void float_to_short_sse2(short *out, const float *in, int n)
+{
+  const __m128 scale = _mm_set1_ps(32768.f);
+  const __m128 lo = _mm_set1_ps(-32768.f);
+  const __m128 hi = _mm_set1_ps(32767.f);
+  int i;
+  for (i=0;i+8<=n;i+=8)
+  {
+    __m128 a = _mm_mul_ps(_mm_loadu_ps(in+i), scale);
+    __m128 b = _mm_mul_ps(_mm_loadu_ps(in+i+4), scale);
+    a = _mm_max_ps(lo, _mm_min_ps(a, hi));
+    b = _mm_max_ps(lo, _mm_min_ps(b, hi));
+    _mm_storeu_si128((__m128i *)(out+i),
+     _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+  }
+  float_to_short_c(out+i, in+i, n-i);
+}
+#endif
+
+#ifdef PCM_AVX2
+PCM_TARGET_AVX2
+static void float_to_short_avx2(short *out, const float *in, int n)
+{
+  const __m256 scale = _mm256_set1_ps(32768.f);
+  const __m256 lo = _mm256_set1_ps(-32768.f);
+  const __m256 hi = _mm256_set1_ps(32767.f);
+  int i;
+  for (i=0;i+16<=n;i+=16)
+  {
+    __m256 a = _mm256_mul_ps(_mm256_loadu_ps(in+i), scale);
+    __m256 b = _mm256_mul_ps(_mm256_loadu_ps(in+i+8), scale);
+    __m256i p;
+    a = _mm256_max_ps(lo, _mm256_min_ps(a, hi));
+    b = _mm256_max_ps(lo, _mm256_min_ps(b, hi));
+    /* packs works within 128-bit lanes, so restore the sample order */
+    p = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+    _mm256_storeu_si256((__m256i *)(out+i), _mm256_permute4x64_epi64(p, 0xD8));
+  }
+  float_to_short_c(out+i, in+i, n-i);
+}
+#endif
+
+#ifdef PCM_NEON
+static void float_to_short_neon(short *out, const float *in, int n)
+{
+  const float32x4_t scale = vdupq_n_f32(32768.f);
+  const float32x4_t lo = vdupq_n_f32(-32768.f);
+  const float32x4_t hi = vdupq_n_f32(32767.f);
+  int i;
+  for (i=0;i+8<=n;i+=8)
+  {
+    float32x4_t a = vmulq_f32(vld1q_f32(in+i), scale);
+    float32x4_t b = vmulq_f32(vld1q_f32(in+i+4), scale);
+    a = vmaxnmq_f32(lo, vminnmq_f32(a, hi));
+    b = vmaxnmq_f32(lo, vminnmq_f32(b, hi));
+    vst1q_s16(out+i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)),
+     vqmovn_s32(vcvtnq_s32_f32(b))));
+  }
+  float_to_short_c(out+i, in+i, n-i);
+}
+#endif
+
+static inline unsigned int fast_rand(unsigned int *seed)
+{
+  *seed = (*seed * 96314165) + 907633515;
+  return *seed;
+}
+
+/* This implements a 16 bit quantization with full triangular dither
+   and IIR noise shaping. The noise shaping filters were designed by
+   Sebastian Gesemann based on the LAME ATH curves with flattening
+   to limit their peak gain to 20 dB.
+   (Everyone elses' noise shaping filters are mildly crazy)
+   The 48kHz version of this filter is just a warped version of the
+   44.1kHz filter and probably could be improved by shifting the
+   HF shelf up in frequency a little bit since 48k has a bit more
+   room and being more conservative against bat-ears is probably
+   more important than more noise suppression.
+   This process can increase the peak level of the signal (in theory
+   by the peak error of 1.5 +20 dB though this much is unobservable rare)
+   so to avoid clipping the signal is attenuated by a couple thousandths
+   of a dB. Initially the approach taken here was to only attenuate by
+   the 99.9th percentile, making clipping rare but not impossible (like
+   SoX) but the limited gain of the filter means that the worst case was
+   only two thousandths of a dB more, so this just uses the worst case.
+   The attenuation is probably also helpful to prevent clipping in the DAC
+   reconstruction filters or downstream resampling in any case.*/
+static const float shape_gains[3]={32768.f-15.f,32768.f-15.f,32768.f-3.f};
+static const float shape_fcoef[3][8] =
+{
+  {2.2374f, -.7339f, -.1251f, -.6033f, 0.9030f, .0116f, -.5853f, -.2571f}, /* 48.0kHz noise shaping filter sd=2.34*/
+  {2.2061f, -.4706f, -.2534f, -.6214f, 1.0587f, .0676f, -.6054f, -.2738f}, /* 44.1kHz noise shaping filter sd=2.51*/
+  {1.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f,0.0000f, 0.0000f, 0.0000f}, /* lowpass noise shaping filter sd=0.65*/
+};
+
+static void shape_dither_c(shapestate *_ss, short *_o, const float *_i, int _n, int _CC, const int *_off)
+{
+  int i;
+  int rate=_ss->fs==44100?1:(_ss->fs==48000?0:2);
+  float gain=shape_gains[rate];
+  float *b_buf;
+  float *a_buf;
+  int mute=_ss->mute;
+  b_buf=_ss->b_buf;
+  a_buf=_ss->a_buf;
+  /*In order to avoid replacing digital silence with quiet dither noise
+    we mute if the output has been silent for a while*/
+  if(mute>64)
+    memset(a_buf,0,sizeof(float)*_CC*4);
+  for(i=0;i<_n;i++)
+  {
+    int c;
+    int pos = i*_CC;
+    int silent=1;
+    for(c=0;c<_CC;c++)
+    {
+      int j, si;
+      float r,s,err=0;
+      silent&=_i[pos+c]==0;
+      s=_i[pos+c]*gain;
+      for(j=0;j<4;j++)
+        err += shape_fcoef[rate][j]*b_buf[c*4+j] - shape_fcoef[rate][j+4]*a_buf[c*4+j];
+      memmove(&a_buf[c*4+1],&a_buf[c*4],sizeof(float)*3);
+      memmove(&b_buf[c*4+1],&b_buf[c*4],sizeof(float)*3);
+      a_buf[c*4]=err;
+      s = s - err;
+      r=(float)fast_rand(&_ss->rng)*(1/(float)UINT_MAX) - (float)fast_rand(&_ss->rng)*(1/(float)UINT_MAX);
+      if (mute>16)r=0;
+      /*Clamp in float out of paranoia that the input will be >96 dBFS and wrap if the
+        integer is clamped.*/
+      _o[_off?_off[c]+i:pos+c] = si = float2int(fmaxf(-32768,fminf(s + r,32767)));
+      /*Including clipping in the noise shaping is generally disastrous:
+        the futile effort to restore the clipped energy results in more clipping.
+        However, small amounts-- at the level which could normally be created by
+        dither and rounding-- are harmless and can even reduce clipping somewhat
+        due to the clipping sometimes reducing the dither+rounding error.*/
+      b_buf[c*4] = (mute>16)?0:fmaxf(-1.5f,fminf(si - s,1.5f));
+    }
+    mute++;
+    if(!silent)mute=0;
+  }
+  _ss->mute=MINI(mute,960);
+}
+
+#ifdef PCM_SSE2
+/* Same as shape_dither_c(), but each channel's 4-tap filter history is kept
+   in one vector, which replaces the dot products and the memmove()s. The
+   taps are summed and the random numbers drawn in the same order, so the
+   output is identical to the C version. */
+PCM_TARGET_SSE2
+static void shape_dither_sse2(shapestate *_ss, short *_o, const float *_i, int _n, int _CC, const int *_off)
+{
+  int i;
+  int rate=_ss->fs==44100?1:(_ss->fs==48000?0:2);
+  float gain=shape_gains[rate];
+  const __m128 fb=_mm_loadu_ps(shape_fcoef[rate]);
+  const __m128 fa=_mm_loadu_ps(shape_fcoef[rate]+4);
+  float *b_buf;
+  float *a_buf;
+  int mute=_ss->mute;
+  b_buf=_ss->b_buf;
+  a_buf=_ss->a_buf;
+  if(mute>64)
+    memset(a_buf,0,sizeof(float)*_CC*4);
+  for(i=0;i<_n;i++)
+  {
+    int c;
+    int pos = i*_CC;
+    int silent=1;
+    for(c=0;c<_CC;c++)
+    {
+      int si;
+      float r,s,err;
+      __m128 a=_mm_loadu_ps(a_buf+c*4);
+      __m128 b=_mm_loadu_ps(b_buf+c*4);
+      __m128 v=_mm_sub_ps(_mm_mul_ps(fb,b),_mm_mul_ps(fa,a));
+      __m128 e;
+      /*Sum the taps in the same order as the C version.*/
+      e=_mm_add_ss(v,_mm_shuffle_ps(v,v,0x55));
+      e=_mm_add_ss(e,_mm_movehl_ps(v,v));
+      e=_mm_add_ss(e,_mm_shuffle_ps(v,v,0xFF));
+      err=_mm_cvtss_f32(e);
+      silent&=_i[pos+c]==0;
+      s=_i[pos+c]*gain;
+      /*Shift the history by one and insert the new value in front.*/
+      a=_mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(a),4)),
+       _mm_set_ss(err));
+      _mm_storeu_ps(a_buf+c*4,a);
+      s = s - err;
+      r=(float)fast_rand(&_ss->rng)*(1/(float)UINT_MAX) - (float)fast_rand(&_ss->rng)*(1/(float)UINT_MAX);
+      if (mute>16)r=0;
+      _o[_off?_off[c]+i:pos+c] = si = float2int(fmaxf(-32768,fminf(s + r,32767)));
+      b=_mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(b),4)),
+       _mm_set_ss((mute>16)?0:fmaxf(-1.5f,fminf(si - s,1.5f))));
+      _mm_storeu_ps(b_buf+c*4,b);
+    }
+    mute++;
+    if(!silent)mute=0;
+  }
+  _ss->mute=MINI(mute,960);
+}
+#endif
+
+static void downmix_c(float *out, const float *in, const float *matrix,
+ int in_channels, int out_channels, int n)
+{
+  int i,j,k;
+  for (i=0; i<n; ++i) {
+    for (j=0; j<out_channels; ++j) {
+      float *samp = &out[i*out_channels+j];
+      *samp = 0;
+      for (k=0; k<in_channels; ++k) {
+        *samp += in[i*in_channels+k] * matrix[in_channels*j+k];
+      }
+    }
+  }
+}
+
+#ifdef PCM_AVX2
+/* Surround downmixes have at most 8 input and 2 output channels: each frame
+   is one masked load, and both dot products are reduced together. */
+PCM_TARGET_AVX2
+static void downmix_avx2(float *out, const float *in, const float *matrix,
+ int in_channels, int out_channels, int n)
+{
+  __m256i mask;
+  __m256 m0;
+  __m256 m1;
+  int i;
+  if (in_channels > 8 || out_channels > 2)
+  {
+    downmix_c(out, in, matrix, in_channels, out_channels, n);
+    return;
+  }
+  mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(in_channels),
+   _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  m0 = _mm256_maskload_ps(matrix, mask);
+  m1 = out_channels == 2 ? _mm256_maskload_ps(matrix+in_channels, mask)
+   : _mm256_setzero_ps();
+  for (i=0; i<n; ++i)
+  {
+    __m256 x = _mm256_maskload_ps(in+i*in_channels, mask);
+    __m256 h = _mm256_hadd_ps(_mm256_mul_ps(x, m0), _mm256_mul_ps(x, m1));
+    __m128 r;
+    h = _mm256_hadd_ps(h, h);
+    r = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+    if (out_channels == 2)
+      _mm_storel_pi((__m64 *)(out+2*i), r);
+    else
+      _mm_store_ss(out+i, r);
+  }
+}
+#endif
+
+static pcm_kernel_table pcm_kernel_tab;
+
+const pcm_kernel_table *pcm_kernels(void)
+{
+  static int initialized = 0;
+  if (!initialized)
+  {
+    int features;
+    features = cpu_features();
+    (void)features;
+    pcm_kernel_tab.float_to_short = float_to_short_c;
+    pcm_kernel_tab.float_to_short_name = "c";
+    pcm_kernel_tab.shape_dither = shape_dither_c;
+    pcm_kernel_tab.shape_dither_name = "c";
+    pcm_kernel_tab.downmix = downmix_c;
+    pcm_kernel_tab.downmix_name = "c";
+#ifdef PCM_SSE2
+    if (features & CPU_FEATURE_SSE2)
+    {
+      pcm_kernel_tab.float_to_short = float_to_short_sse2;
+      pcm_kernel_tab.float_to_short_name = "sse2";
+      pcm_kernel_tab.shape_dither = shape_dither_sse2;
+      pcm_kernel_tab.shape_dither_name = "sse2";
+    }
+#endif
+#ifdef PCM_AVX2
+    if (features & CPU_FEATURE_AVX2)
+    {
+      pcm_kernel_tab.float_to_short = float_to_short_avx2;
+      pcm_kernel_tab.float_to_short_name = "avx2";
+      pcm_kernel_tab.downmix = downmix_avx2;
+      pcm_kernel_tab.downmix_name = "avx2";
+    }
+#endif
+#ifdef PCM_NEON
+    if (features & CPU_FEATURE_NEON)
+    {
+      pcm_kernel_tab.float_to_short = float_to_short_neon;
+      pcm_kernel_tab.float_to_short_name = "neon";
+    }
+#endif
+    initialized = 1;
+  }
+  return &pcm_kernel_tab;
+}
+
+void pcm_kernels_print_info(FILE *file)
+{
+  const pcm_kernel_table *k;
+  k = pcm_kernels();
+  fprintf(file, "  float to 16-bit: %s\n", k->float_to_short_name);
+  fprintf(file, "  dither:          %s\n", k->shape_dither_name);
+  fprintf(file, "  downmix:         %s\n", k->downmix_name);
+}
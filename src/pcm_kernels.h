@@ -0,0 +1,84 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: pcm_kernels.h
+   PCM conversion, dither and downmix kernels with run-time dispatch
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_PCM_KERNELS_H
+#define OPUSTOOLS_PCM_KERNELS_H
+
+#include <stdio.h>
+
+typedef struct shapestate shapestate;
+struct shapestate {
+  float * b_buf;
+  float * a_buf;
+  int fs;
+  int mute;
+  /* Dither noise generator state, so that several outputs can be dithered
+     from different threads. */
+  unsigned int rng;
+};
+
+#define SHAPESTATE_RNG_SEED (22222)
+
+/* Converts n floats in [-1,1] to 16-bit samples with rounding and clipping. */
+typedef void (*float_to_short_func)(short *out, const float *in, int n);
+
+/* Converts n frames of channels interleaved floats to 16-bit samples with
+   triangular dither and noise shaping. The output is interleaved too if
+   out_offsets is NULL; otherwise sample c of frame i goes to
+   out[out_offsets[c]+i], so that planar output is written in the same
+   pass. */
+typedef void (*shape_dither_func)(shapestate *ss, short *out,
+   const float *in, int n, int channels, const int *out_offsets);
+
+/* out[i*out_channels+j] = sum(in[i*in_channels+k]*matrix[in_channels*j+k])
+   for n frames. */
+typedef void (*downmix_func)(float *out, const float *in, const float *matrix,
+   int in_channels, int out_channels, int n);
+
+typedef struct {
+   float_to_short_func float_to_short;
+   shape_dither_func shape_dither;
+   downmix_func downmix;
+   const char *float_to_short_name;
+   const char *shape_dither_name;
+   const char *downmix_name;
+} pcm_kernel_table;
+
+/* Returns the variants selected for this CPU (see cpu_features()). The table
+   is filled on first use, which must happen before any threads are started. */
+const pcm_kernel_table *pcm_kernels(void);
+
+/* Same as float_to_short(), but channel c of frame i of the n frames of
+   channels interleaved floats goes to out[out_offsets[c]+i]. */
+void float_to_short_planar(short *out, const float *in, int n, int channels,
+   const int *out_offsets);
+
+/* Prints which variant of each kernel was selected. */
+void pcm_kernels_print_info(FILE *file);
+
+#endif
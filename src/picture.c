@@ -32,6 +32,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include "picture.h"
+#include "tagcompare.h"
+#include "text_kernels.h"
 
 
 int is_jpeg(const unsigned char *buf, size_t length)
@@ -53,33 +55,111 @@ int is_gif(const unsigned char *buf, size_t length)
 #define READ_U32_BE(buf) \
     (((ogg_uint32_t)(buf)[0]<<24)|((buf)[1]<<16)|((buf)[2]<<8)|(buf)[3])
 
-/*Tries to extract the width, height, bits per pixel, and palette size of a
-   PNG.
-  On failure, simply leaves its outputs unmodified.*/
-void extract_png_params(const unsigned char *data, size_t data_length,
-                        ogg_uint32_t *width, ogg_uint32_t *height,
-                        ogg_uint32_t *depth, ogg_uint32_t *colors,
-                        int *has_palette)
+static int base64_value(int c)
 {
-  if(is_png(data,data_length)){
+  if(c>='A'&&c<='Z')return c-'A';
+  if(c>='a'&&c<='z')return 26+c-'a';
+  if(c>='0'&&c<='9')return 52+c-'0';
+  if(c=='+')return 62;
+  if(c=='/')return 63;
+  return -1;
+}
+
+void base64_data_init(base64_data *b64, const char *text, size_t text_length)
+{
+  size_t length;
+  length=3*(text_length>>2);
+  if(length>2&&text[text_length-1]=='='){
+    length--;
+    if(text[text_length-2]=='=')length--;
+  }
+  b64->text=text;
+  b64->length=length;
+}
+
+size_t base64_read(const base64_data *b64, size_t offset,
+                   unsigned char *buf, size_t n)
+{
+  size_t i;
+  if(offset>=b64->length)return 0;
+  if(n>b64->length-offset)n=b64->length-offset;
+  for(i=0;i<n;){
+    const char   *quad;
+    ogg_uint32_t  value;
+    size_t        k;
+    quad=b64->text+4*((offset+i)/3);
+    value=0;
+    for(k=0;k<4;k++){
+      int d;
+      d=base64_value((unsigned char)quad[k]);
+      value=value<<6|(d<0?0:d);
+    }
+    for(k=(offset+i)%3;k<3&&i<n;k++)buf[i++]=(unsigned char)(value>>(16-8*k));
+  }
+  return n;
+}
+
+/*The image data given to the parameter extraction: either in memory, or
+   still Base64 encoded, in which case it is decoded a little at a time as
+   it is read.*/
+#define IMAGE_CACHE (96)
+
+typedef struct {
+  const unsigned char *data;
+  const base64_data   *b64;
+  size_t               offset;
+  size_t               length;
+  unsigned char        cache[IMAGE_CACHE];
+  size_t               cache_offs;
+  size_t               cache_len;
+} image_source;
+
+/*Returns n bytes of the image from offs, or NULL if they are not all there.
+  n must be at most IMAGE_CACHE, and the pointer is only valid until the
+   next call.*/
+static const unsigned char *image_get(image_source *src, size_t offs,
+                                      size_t n)
+{
+  if(offs>src->length||n>src->length-offs)return NULL;
+  if(src->data)return src->data+offs;
+  if(offs<src->cache_offs||offs+n>src->cache_offs+src->cache_len){
+    src->cache_offs=offs;
+    src->cache_len=base64_read(src->b64,src->offset+offs,src->cache,
+     src->length-offs<IMAGE_CACHE?src->length-offs:IMAGE_CACHE);
+  }
+  return src->cache+(offs-src->cache_offs);
+}
+
+static void png_params(image_source *src,
+                       ogg_uint32_t *width, ogg_uint32_t *height,
+                       ogg_uint32_t *depth, ogg_uint32_t *colors,
+                       int *has_palette)
+{
+  const unsigned char *p;
+  size_t data_length;
+  data_length=src->length;
+  p=image_get(src,0,8);
+  if(p!=NULL&&is_png(p,8)){
     size_t offs;
     offs=8;
     while(data_length-offs>=12){
       ogg_uint32_t chunk_len;
-      chunk_len=READ_U32_BE(data+offs);
+      p=image_get(src,offs,12);
+      chunk_len=READ_U32_BE(p);
       if(chunk_len>data_length-(offs+12))break;
-      else if(chunk_len==13&&memcmp(data+offs+4,"IHDR",4)==0){
+      else if(chunk_len==13&&memcmp(p+4,"IHDR",4)==0){
         int color_type;
-        *width=READ_U32_BE(data+offs+8);
-        *height=READ_U32_BE(data+offs+12);
-        color_type=data[offs+17];
+        p=image_get(src,offs,25);
+        *width=READ_U32_BE(p+8);
+        *height=READ_U32_BE(p+12);
+        color_type=p[17];
         if(color_type==3){
           *depth=24;
           *has_palette=1;
         }
         else{
           int sample_depth;
-          sample_depth=data[offs+16];
+          sample_depth=p[16];
           if(color_type==0)*depth=sample_depth;
           else if(color_type==2)*depth=sample_depth*3;
           else if(color_type==4)*depth=sample_depth*2;
@@ -89,7 +169,7 @@ void extract_png_params(const unsigned char *data, size_t data_length,
           break;
         }
       }
-      else if(*has_palette>0&&memcmp(data+offs+4,"PLTE",4)==0){
+      else if(*has_palette>0&&memcmp(p+4,"PLTE",4)==0){
         *colors=chunk_len/3;
         break;
       }
@@ -98,42 +178,42 @@ void extract_png_params(const unsigned char *data, size_t data_length,
   }
 }
 
-/*Tries to extract the width, height, bits per pixel, and palette size of a
-   GIF.
-  On failure, simply leaves its outputs unmodified.*/
-void extract_gif_params(const unsigned char *data, size_t data_length,
-                        ogg_uint32_t *width, ogg_uint32_t *height,
-                        ogg_uint32_t *depth, ogg_uint32_t *colors,
-                        int *has_palette)
+static void gif_params(image_source *src,
+                       ogg_uint32_t *width, ogg_uint32_t *height,
+                       ogg_uint32_t *depth, ogg_uint32_t *colors,
+                       int *has_palette)
 {
-  if(is_gif(data,data_length)&&data_length>=14){
-    *width=data[6]|data[7]<<8;
-    *height=data[8]|data[9]<<8;
+  const unsigned char *p;
+  p=image_get(src,0,14);
+  if(p!=NULL&&is_gif(p,14)){
+    *width=p[6]|p[7]<<8;
+    *height=p[8]|p[9]<<8;
     /*libFLAC hard-codes the depth to 24.*/
     *depth=24;
-    *colors=1<<((data[10]&7)+1);
+    *colors=1<<((p[10]&7)+1);
     *has_palette=1;
   }
 }
 
-
-/*Tries to extract the width, height, bits per pixel, and palette size of a
-   JPEG.
-  On failure, simply leaves its outputs unmodified.*/
-void extract_jpeg_params(const unsigned char *data, size_t data_length,
-                         ogg_uint32_t *width, ogg_uint32_t *height,
-                         ogg_uint32_t *depth, ogg_uint32_t *colors,
-                         int *has_palette)
+static void jpeg_params(image_source *src,
+                        ogg_uint32_t *width, ogg_uint32_t *height,
+                        ogg_uint32_t *depth, ogg_uint32_t *colors,
+                        int *has_palette)
 {
-  if(is_jpeg(data,data_length)){
+  const unsigned char *p;
+  size_t data_length;
+  data_length=src->length;
+  p=image_get(src,0,3);
+  if(p!=NULL&&is_jpeg(p,3)){
     size_t offs;
     offs=2;
     for(;;){
       size_t segment_len;
       int    marker;
-      while(offs<data_length&&data[offs]!=0xFF)offs++;
-      while(offs<data_length&&data[offs]==0xFF)offs++;
-      marker=data[offs];
+      while(offs<data_length&&*image_get(src,offs,1)!=0xFF)offs++;
+      while(offs<data_length&&*image_get(src,offs,1)==0xFF)offs++;
+      if(offs>=data_length)break;
+      marker=*image_get(src,offs,1);
       offs++;
       /*If we hit EOI* (end of image), or another SOI* (start of image),
          or SOS (start of scan), then stop now.*/
@@ -142,14 +222,16 @@ void extract_jpeg_params(const unsigned char *data, size_t data_length,
       else if(marker>=0xD0&&marker<=0xD7)continue;
       /*Read the length of the marker segment.*/
       if(data_length-offs<2)break;
-      segment_len=data[offs]<<8|data[offs+1];
+      p=image_get(src,offs,2);
+      segment_len=p[0]<<8|p[1];
       if(segment_len<2||data_length-offs<segment_len)break;
       if(marker==0xC0||(marker>0xC0&&marker<0xD0&&(marker&3)!=0)){
         /*Found a SOFn (start of frame) marker segment:*/
         if(segment_len>=8){
-          *height=data[offs+3]<<8|data[offs+4];
-          *width=data[offs+5]<<8|data[offs+6];
-          *depth=data[offs+2]*data[offs+7];
+          p=image_get(src,offs,8);
+          *height=p[3]<<8|p[4];
+          *width=p[5]<<8|p[6];
+          *depth=p[2]*p[7];
           *colors=0;
           *has_palette=0;
         }
@@ -160,3 +242,238 @@ void extract_jpeg_params(const unsigned char *data, size_t data_length,
     }
   }
 }
+
+static void image_source_init(image_source *src, const unsigned char *data,
+                              const base64_data *b64, size_t offset,
+                              size_t length)
+{
+  src->data=data;
+  src->b64=b64;
+  src->offset=offset;
+  src->length=length;
+  src->cache_offs=0;
+  src->cache_len=0;
+}
+
+/*Tries to extract the width, height, bits per pixel, and palette size of a
+   PNG.
+  On failure, simply leaves its outputs unmodified.*/
+void extract_png_params(const unsigned char *data, size_t data_length,
+                        ogg_uint32_t *width, ogg_uint32_t *height,
+                        ogg_uint32_t *depth, ogg_uint32_t *colors,
+                        int *has_palette)
+{
+  image_source src;
+  image_source_init(&src,data,NULL,0,data_length);
+  png_params(&src,width,height,depth,colors,has_palette);
+}
+
+/*Tries to extract the width, height, bits per pixel, and palette size of a
+   GIF.
+  On failure, simply leaves its outputs unmodified.*/
+void extract_gif_params(const unsigned char *data, size_t data_length,
+                        ogg_uint32_t *width, ogg_uint32_t *height,
+                        ogg_uint32_t *depth, ogg_uint32_t *colors,
+                        int *has_palette)
+{
+  image_source src;
+  image_source_init(&src,data,NULL,0,data_length);
+  gif_params(&src,width,height,depth,colors,has_palette);
+}
+
+
+/*Tries to extract the width, height, bits per pixel, and palette size of a
+   JPEG.
+  On failure, simply leaves its outputs unmodified.*/
+void extract_jpeg_params(const unsigned char *data, size_t data_length,
+                         ogg_uint32_t *width, ogg_uint32_t *height,
+                         ogg_uint32_t *depth, ogg_uint32_t *colors,
+                         int *has_palette)
+{
+  image_source src;
+  image_source_init(&src,data,NULL,0,data_length);
+  jpeg_params(&src,width,height,depth,colors,has_palette);
+}
+
+/*Finds the format of an image still in Base64, from its first bytes.*/
+static int base64_format(const base64_data *b64, size_t offset,
+                         size_t length)
+{
+  unsigned char head[8];
+  size_t        n;
+  n=base64_read(b64,offset,head,length<8?length:8);
+  if(is_jpeg(head,n))return PIC_FORMAT_JPEG;
+  if(is_png(head,n))return PIC_FORMAT_PNG;
+  if(is_gif(head,n))return PIC_FORMAT_GIF;
+  return -1;
+}
+
+int is_base64_format(const base64_data *b64, size_t offset, size_t length,
+                     int format)
+{
+  return base64_format(b64,offset,length)==format;
+}
+
+void extract_base64_params(const base64_data *b64, size_t offset,
+                           size_t length, int format,
+                           ogg_uint32_t *width, ogg_uint32_t *height,
+                           ogg_uint32_t *depth, ogg_uint32_t *colors,
+                           int *has_palette)
+{
+  image_source src;
+  image_source_init(&src,NULL,b64,offset,length);
+  switch(format){
+    case PIC_FORMAT_JPEG:
+      jpeg_params(&src,width,height,depth,colors,has_palette);
+      break;
+    case PIC_FORMAT_PNG:
+      png_params(&src,width,height,depth,colors,has_palette);
+      break;
+    case PIC_FORMAT_GIF:
+      gif_params(&src,width,height,depth,colors,has_palette);
+      break;
+  }
+}
+
+static ogg_uint32_t base64_u32_be(const base64_data *b64, size_t offset)
+{
+  unsigned char buf[4];
+  base64_read(b64,offset,buf,4);
+  return READ_U32_BE(buf);
+}
+
+static char *base64_string(const base64_data *b64, size_t offset,
+                           size_t length)
+{
+  char *str;
+  str=(char *)malloc(length+1);
+  if(str!=NULL){
+    base64_read(b64,offset,(unsigned char *)str,length);
+    str[length]='\0';
+  }
+  return str;
+}
+
+int picture_tag_parse(picture_tag *pic, const char *tag)
+{
+  base64_data  b64;
+  const char  *text;
+  size_t       text_length;
+  size_t       data_sz;
+  size_t       i;
+  size_t       cur;
+  ogg_uint32_t mime_type_length;
+  ogg_uint32_t description_length;
+  ogg_uint32_t file_width;
+  ogg_uint32_t file_height;
+  ogg_uint32_t file_depth;
+  ogg_uint32_t file_colors;
+  int          has_palette;
+  int          colors_set;
+  memset(pic,0,sizeof(*pic));
+  if(tagcompare(tag,"METADATA_BLOCK_PICTURE=",23)==0)tag+=23;
+  text=tag;
+  text_length=strlen(text);
+  if(text_length&3)return -1;
+  /*Check the Base64 text without decoding it: '=' may only pad the end.*/
+  for(i=0;i<text_length;i++){
+    i+=text_kernels()->base64_span(text+i,text_length-i);
+    if(i>=text_length)break;
+    if((text[i]!='='||i<text_length-2
+     ||(i==text_length-2&&text[i+1]!='='))){
+      return -1;
+    }
+  }
+  base64_data_init(&b64,text,text_length);
+  data_sz=b64.length;
+  if(data_sz<32)return -1;
+  pic->type=base64_u32_be(&b64,0);
+  mime_type_length=base64_u32_be(&b64,4);
+  if(mime_type_length>data_sz-32)return -1;
+  description_length=base64_u32_be(&b64,8+mime_type_length);
+  if(description_length>data_sz-mime_type_length-32)return -1;
+  cur=12+mime_type_length+description_length;
+  pic->width=base64_u32_be(&b64,cur);
+  pic->height=base64_u32_be(&b64,cur+4);
+  pic->depth=base64_u32_be(&b64,cur+8);
+  pic->colors=base64_u32_be(&b64,cur+12);
+  /*If one of these is set, they all must be, but colors==0 is a valid
+     value.*/
+  colors_set=pic->width!=0||pic->height!=0||pic->depth!=0||pic->colors!=0;
+  if((pic->width==0||pic->height==0||pic->depth==0)&&colors_set)return -1;
+  pic->data_length=base64_u32_be(&b64,cur+16);
+  cur+=20;
+  if(pic->data_length>data_sz-cur)return -1;
+  pic->mime_type=base64_string(&b64,8,mime_type_length);
+  pic->description=base64_string(&b64,12+mime_type_length,
+   description_length);
+  if(pic->mime_type==NULL||pic->description==NULL){
+    picture_tag_clear(pic);
+    return -1;
+  }
+  pic->format=-1;
+  if(mime_type_length==3&&strcmp(pic->mime_type,"-->")==0){
+    pic->is_url=1;
+    /*Picture type 1 must be a 32x32 PNG.*/
+    if(pic->type==1&&(pic->width!=0||pic->height!=0)
+     &&(pic->width!=32||pic->height!=32)){
+      picture_tag_clear(pic);
+      return -1;
+    }
+    pic->url=base64_string(&b64,cur,pic->data_length);
+    if(pic->url==NULL){
+      picture_tag_clear(pic);
+      return -1;
+    }
+    return 0;
+  }
+  if(mime_type_length==10
+   &&tagcompare(pic->mime_type,"image/jpeg",mime_type_length)==0){
+    if(is_base64_format(&b64,cur,pic->data_length,PIC_FORMAT_JPEG)){
+      pic->format=PIC_FORMAT_JPEG;
+    }
+  }
+  else if(mime_type_length==9
+   &&tagcompare(pic->mime_type,"image/png",mime_type_length)==0){
+    if(is_base64_format(&b64,cur,pic->data_length,PIC_FORMAT_PNG)){
+      pic->format=PIC_FORMAT_PNG;
+    }
+  }
+  else if(mime_type_length==9
+   &&tagcompare(pic->mime_type,"image/gif",mime_type_length)==0){
+    if(is_base64_format(&b64,cur,pic->data_length,PIC_FORMAT_GIF)){
+      pic->format=PIC_FORMAT_GIF;
+    }
+  }
+  else if(mime_type_length==0||(mime_type_length==6
+   &&tagcompare(pic->mime_type,"image/",mime_type_length)==0)){
+    pic->format=base64_format(&b64,cur,pic->data_length);
+  }
+  file_width=file_height=file_depth=file_colors=0;
+  has_palette=-1;
+  extract_base64_params(&b64,cur,pic->data_length,pic->format,
+   &file_width,&file_height,&file_depth,&file_colors,&has_palette);
+  if(has_palette>=0){
+    /*If we successfully extracted these parameters from the image,
+       override any declared values.*/
+    pic->width=file_width;
+    pic->height=file_height;
+    pic->depth=file_depth;
+    pic->colors=file_colors;
+  }
+  /*Picture type 1 must be a 32x32 PNG.*/
+  if(pic->type==1&&(pic->format!=PIC_FORMAT_PNG
+   ||pic->width!=32||pic->height!=32)){
+    picture_tag_clear(pic);
+    return -1;
+  }
+  return 0;
+}
+
+void picture_tag_clear(picture_tag *pic)
+{
+  free(pic->mime_type);
+  free(pic->description);
+  free(pic->url);
+  memset(pic,0,sizeof(*pic));
+}
@@ -22,3 +22,54 @@ void extract_jpeg_params(const unsigned char *data, size_t data_length,
                          ogg_uint32_t *width, ogg_uint32_t *height,
                          ogg_uint32_t *depth, ogg_uint32_t *colors,
                          int *has_palette);
+
+/*Base64 text that is decoded only where it is read, so that the pictures
+   in METADATA_BLOCK_PICTURE comments can be checked without a decoded copy
+   of the image.
+  length is the number of bytes the text decodes to. Characters that are
+   not valid Base64 decode as zero bits, so the text should be checked
+   first.*/
+typedef struct {
+  const char *text;
+  size_t      length;
+} base64_data;
+
+void base64_data_init(base64_data *b64, const char *text, size_t text_length);
+/*Decodes up to n bytes from offset into buf, and returns how many there
+   were.*/
+size_t base64_read(const base64_data *b64, size_t offset,
+                   unsigned char *buf, size_t n);
+
+/*Versions of is_*() and extract_*_params() for the length bytes of image
+   data at offset in Base64 text, reading only the parts they need.*/
+int is_base64_format(const base64_data *b64, size_t offset, size_t length,
+                     int format);
+void extract_base64_params(const base64_data *b64, size_t offset,
+                           size_t length, int format,
+                           ogg_uint32_t *width, ogg_uint32_t *height,
+                           ogg_uint32_t *depth, ogg_uint32_t *colors,
+                           int *has_palette);
+
+/*A METADATA_BLOCK_PICTURE comment, as from opus_picture_tag_parse() in
+   libopusfile, but without the image data, which is never decoded.
+  format is a picture_format, or -1 if it is not known, and the URL is set
+   instead for a link to the picture.*/
+typedef struct {
+  ogg_uint32_t  type;
+  char         *mime_type;
+  char         *description;
+  ogg_uint32_t  width;
+  ogg_uint32_t  height;
+  ogg_uint32_t  depth;
+  ogg_uint32_t  colors;
+  ogg_uint32_t  data_length;
+  int           format;
+  int           is_url;
+  char         *url;
+} picture_tag;
+
+/*tag may include the "METADATA_BLOCK_PICTURE=" prefix.
+  Returns 0 on success, or -1 if it is not a valid picture, in which case
+   nothing needs to be freed.*/
+int picture_tag_parse(picture_tag *pic, const char *tag);
+void picture_tag_clear(picture_tag *pic);
@@ -0,0 +1,198 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: reader_check.c
+   Checks the file_reader against the bytes of the file
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Writes files of a few sizes around the read block size and reads them
+   back with a file_reader, both without a ring (the plain reads used when
+   io_uring is missing or refused) and with one if this system has it. Each
+   file is read in order in chunks of random size, and then at random
+   offsets reached with each kind of seek. Fails if a read returns other
+   bytes than the file holds, or more or fewer of them. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !(defined WIN32 || defined _WIN32)
+# include <unistd.h>
+#endif
+
+#include "file_reader.h"
+
+/* A read that never ends is a failure too. */
+#define TIMEOUT_SECONDS (60)
+
+static long failures;
+static long checks;
+
+static unsigned int rng_state = 1;
+
+static unsigned int rng(void)
+{
+  rng_state = rng_state*1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static void fail(const char *what, const char *mode, long size,
+    ogg_int64_t offset)
+{
+  if (failures < 20)
+    fprintf(stderr, "%s: %s, file of %ld bytes, at offset %ld\n", what, mode,
+        size, (long)offset);
+  failures++;
+}
+
+/* Reads n bytes at the reader's position, which should be offset, and
+   compares them with the file. */
+static int check_read(file_reader *r, const unsigned char *data, long size,
+    ogg_int64_t offset, long n, unsigned char *buf, const char *mode)
+{
+  long want;
+  long got;
+  want = offset + n > size ? (long)(size - offset) : n;
+  if (want < 0) want = 0;
+  got = file_reader_read(r, buf, n);
+  checks++;
+  if (got != want)
+  {
+    fail(got < want ? "Short read" : "Long read", mode, size, offset);
+    return -1;
+  }
+  if (memcmp(buf, data + offset, got) != 0)
+  {
+    fail("Wrong bytes", mode, size, offset);
+    return -1;
+  }
+  if (file_reader_tell(r) != offset + got)
+  {
+    fail("Wrong position", mode, size, offset);
+    return -1;
+  }
+  return 0;
+}
+
+static void check_file(const char *path, const unsigned char *data,
+    long size, file_ring *ring, const char *mode)
+{
+  file_reader *r;
+  unsigned char *buf;
+  ogg_int64_t offset;
+  int i;
+  buf = malloc(1 << 20);
+  r = file_reader_open(path, ring);
+  if (!buf || !r)
+  {
+    fail("Cannot open", mode, size, 0);
+    free(buf);
+    file_reader_close(r);
+    return;
+  }
+  /* In order, past the end of the file. */
+  offset = 0;
+  while (offset <= size)
+  {
+    long n = 1 + (long)(rng() % (rng() & 1 ? 4500 : (1 << 20)));
+    if (check_read(r, data, size, offset, n, buf, mode) < 0) break;
+    offset += n;
+  }
+  /* At random offsets, with each kind of seek, and reading on from there
+     some of the time. */
+  for (i=0; i<64; i++)
+  {
+    ogg_int64_t target = (ogg_int64_t)(rng() % (size + 1));
+    ogg_int64_t ret;
+    int whence = (int)(rng() % 3);
+    if (whence == 0) ret = file_reader_seek(r, target, SEEK_SET);
+    else if (whence == 1)
+      ret = file_reader_seek(r, target - file_reader_tell(r), SEEK_CUR);
+    else ret = file_reader_seek(r, target - size, SEEK_END);
+    checks++;
+    if (ret != target)
+    {
+      fail("Bad seek", mode, size, target);
+      continue;
+    }
+    offset = target;
+    do {
+      long n = 1 + (long)(rng() % 300000);
+      if (check_read(r, data, size, offset, n, buf, mode) < 0) break;
+      offset += n;
+    } while (offset < size && rng() % 4 == 0);
+  }
+  file_reader_close(r);
+  free(buf);
+}
+
+int main(void)
+{
+  /* Around the 256 kB read block, and large enough to need read-ahead. */
+  static const long sizes[] = {
+    0, 1, 4500, 100000, 262143, 262144, 262145, 1000000, 3*262144 + 17
+  };
+  const char *path = "reader_check.tmp";
+  file_ring *ring;
+  unsigned char *data;
+  long max_size;
+  int i;
+#if !(defined WIN32 || defined _WIN32)
+  alarm(TIMEOUT_SECONDS);
+#endif
+  max_size = sizes[sizeof(sizes)/sizeof(*sizes) - 1];
+  data = malloc(max_size);
+  if (!data)
+  {
+    fprintf(stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  for (i=0; i<max_size; i++)
+    data[i] = (unsigned char)(rng() >> 4);
+  ring = file_ring_create();
+  printf("Checking without a ring%s\n", ring ? " and with one" : "");
+  for (i=0; i<(int)(sizeof(sizes)/sizeof(*sizes)); i++)
+  {
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(data, 1, sizes[i], f) != (size_t)sizes[i])
+    {
+      fprintf(stderr, "Cannot write %s\n", path);
+      if (f) fclose(f);
+      remove(path);
+      return EXIT_FAILURE;
+    }
+    fclose(f);
+    check_file(path, data, sizes[i], NULL, "no ring");
+    if (ring) check_file(path, data, sizes[i], ring, "ring");
+  }
+  remove(path);
+  file_ring_destroy(ring);
+  free(data);
+  printf("%ld checks, %ld failed\n", checks, failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -79,6 +79,7 @@ static void speex_free(void *ptr) {free(ptr);}
 #endif /* OUTSIDE_SPEEX */
 
 #include <math.h>
+#include <string.h>
 #include <limits.h>
 
 #ifndef M_PI
@@ -100,6 +101,10 @@ static void speex_free(void *ptr) {free(ptr);}
 #include "resample_sse.h"
 #endif
 
+#if defined(HAVE_AVX2_TARGET) && !defined(FIXED_POINT)
+#include "resample_avx.h"
+#endif
+
 #ifdef USE_NEON
 #include "resample_neon.h"
 #endif
@@ -113,6 +118,28 @@ static void speex_free(void *ptr) {free(ptr);}
 
 typedef int (*resampler_basic_func)(SpeexResamplerState *, spx_uint32_t , const spx_word16_t *, spx_uint32_t *, spx_word16_t *, spx_uint32_t *);
 
+/* A sinc table is never modified once computed and only depends on the
+   parameters below, so all resamplers that need the same table share one
+   reference-counted copy. Unreferenced tables are kept around (up to
+   SINC_CACHE_MAX_IDLE of them) so that destroying and re-creating a
+   resampler, e.g. at each link of a chained stream, does not rebuild them. */
+struct SincTable {
+   struct SincTable *next;
+   int refs;
+   int quality;
+   int use_direct;
+   spx_uint32_t den_rate;
+   spx_uint32_t filt_len;
+   spx_uint32_t oversample;
+   float cutoff;
+   spx_word16_t *table;
+};
+
+#define SINC_CACHE_MAX_IDLE 4
+
+/* Most recently used first */
+static struct SincTable *sinc_cache = NULL;
+
 struct SpeexResamplerState_ {
    spx_uint32_t in_rate;
    spx_uint32_t out_rate;
@@ -120,6 +147,7 @@ struct SpeexResamplerState_ {
    spx_uint32_t den_rate;
 
    int    quality;
+   int    low_latency;
    spx_uint32_t nb_channels;
    spx_uint32_t filt_len;
    spx_uint32_t mem_alloc_size;
@@ -137,10 +165,17 @@ struct SpeexResamplerState_ {
    spx_uint32_t *magic_samples;
 
    spx_word16_t *mem;
-   spx_word16_t *sinc_table;
-   spx_uint32_t sinc_table_length;
+   const spx_word16_t *sinc_table;
+   struct SincTable *sinc_entry;
    resampler_basic_func resampler_ptr;
 
+   /* Interleaved fast path: all channels are filtered together while they
+      are in the same phase (see speex_resampler_process_interleaved_float).
+      NULL when the current filter has no such kernel. */
+   resampler_basic_func interleaved_ptr;
+   spx_word16_t *ibuf;
+   spx_uint32_t ibuf_size;
+
    int    in_stride;
    int    out_stride;
 } ;
@@ -237,6 +272,23 @@ static const struct QualityMapping quality_map[11] = {
    {256, 32, 0.975f, 0.975f, KAISER12}, /* Q10 */ /* 96.6% cutoff (~100 dB stop) 10 */
 };
 /*8,24,40,56,80,104,128,160,200,256,320*/
+
+/* In low-latency mode the filters are half as long (but at least 8 taps).
+   That doubles the width of the transition band, so the cutoff is moved
+   down by the same amount to keep the stopband edge, and therefore the
+   attenuation, where the full-length filter has it. */
+static void quality_params(const SpeexResamplerState *st, int downsample,
+      spx_uint32_t *base_length, float *bandwidth)
+{
+   const struct QualityMapping *q = &quality_map[st->quality];
+   *base_length = q->base_length;
+   *bandwidth = downsample ? q->downsample_bandwidth : q->upsample_bandwidth;
+   if (st->low_latency)
+   {
+      *base_length = IMAX(8, q->base_length/2);
+      *bandwidth = *bandwidth - (1.f - *bandwidth)*(q->base_length/(float)*base_length - 1.f);
+   }
+}
 static double compute_func(float x, const struct FuncDef *func)
 {
    float y, frac;
@@ -435,6 +487,44 @@ static int resampler_basic_direct_double(SpeexResamplerState *st, spx_uint32_t c
 }
 #endif
 
+#ifdef OVERRIDE_INTERLEAVED_PRODUCT_SINGLE
+/* Like resampler_basic_direct_single, but computes every channel at once from
+   a channel-interleaved buffer. Uses (and updates) the phase of channel 0,
+   which the caller guarantees is shared by all channels. */
+static int resampler_interleaved_direct_single(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
+{
+   const int N = st->filt_len;
+   const spx_uint32_t C = st->nb_channels;
+   int out_sample = 0;
+   int last_sample = st->last_sample[channel_index];
+   spx_uint32_t samp_frac_num = st->samp_frac_num[channel_index];
+   const spx_word16_t *sinc_table = st->sinc_table;
+   const int int_advance = st->int_advance;
+   const int frac_advance = st->frac_advance;
+   const spx_uint32_t den_rate = st->den_rate;
+
+   while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
+   {
+      const spx_word16_t *sinct = & sinc_table[samp_frac_num*N];
+      const spx_word16_t *iptr = & in[last_sample*C];
+
+      interleaved_product_single(sinct, iptr, N, C, out + out_sample*C);
+      out_sample++;
+      last_sample += int_advance;
+      samp_frac_num += frac_advance;
+      if (samp_frac_num >= den_rate)
+      {
+         samp_frac_num -= den_rate;
+         last_sample++;
+      }
+   }
+
+   st->last_sample[channel_index] = last_sample;
+   st->samp_frac_num[channel_index] = samp_frac_num;
+   return out_sample;
+}
+#endif
+
 static int resampler_basic_interpolate_single(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
 {
    const int N = st->filt_len;
@@ -558,6 +648,184 @@ static int resampler_basic_interpolate_double(SpeexResamplerState *st, spx_uint3
 }
 #endif
 
+#ifdef RESAMPLE_AVX2
+/* These are the same as the generic functions above, using the AVX2/FMA
+   (or AVX-512) products from resample_avx.h. */
+
+RESAMPLE_TARGET_AVX2
+static int resampler_basic_direct_single_avx2(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
+{
+   const int N = st->filt_len;
+   int out_sample = 0;
+   int last_sample = st->last_sample[channel_index];
+   spx_uint32_t samp_frac_num = st->samp_frac_num[channel_index];
+   const spx_word16_t *sinc_table = st->sinc_table;
+   const int out_stride = st->out_stride;
+   const int int_advance = st->int_advance;
+   const int frac_advance = st->frac_advance;
+   const spx_uint32_t den_rate = st->den_rate;
+
+   while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
+   {
+      const spx_word16_t *sinct = & sinc_table[samp_frac_num*N];
+      const spx_word16_t *iptr = & in[last_sample];
+
+      out[out_stride * out_sample++] = inner_product_single_avx2(sinct, iptr, N);
+      last_sample += int_advance;
+      samp_frac_num += frac_advance;
+      if (samp_frac_num >= den_rate)
+      {
+         samp_frac_num -= den_rate;
+         last_sample++;
+      }
+   }
+
+   st->last_sample[channel_index] = last_sample;
+   st->samp_frac_num[channel_index] = samp_frac_num;
+   return out_sample;
+}
+
+RESAMPLE_TARGET_AVX2
+static int resampler_basic_direct_double_avx2(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
+{
+   const int N = st->filt_len;
+   int out_sample = 0;
+   int last_sample = st->last_sample[channel_index];
+   spx_uint32_t samp_frac_num = st->samp_frac_num[channel_index];
+   const spx_word16_t *sinc_table = st->sinc_table;
+   const int out_stride = st->out_stride;
+   const int int_advance = st->int_advance;
+   const int frac_advance = st->frac_advance;
+   const spx_uint32_t den_rate = st->den_rate;
+
+   while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
+   {
+      const spx_word16_t *sinct = & sinc_table[samp_frac_num*N];
+      const spx_word16_t *iptr = & in[last_sample];
+
+      out[out_stride * out_sample++] = inner_product_double_avx2(sinct, iptr, N);
+      last_sample += int_advance;
+      samp_frac_num += frac_advance;
+      if (samp_frac_num >= den_rate)
+      {
+         samp_frac_num -= den_rate;
+         last_sample++;
+      }
+   }
+
+   st->last_sample[channel_index] = last_sample;
+   st->samp_frac_num[channel_index] = samp_frac_num;
+   return out_sample;
+}
+
+/* Like resampler_basic_direct_single, but computes every channel at once from
+   a channel-interleaved buffer. Uses (and updates) the phase of channel 0,
+   which the caller guarantees is shared by all channels. */
+RESAMPLE_TARGET_AVX2
+static int resampler_interleaved_direct_single_avx2(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
+{
+   const int N = st->filt_len;
+   const spx_uint32_t C = st->nb_channels;
+   int out_sample = 0;
+   int last_sample = st->last_sample[channel_index];
+   spx_uint32_t samp_frac_num = st->samp_frac_num[channel_index];
+   const spx_word16_t *sinc_table = st->sinc_table;
+   const int int_advance = st->int_advance;
+   const int frac_advance = st->frac_advance;
+   const spx_uint32_t den_rate = st->den_rate;
+
+   while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
+   {
+      const spx_word16_t *sinct = & sinc_table[samp_frac_num*N];
+      const spx_word16_t *iptr = & in[last_sample*C];
+
+      interleaved_product_single_avx2(sinct, iptr, N, C, out + out_sample*C);
+      out_sample++;
+      last_sample += int_advance;
+      samp_frac_num += frac_advance;
+      if (samp_frac_num >= den_rate)
+      {
+         samp_frac_num -= den_rate;
+         last_sample++;
+      }
+   }
+
+   st->last_sample[channel_index] = last_sample;
+   st->samp_frac_num[channel_index] = samp_frac_num;
+   return out_sample;
+}
+
+RESAMPLE_TARGET_AVX2
+static int resampler_basic_interpolate_single_avx2(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
+{
+   const int N = st->filt_len;
+   int out_sample = 0;
+   int last_sample = st->last_sample[channel_index];
+   spx_uint32_t samp_frac_num = st->samp_frac_num[channel_index];
+   const int out_stride = st->out_stride;
+   const int int_advance = st->int_advance;
+   const int frac_advance = st->frac_advance;
+   const spx_uint32_t den_rate = st->den_rate;
+
+   while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
+   {
+      const spx_word16_t *iptr = & in[last_sample];
+      const int offset = samp_frac_num*st->oversample/st->den_rate;
+      const spx_word16_t frac = ((float)((samp_frac_num*st->oversample) % st->den_rate))/st->den_rate;
+      spx_word16_t interp[4];
+
+      cubic_coef(frac, interp);
+      out[out_stride * out_sample++] = interpolate_product_single_avx2(iptr, st->sinc_table + st->oversample + 4 - offset - 2, N, st->oversample, interp);
+      last_sample += int_advance;
+      samp_frac_num += frac_advance;
+      if (samp_frac_num >= den_rate)
+      {
+         samp_frac_num -= den_rate;
+         last_sample++;
+      }
+   }
+
+   st->last_sample[channel_index] = last_sample;
+   st->samp_frac_num[channel_index] = samp_frac_num;
+   return out_sample;
+}
+
+#ifdef RESAMPLE_AVX512
+RESAMPLE_TARGET_AVX512
+static int resampler_basic_direct_single_avx512(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
+{
+   const int N = st->filt_len;
+   int out_sample = 0;
+   int last_sample = st->last_sample[channel_index];
+   spx_uint32_t samp_frac_num = st->samp_frac_num[channel_index];
+   const spx_word16_t *sinc_table = st->sinc_table;
+   const int out_stride = st->out_stride;
+   const int int_advance = st->int_advance;
+   const int frac_advance = st->frac_advance;
+   const spx_uint32_t den_rate = st->den_rate;
+
+   while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
+   {
+      const spx_word16_t *sinct = & sinc_table[samp_frac_num*N];
+      const spx_word16_t *iptr = & in[last_sample];
+
+      out[out_stride * out_sample++] = inner_product_single_avx512(sinct, iptr, N);
+      last_sample += int_advance;
+      samp_frac_num += frac_advance;
+      if (samp_frac_num >= den_rate)
+      {
+         samp_frac_num -= den_rate;
+         last_sample++;
+      }
+   }
+
+   st->last_sample[channel_index] = last_sample;
+   st->samp_frac_num[channel_index] = samp_frac_num;
+   return out_sample;
+}
+#endif
+#endif
+
 /* This resampler is used to produce zero output in situations where memory
    for the filter could not be allocated.  The expected numbers of input and
    output samples are still processed so that callers failing to check error
@@ -602,6 +870,95 @@ static int multiply_frac(spx_uint32_t *result, spx_uint32_t value, spx_uint32_t
    return RESAMPLER_ERR_SUCCESS;
 }
 
+static void sinc_table_release(struct SincTable *entry)
+{
+   struct SincTable *prev;
+   struct SincTable *victim;
+   struct SincTable *victim_prev;
+   struct SincTable *e;
+   int idle;
+   if (!entry || --entry->refs > 0)
+      return;
+   /* Evict the least recently used idle table if there are too many */
+   idle = 0;
+   prev = victim = victim_prev = NULL;
+   for (e = sinc_cache; e; prev = e, e = e->next)
+   {
+      if (e->refs == 0)
+      {
+         idle++;
+         victim = e;
+         victim_prev = prev;
+      }
+   }
+   if (idle > SINC_CACHE_MAX_IDLE)
+   {
+      if (victim_prev)
+         victim_prev->next = victim->next;
+      else
+         sinc_cache = victim->next;
+      speex_free(victim->table);
+      speex_free(victim);
+   }
+}
+
+static struct SincTable *sinc_table_acquire(const SpeexResamplerState *st, int use_direct, spx_uint32_t length)
+{
+   struct SincTable *prev;
+   struct SincTable *e;
+   spx_uint32_t den_rate = use_direct ? st->den_rate : 0;
+   for (prev = NULL, e = sinc_cache; e; prev = e, e = e->next)
+   {
+      if (e->quality == st->quality && e->use_direct == use_direct
+          && e->den_rate == den_rate && e->filt_len == st->filt_len
+          && e->oversample == st->oversample && e->cutoff == st->cutoff)
+      {
+         if (prev)
+         {
+            prev->next = e->next;
+            e->next = sinc_cache;
+            sinc_cache = e;
+         }
+         e->refs++;
+         return e;
+      }
+   }
+
+   if (!(e = (struct SincTable *)speex_alloc(sizeof(*e))))
+      return NULL;
+   if (!(e->table = (spx_word16_t *)speex_alloc(length*sizeof(spx_word16_t))))
+   {
+      speex_free(e);
+      return NULL;
+   }
+   e->quality = st->quality;
+   e->use_direct = use_direct;
+   e->den_rate = den_rate;
+   e->filt_len = st->filt_len;
+   e->oversample = st->oversample;
+   e->cutoff = st->cutoff;
+   if (use_direct)
+   {
+      spx_uint32_t i;
+      for (i=0;i<st->den_rate;i++)
+      {
+         spx_int32_t j;
+         for (j=0;j<st->filt_len;j++)
+         {
+            e->table[i*st->filt_len+j] = sinc(st->cutoff,((j-(spx_int32_t)st->filt_len/2+1)-((float)i)/st->den_rate), st->filt_len, quality_map[st->quality].window_func);
+         }
+      }
+   } else {
+      spx_int32_t i;
+      for (i=-4;i<(spx_int32_t)(st->oversample*st->filt_len+4);i++)
+         e->table[i+4] = sinc(st->cutoff,(i/(float)st->oversample - st->filt_len/2), st->filt_len, quality_map[st->quality].window_func);
+   }
+   e->refs = 1;
+   e->next = sinc_cache;
+   sinc_cache = e;
+   return e;
+}
+
 static int update_filter(SpeexResamplerState *st)
 {
    spx_uint32_t old_length = st->filt_len;
@@ -609,16 +966,18 @@ static int update_filter(SpeexResamplerState *st)
    int use_direct;
    spx_uint32_t min_sinc_table_length;
    spx_uint32_t min_alloc_size;
+   struct SincTable *entry;
+   float bandwidth;
 
    st->int_advance = st->num_rate/st->den_rate;
    st->frac_advance = st->num_rate%st->den_rate;
    st->oversample = quality_map[st->quality].oversample;
-   st->filt_len = quality_map[st->quality].base_length;
+   quality_params(st, st->num_rate > st->den_rate, &st->filt_len, &bandwidth);
 
    if (st->num_rate > st->den_rate)
    {
       /* down-sampling */
-      st->cutoff = quality_map[st->quality].downsample_bandwidth * st->den_rate / st->num_rate;
+      st->cutoff = bandwidth * st->den_rate / st->num_rate;
       if (multiply_frac(&st->filt_len,st->filt_len,st->num_rate,st->den_rate) != RESAMPLER_ERR_SUCCESS)
          goto fail;
       /* Round up to make sure we have a multiple of 8 for SSE */
@@ -635,7 +994,7 @@ static int update_filter(SpeexResamplerState *st)
          st->oversample = 1;
    } else {
       /* up-sampling */
-      st->cutoff = quality_map[st->quality].upsample_bandwidth;
+      st->cutoff = bandwidth;
    }
 
 #ifdef RESAMPLE_FULL_SINC_TABLE
@@ -656,39 +1015,44 @@ static int update_filter(SpeexResamplerState *st)
 
       min_sinc_table_length = st->filt_len*st->oversample+8;
    }
-   if (st->sinc_table_length < min_sinc_table_length)
-   {
-      spx_word16_t *sinc_table = (spx_word16_t *)speex_realloc(st->sinc_table,min_sinc_table_length*sizeof(spx_word16_t));
-      if (!sinc_table)
-         goto fail;
-
-      st->sinc_table = sinc_table;
-      st->sinc_table_length = min_sinc_table_length;
-   }
+   entry = sinc_table_acquire(st, use_direct, min_sinc_table_length);
+   if (!entry)
+      goto fail;
+   sinc_table_release(st->sinc_entry);
+   st->sinc_entry = entry;
+   st->sinc_table = entry->table;
+   st->interleaved_ptr = NULL;
    if (use_direct)
    {
-      spx_uint32_t i;
-      for (i=0;i<st->den_rate;i++)
-      {
-         spx_int32_t j;
-         for (j=0;j<st->filt_len;j++)
-         {
-            st->sinc_table[i*st->filt_len+j] = sinc(st->cutoff,((j-(spx_int32_t)st->filt_len/2+1)-((float)i)/st->den_rate), st->filt_len, quality_map[st->quality].window_func);
-         }
-      }
 #ifdef FIXED_POINT
       st->resampler_ptr = resampler_basic_direct_single;
 #else
+#ifdef OVERRIDE_INTERLEAVED_PRODUCT_SINGLE
+      if (st->quality<=8 && st->nb_channels%4==0)
+         st->interleaved_ptr = resampler_interleaved_direct_single;
+#endif
       if (st->quality>8)
          st->resampler_ptr = resampler_basic_direct_double;
       else
          st->resampler_ptr = resampler_basic_direct_single;
+#ifdef RESAMPLE_AVX2
+      if (resample_cpu_arch() >= RESAMPLE_ARCH_AVX2)
+      {
+         if (st->quality>8)
+            st->resampler_ptr = resampler_basic_direct_double_avx2;
+         else
+            st->resampler_ptr = resampler_basic_direct_single_avx2;
+         if (st->quality<=8 && st->nb_channels>=4)
+            st->interleaved_ptr = resampler_interleaved_direct_single_avx2;
+      }
+#ifdef RESAMPLE_AVX512
+      if (resample_cpu_arch() >= RESAMPLE_ARCH_AVX512 && st->quality<=8)
+         st->resampler_ptr = resampler_basic_direct_single_avx512;
+#endif
+#endif
 #endif
       /*fprintf (stderr, "resampler uses direct sinc table and normalised cutoff %f\n", cutoff);*/
    } else {
-      spx_int32_t i;
-      for (i=-4;i<(spx_int32_t)(st->oversample*st->filt_len+4);i++)
-         st->sinc_table[i+4] = sinc(st->cutoff,(i/(float)st->oversample - st->filt_len/2), st->filt_len, quality_map[st->quality].window_func);
 #ifdef FIXED_POINT
       st->resampler_ptr = resampler_basic_interpolate_single;
 #else
@@ -696,6 +1060,10 @@ static int update_filter(SpeexResamplerState *st)
          st->resampler_ptr = resampler_basic_interpolate_double;
       else
          st->resampler_ptr = resampler_basic_interpolate_single;
+#ifdef RESAMPLE_AVX2
+      if (resample_cpu_arch() >= RESAMPLE_ARCH_AVX2 && st->quality<=8)
+         st->resampler_ptr = resampler_basic_interpolate_single_avx2;
+#endif
 #endif
       /*fprintf (stderr, "resampler uses interpolated sinc table and normalised cutoff %f\n", cutoff);*/
    }
@@ -784,6 +1152,7 @@ static int update_filter(SpeexResamplerState *st)
 
 fail:
    st->resampler_ptr = resampler_basic_zero;
+   st->interleaved_ptr = NULL;
    /* st->mem may still contain consumed input samples for the filter.
       Restore filt_len so that filt_len - 1 still points to the position after
       the last of these samples. */
@@ -821,11 +1190,16 @@ EXPORT SpeexResamplerState *speex_resampler_init_frac(spx_uint32_t nb_channels,
    st->num_rate = 0;
    st->den_rate = 0;
    st->quality = -1;
-   st->sinc_table_length = 0;
+   st->low_latency = 0;
+   st->sinc_table = NULL;
+   st->sinc_entry = NULL;
    st->mem_alloc_size = 0;
    st->filt_len = 0;
    st->mem = 0;
    st->resampler_ptr = 0;
+   st->interleaved_ptr = 0;
+   st->ibuf = 0;
+   st->ibuf_size = 0;
 
    st->cutoff = 1.f;
    st->nb_channels = nb_channels;
@@ -868,7 +1242,8 @@ fail:
 EXPORT void speex_resampler_destroy(SpeexResamplerState *st)
 {
    speex_free(st->mem);
-   speex_free(st->sinc_table);
+   speex_free(st->ibuf);
+   sinc_table_release(st->sinc_entry);
    speex_free(st->last_sample);
    speex_free(st->magic_samples);
    speex_free(st->samp_frac_num);
@@ -1035,12 +1410,99 @@ EXPORT int speex_resampler_process_int(SpeexResamplerState *st, spx_uint32_t cha
    return st->resampler_ptr == resampler_basic_zero ? RESAMPLER_ERR_ALLOC_FAILED : RESAMPLER_ERR_SUCCESS;
 }
 
+#ifndef FIXED_POINT
+/* Number of input frames copied into the interleaved work buffer at a time */
+#define INTERLEAVED_CHUNK 1024
+
+/* Returns 1 if all channels are in the same state, so that the interleaved
+   kernel can advance them together. */
+static int channels_in_phase(SpeexResamplerState *st)
+{
+   spx_uint32_t i;
+   if (!st->interleaved_ptr)
+      return 0;
+   for (i=0;i<st->nb_channels;i++)
+   {
+      if (st->magic_samples[i] || st->last_sample[i] != st->last_sample[0]
+          || st->samp_frac_num[i] != st->samp_frac_num[0])
+         return 0;
+   }
+   return 1;
+}
+
+/* Filters all channels together directly from the interleaved input. The
+   per-channel history in st->mem is gathered into an interleaved work buffer
+   in front of the input, and scattered back when done, so that the state is
+   the same as if each channel had gone through speex_resampler_process_float(). */
+static int resampler_process_interleaved_fast(SpeexResamplerState *st, const float *in, spx_uint32_t *in_len, float *out, spx_uint32_t *out_len)
+{
+   const spx_uint32_t C = st->nb_channels;
+   const spx_uint32_t hist = st->filt_len - 1;
+   spx_uint32_t ilen = *in_len;
+   spx_uint32_t olen = *out_len;
+   spx_uint32_t i, c;
+   spx_word16_t *x;
+
+   if (st->ibuf_size < (hist + INTERLEAVED_CHUNK)*C)
+   {
+      spx_word16_t *ibuf = (spx_word16_t *)speex_realloc(st->ibuf, (hist + INTERLEAVED_CHUNK)*C*sizeof(*ibuf));
+      if (!ibuf)
+         return RESAMPLER_ERR_ALLOC_FAILED;
+      st->ibuf = ibuf;
+      st->ibuf_size = (hist + INTERLEAVED_CHUNK)*C;
+   }
+   x = st->ibuf;
+   for (c=0;c<C;c++)
+      for (i=0;i<hist;i++)
+         x[i*C+c] = st->mem[c*st->mem_alloc_size+i];
+
+   st->started = 1;
+   while (ilen && olen)
+   {
+      spx_uint32_t ichunk = (ilen > INTERLEAVED_CHUNK) ? INTERLEAVED_CHUNK : ilen;
+      spx_uint32_t ochunk = olen;
+      if (in)
+         memcpy(x+hist*C, in, ichunk*C*sizeof(*x));
+      else
+         memset(x+hist*C, 0, ichunk*C*sizeof(*x));
+
+      ochunk = st->interleaved_ptr(st, 0, x, &ichunk, out, &ochunk);
+      if (st->last_sample[0] < (spx_int32_t)ichunk)
+         ichunk = st->last_sample[0];
+      st->last_sample[0] -= ichunk;
+      memmove(x, x+ichunk*C, hist*C*sizeof(*x));
+
+      ilen -= ichunk;
+      olen -= ochunk;
+      out += ochunk*C;
+      if (in)
+         in += ichunk*C;
+   }
+
+   for (c=0;c<C;c++)
+   {
+      for (i=0;i<hist;i++)
+         st->mem[c*st->mem_alloc_size+i] = x[i*C+c];
+      st->last_sample[c] = st->last_sample[0];
+      st->samp_frac_num[c] = st->samp_frac_num[0];
+   }
+   *in_len -= ilen;
+   *out_len -= olen;
+   return RESAMPLER_ERR_SUCCESS;
+}
+#endif
+
 EXPORT int speex_resampler_process_interleaved_float(SpeexResamplerState *st, const float *in, spx_uint32_t *in_len, float *out, spx_uint32_t *out_len)
 {
    spx_uint32_t i;
    int istride_save, ostride_save;
    spx_uint32_t bak_out_len = *out_len;
    spx_uint32_t bak_in_len = *in_len;
+#ifndef FIXED_POINT
+   if (channels_in_phase(st)
+       && resampler_process_interleaved_fast(st, in, in_len, out, out_len) == RESAMPLER_ERR_SUCCESS)
+      return RESAMPLER_ERR_SUCCESS;
+#endif
    istride_save = st->in_stride;
    ostride_save = st->out_stride;
    st->in_stride = st->out_stride = st->nb_channels;
@@ -1167,6 +1629,22 @@ EXPORT void speex_resampler_get_quality(SpeexResamplerState *st, int *quality)
    *quality = st->quality;
 }
 
+EXPORT int speex_resampler_set_low_latency(SpeexResamplerState *st, int enabled)
+{
+   enabled = enabled != 0;
+   if (st->low_latency == enabled)
+      return RESAMPLER_ERR_SUCCESS;
+   st->low_latency = enabled;
+   if (st->initialised)
+      return update_filter(st);
+   return RESAMPLER_ERR_SUCCESS;
+}
+
+EXPORT void speex_resampler_get_low_latency(SpeexResamplerState *st, int *enabled)
+{
+   *enabled = st->low_latency;
+}
+
 EXPORT void speex_resampler_set_input_stride(SpeexResamplerState *st, spx_uint32_t stride)
 {
    st->in_stride = stride;
@@ -1214,11 +1692,42 @@ EXPORT int speex_resampler_reset_mem(SpeexResamplerState *st)
       st->magic_samples[i] = 0;
       st->samp_frac_num[i] = 0;
    }
-   for (i=0;i<st->nb_channels*(st->filt_len-1);i++)
+   /* Each channel's history lives at a stride of mem_alloc_size */
+   for (i=0;i<st->nb_channels*st->mem_alloc_size;i++)
       st->mem[i] = 0;
    return RESAMPLER_ERR_SUCCESS;
 }
 
+EXPORT const char *speex_resampler_get_kernel_name(void)
+{
+#ifdef RESAMPLE_AVX512
+   if (resample_cpu_arch() >= RESAMPLE_ARCH_AVX512)
+      return "avx512";
+#endif
+#ifdef RESAMPLE_AVX2
+   if (resample_cpu_arch() >= RESAMPLE_ARCH_AVX2)
+      return "avx2";
+#endif
+#if defined(USE_NEON) && defined(OVERRIDE_INNER_PRODUCT_SINGLE)
+   return "neon";
+#elif defined(OVERRIDE_INNER_PRODUCT_SINGLE)
+   return "sse";
+#else
+   return "c";
+#endif
+}
+
+EXPORT int speex_resampler_limit_kernels(int level)
+{
+#ifdef RESAMPLE_AVX2
+   resample_arch_limit = level;
+   return resample_cpu_arch_supported();
+#else
+   (void)level;
+   return 0;
+#endif
+}
+
 EXPORT const char *speex_resampler_strerror(int err)
 {
    switch (err)
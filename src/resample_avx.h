@@ -0,0 +1,219 @@
+/* Copyright (C) 2026 Xiph.Org Foundation */
+/**
+   @file resample_avx.h
+   @brief Resampler functions (AVX2/FMA and AVX-512 versions)
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of the Xiph.org Foundation nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Unlike the SSE versions, these are not selected at compile time. They are
+   built with per-function target attributes and update_filter() only picks
+   them after checking cpu_features() at run time. */
+
+#include <immintrin.h>
+#include "cpusupport.h"
+
+#define RESAMPLE_AVX2
+#define RESAMPLE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+#ifdef HAVE_AVX512_TARGET
+#define RESAMPLE_AVX512
+#define RESAMPLE_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+
+#define RESAMPLE_ARCH_C      0
+#define RESAMPLE_ARCH_AVX2   1
+#define RESAMPLE_ARCH_AVX512 2
+
+/* Lowered by speex_resampler_limit_kernels(). */
+static int resample_arch_limit = RESAMPLE_ARCH_AVX512;
+
+static int resample_cpu_arch_supported(void)
+{
+   int features = cpu_features();
+#ifdef RESAMPLE_AVX512
+   if (features & CPU_FEATURE_AVX512)
+      return RESAMPLE_ARCH_AVX512;
+#endif
+   if (features & CPU_FEATURE_AVX2)
+      return RESAMPLE_ARCH_AVX2;
+   return RESAMPLE_ARCH_C;
+}
+
+static int resample_cpu_arch(void)
+{
+   int arch = resample_cpu_arch_supported();
+   return arch < resample_arch_limit ? arch : resample_arch_limit;
+}
+
+RESAMPLE_TARGET_AVX2
+static inline float hsum256_ps(__m256 v)
+{
+   __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+   sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+   sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+   return _mm_cvtss_f32(sum);
+}
+
+/* len is always a multiple of 8 (see update_filter()) */
+RESAMPLE_TARGET_AVX2
+static inline float inner_product_single_avx2(const float *a, const float *b, unsigned int len)
+{
+   unsigned int i;
+   __m256 sum0 = _mm256_setzero_ps();
+   __m256 sum1 = _mm256_setzero_ps();
+   for (i=0;i+16<=len;i+=16)
+   {
+      sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), sum0);
+      sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8), _mm256_loadu_ps(b+i+8), sum1);
+   }
+   if (i<len)
+      sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), sum0);
+   return hsum256_ps(_mm256_add_ps(sum0, sum1));
+}
+
+/* Handles two taps per iteration: a[i] against the 4 interpolation phases of
+   b+i*oversample in the low lane, a[i+1] against b+(i+1)*oversample in the
+   high lane. */
+RESAMPLE_TARGET_AVX2
+static inline float interpolate_product_single_avx2(const float *a, const float *b, unsigned int len, const spx_uint32_t oversample, float *frac)
+{
+   unsigned int i;
+   __m128 sum;
+   __m256 sum0 = _mm256_setzero_ps();
+   for (i=0;i<len;i+=2)
+   {
+      __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a[i])), _mm_set1_ps(a[i+1]), 1);
+      __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(b+i*oversample)), _mm_loadu_ps(b+(i+1)*oversample), 1);
+      sum0 = _mm256_fmadd_ps(x, y, sum0);
+   }
+   sum = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+   sum = _mm_mul_ps(_mm_loadu_ps(frac), sum);
+   sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+   sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+   return _mm_cvtss_f32(sum);
+}
+
+/* Products are rounded to single precision before being accumulated in
+   double precision, like the SSE2 version. */
+RESAMPLE_TARGET_AVX2
+static inline double inner_product_double_avx2(const float *a, const float *b, unsigned int len)
+{
+   unsigned int i;
+   __m128d sum;
+   __m256d sum0 = _mm256_setzero_pd();
+   __m256d sum1 = _mm256_setzero_pd();
+   for (i=0;i<len;i+=8)
+   {
+      __m256 t = _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i));
+      sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm256_castps256_ps128(t)));
+      sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm256_extractf128_ps(t, 1)));
+   }
+   sum0 = _mm256_add_pd(sum0, sum1);
+   sum = _mm_add_pd(_mm256_castpd256_pd128(sum0), _mm256_extractf128_pd(sum0, 1));
+   sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+   return _mm_cvtsd_f64(sum);
+}
+
+/* Same as interleaved_product_single() in resample_sse.h, with groups of
+   eight channels. Five to seven channels use a single masked group, which
+   avoids computing most of them twice. */
+RESAMPLE_TARGET_AVX2
+static inline void interleaved_product_single_avx2(const float *a, const float *x, unsigned int len, unsigned int nb_channels, float *out)
+{
+   unsigned int i, c;
+   if (nb_channels == 4)
+   {
+      __m128 sum0 = _mm_setzero_ps();
+      __m128 sum1 = _mm_setzero_ps();
+      __m128 sum2 = _mm_setzero_ps();
+      __m128 sum3 = _mm_setzero_ps();
+      for (i=0;i<len;i+=4, x+=16)
+      {
+         sum0 = _mm_fmadd_ps(_mm_broadcast_ss(a+i), _mm_loadu_ps(x), sum0);
+         sum1 = _mm_fmadd_ps(_mm_broadcast_ss(a+i+1), _mm_loadu_ps(x+4), sum1);
+         sum2 = _mm_fmadd_ps(_mm_broadcast_ss(a+i+2), _mm_loadu_ps(x+8), sum2);
+         sum3 = _mm_fmadd_ps(_mm_broadcast_ss(a+i+3), _mm_loadu_ps(x+12), sum3);
+      }
+      _mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+   }
+   else if (nb_channels < 8)
+   {
+      const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(nb_channels), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+      __m256 sum0 = _mm256_setzero_ps();
+      __m256 sum1 = _mm256_setzero_ps();
+      __m256 sum2 = _mm256_setzero_ps();
+      __m256 sum3 = _mm256_setzero_ps();
+      for (i=0;i<len;i+=4, x+=4*nb_channels)
+      {
+         sum0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i), _mm256_maskload_ps(x, mask), sum0);
+         sum1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i+1), _mm256_maskload_ps(x+nb_channels, mask), sum1);
+         sum2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i+2), _mm256_maskload_ps(x+2*nb_channels, mask), sum2);
+         sum3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i+3), _mm256_maskload_ps(x+3*nb_channels, mask), sum3);
+      }
+      _mm256_maskstore_ps(out, mask, _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+   }
+   else
+   {
+      for (c=0;c<nb_channels;c+=8)
+      {
+         const float *xp;
+         __m256 sum0 = _mm256_setzero_ps();
+         __m256 sum1 = _mm256_setzero_ps();
+         __m256 sum2 = _mm256_setzero_ps();
+         __m256 sum3 = _mm256_setzero_ps();
+         if (c+8>nb_channels)
+            c = nb_channels-8;
+         xp = x+c;
+         for (i=0;i<len;i+=4, xp+=4*nb_channels)
+         {
+            sum0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i), _mm256_loadu_ps(xp), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i+1), _mm256_loadu_ps(xp+nb_channels), sum1);
+            sum2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i+2), _mm256_loadu_ps(xp+2*nb_channels), sum2);
+            sum3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+i+3), _mm256_loadu_ps(xp+3*nb_channels), sum3);
+         }
+         _mm256_storeu_ps(out+c, _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+      }
+   }
+}
+
+#ifdef RESAMPLE_AVX512
+RESAMPLE_TARGET_AVX512
+static inline float inner_product_single_avx512(const float *a, const float *b, unsigned int len)
+{
+   unsigned int i;
+   __m512 sum0 = _mm512_setzero_ps();
+   __m256 sum1 = _mm256_setzero_ps();
+   for (i=0;i+16<=len;i+=16)
+      sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i), _mm512_loadu_ps(b+i), sum0);
+   if (i<len)
+      sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), sum1);
+   return _mm512_reduce_add_ps(sum0) + hsum256_ps(sum1);
+}
+#endif
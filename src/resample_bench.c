@@ -0,0 +1,329 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: resample_bench.c
+   Speed and accuracy table for the resampler quality levels
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Measures every resampler quality level for one conversion, so that the
+   presets offered by opusdec --resample-quality can be chosen from data.
+
+   For each quality the table shows:
+    taps      filter length in input samples
+    latency   delay added by the filter (speex_resampler_get_input_latency())
+    ripple    peak-to-peak gain variation of tones in the passband
+    stopband  worst level of anything other than the input tone (aliases,
+              images and rounding noise) for passband tones, and of tones
+              that alias back into the passband when downsampling
+    MFLOP/s   nominal multiply-adds needed per second of audio
+    speed     measured throughput as a multiple of real time */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "speex_resampler.h"
+
+#ifndef M_PI
+# define M_PI (3.14159265358979323846)
+#endif
+
+#define TONES (48)
+#define TONE_AMPLITUDE (0.5)
+#define CHUNK (960)
+
+static int low_latency = 0;
+
+static SpeexResamplerState *bench_init(int channels, int in_rate,
+  int out_rate, int quality)
+{
+  SpeexResamplerState *st;
+  int err;
+  st = speex_resampler_init(channels, in_rate, out_rate, quality, &err);
+  if (st && low_latency) speex_resampler_set_low_latency(st, 1);
+  return st;
+}
+
+typedef struct {
+  int taps;
+  int latency;
+  double ripple_db;
+  double stopband_db;
+  double mflops;
+  double speed;
+} bench_result;
+
+/* Resamples one second of a sine at freq and returns the gain of the tone
+   in dB, and the level of everything else relative to the tone input. */
+static int measure_tone(int quality, int in_rate, int out_rate, double freq,
+  double *gain_db, double *spur_db)
+{
+  SpeexResamplerState *st;
+  float *in;
+  float *out;
+  spx_uint32_t in_len;
+  spx_uint32_t out_len;
+  double w;
+  double ss=0, sc=0, cc=0, ys=0, yc=0, yy=0;
+  double a, b, det, resid;
+  int start, end;
+  int i;
+  in_len = in_rate;
+  out_len = out_rate + 1;
+  in = malloc(sizeof(*in)*in_len);
+  out = malloc(sizeof(*out)*out_len);
+  st = bench_init(1, in_rate, out_rate, quality);
+  if (!in || !out || !st) {
+    free(in);
+    free(out);
+    if (st) speex_resampler_destroy(st);
+    return -1;
+  }
+  speex_resampler_skip_zeros(st);
+  for (i=0; i<(int)in_len; i++)
+    in[i] = (float)(TONE_AMPLITUDE*sin(2*M_PI*freq*i/in_rate));
+  speex_resampler_process_float(st, 0, in, &in_len, out, &out_len);
+  speex_resampler_destroy(st);
+  /* Only look at the middle half, away from the start-up transient. */
+  start = out_len/4;
+  end = 3*out_len/4;
+  w = 2*M_PI*freq/out_rate;
+  if (freq < out_rate/2.) {
+    for (i=start; i<end; i++) {
+      double s = sin(w*i);
+      double c = cos(w*i);
+      ss += s*s;
+      sc += s*c;
+      cc += c*c;
+      ys += out[i]*s;
+      yc += out[i]*c;
+    }
+  }
+  for (i=start; i<end; i++)
+    yy += (double)out[i]*out[i];
+  /* Least squares fit of a*sin(w*i)+b*cos(w*i). */
+  det = ss*cc - sc*sc;
+  if (freq < out_rate/2. && det > 0) {
+    a = (ys*cc - yc*sc)/det;
+    b = (yc*ss - ys*sc)/det;
+  } else {
+    a = b = 0;
+  }
+  resid = yy - a*ys - b*yc;
+  if (resid < 1e-30*(end - start)) resid = 1e-30*(end - start);
+  *gain_db = 20*log10(sqrt(a*a + b*b)/TONE_AMPLITUDE + 1e-30);
+  *spur_db = 10*log10(resid/(end - start)/(TONE_AMPLITUDE*TONE_AMPLITUDE/2));
+  free(in);
+  free(out);
+  return 0;
+}
+
+static double elapsed(clock_t start)
+{
+  return (double)(clock() - start)/CLOCKS_PER_SEC;
+}
+
+static int bench_quality(int quality, int in_rate, int out_rate, int channels,
+  double seconds, double passband, bench_result *res)
+{
+  SpeexResamplerState *st;
+  float *in;
+  float *out;
+  double edge;
+  double min_gain=1e9, max_gain=-1e9, worst_spur=-1e9;
+  double gain, spur;
+  double run_time;
+  long total;
+  long done;
+  clock_t start;
+  int out_chunk;
+  int i;
+
+  st = bench_init(channels, in_rate, out_rate, quality);
+  if (!st) return -1;
+  res->latency = speex_resampler_get_input_latency(st);
+  res->taps = 2*res->latency;
+
+  edge = passband*(in_rate < out_rate ? in_rate : out_rate)/2;
+  for (i=1; i<=TONES; i++) {
+    if (measure_tone(quality, in_rate, out_rate, edge*i/TONES,
+        &gain, &spur) < 0) {
+      speex_resampler_destroy(st);
+      return -1;
+    }
+    if (gain < min_gain) min_gain = gain;
+    if (gain > max_gain) max_gain = gain;
+    if (spur > worst_spur) worst_spur = spur;
+  }
+  /* When downsampling, tones above out_rate-edge alias into the passband. */
+  if (out_rate - edge < in_rate/2.) {
+    double lo = out_rate - edge;
+    double hi = in_rate/2.;
+    for (i=0; i<TONES; i++) {
+      if (measure_tone(quality, in_rate, out_rate, lo + (hi - lo)*i/TONES,
+          &gain, &spur) < 0) {
+        speex_resampler_destroy(st);
+        return -1;
+      }
+      if (spur > worst_spur) worst_spur = spur;
+    }
+  }
+  res->ripple_db = max_gain - min_gain;
+  res->stopband_db = -worst_spur;
+  res->mflops = 2.*res->taps*out_rate*channels/1e6;
+
+  /* Speed: noise through the interleaved path in opusdec-sized chunks. */
+  out_chunk = (int)((double)CHUNK*out_rate/in_rate) + 2;
+  in = malloc(sizeof(*in)*CHUNK*channels);
+  out = malloc(sizeof(*out)*out_chunk*channels);
+  if (!in || !out) {
+    free(in);
+    free(out);
+    speex_resampler_destroy(st);
+    return -1;
+  }
+  srand(1);
+  for (i=0; i<CHUNK*channels; i++)
+    in[i] = (float)rand()/RAND_MAX - .5f;
+  total = (long)(seconds*in_rate);
+  start = clock();
+  for (done=0; done<total; done+=CHUNK) {
+    spx_uint32_t in_len = CHUNK;
+    spx_uint32_t out_len = out_chunk;
+    speex_resampler_process_interleaved_float(st, in, &in_len, out, &out_len);
+  }
+  run_time = elapsed(start);
+  res->speed = run_time > 0 ? (double)done/in_rate/run_time : 0;
+  free(in);
+  free(out);
+  speex_resampler_destroy(st);
+  return 0;
+}
+
+static void usage(void)
+{
+  printf("Usage: resample_bench [options]\n");
+  printf("Measure the speed and accuracy of every resampler quality level\n");
+  printf("\n");
+  printf("Options:\n");
+  printf(" -h, --help            Show this help\n");
+  printf(" -i, --in-rate n       Input sampling rate (default 48000)\n");
+  printf(" -o, --out-rate n      Output sampling rate (default 44100)\n");
+  printf(" -c, --channels n      Channels for the speed test (default 2)\n");
+  printf(" -q, --quality n       Only measure quality n (0-10)\n");
+  printf(" -p, --passband x      Passband edge as a fraction of the lower\n");
+  printf("                         Nyquist frequency (default 0.9)\n");
+  printf(" -s, --seconds n       Audio length for the speed test (default 20)\n");
+  printf(" -l, --low-latency     Measure the low-latency filters\n");
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  int in_rate = 48000;
+  int out_rate = 44100;
+  int channels = 2;
+  int first = 0;
+  int last = 10;
+  double passband = 0.9;
+  double seconds = 20;
+  int option;
+  int q;
+  struct option long_options[] = {
+    {"help", no_argument, NULL, 'h'},
+    {"in-rate", required_argument, NULL, 'i'},
+    {"out-rate", required_argument, NULL, 'o'},
+    {"channels", required_argument, NULL, 'c'},
+    {"quality", required_argument, NULL, 'q'},
+    {"passband", required_argument, NULL, 'p'},
+    {"seconds", required_argument, NULL, 's'},
+    {"low-latency", no_argument, NULL, 'l'},
+    {0, 0, 0, 0}
+  };
+
+  while ((option = getopt_long(argc, argv, "hi:o:c:q:p:s:l",
+            long_options, NULL)) != -1) {
+    switch (option) {
+      case 'i':
+        in_rate = atoi(optarg);
+        break;
+      case 'o':
+        out_rate = atoi(optarg);
+        break;
+      case 'c':
+        channels = atoi(optarg);
+        break;
+      case 'q':
+        first = last = atoi(optarg);
+        break;
+      case 'p':
+        passband = atof(optarg);
+        break;
+      case 's':
+        seconds = atof(optarg);
+        break;
+      case 'l':
+        low_latency = 1;
+        break;
+      case 'h':
+        usage();
+        return 0;
+      default:
+        usage();
+        return 1;
+    }
+  }
+  if (in_rate < 1 || out_rate < 1 || in_rate == out_rate || channels < 1
+      || first < 0 || last > 10 || passband <= 0 || passband >= 1
+      || seconds <= 0) {
+    fprintf(stderr, "Invalid arguments - try resample_bench --help.\n");
+    return 1;
+  }
+
+  printf("Resampling %d Hz -> %d Hz, passband 0-%.0f Hz, %d channel(s), "
+    "%s kernels%s\n\n", in_rate, out_rate,
+    passband*(in_rate < out_rate ? in_rate : out_rate)/2, channels,
+    speex_resampler_get_kernel_name(), low_latency ? ", low latency" : "");
+  printf(" Q  taps  latency(ms)  ripple(dB)  stopband(dB)  MFLOP/s    speed\n");
+  for (q=first; q<=last; q++) {
+    bench_result res;
+    if (bench_quality(q, in_rate, out_rate, channels, seconds, passband,
+        &res) < 0) {
+      fprintf(stderr, "Failed to measure quality %d.\n", q);
+      return 1;
+    }
+    printf("%2d  %4d  %11.2f  %10.4f  %12.1f  %7.1f  %6.0fx\n", q, res.taps,
+      1000.*res.latency/in_rate, res.ripple_db, res.stopband_db, res.mflops,
+      res.speed);
+    fflush(stdout);
+  }
+  return 0;
+}
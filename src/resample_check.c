@@ -0,0 +1,188 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: resample_check.c
+   Checks the AVX2/FMA and AVX-512 resampler kernels against the default ones
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Resamples the same noise with the default kernels and with each of the
+   faster ones that this CPU can run, at every quality, for conversions that
+   use the direct sinc table and ones that interpolate it, and with enough
+   channels to use the interleaved kernel, and fails if any output sample
+   differs by more than TOLERANCE. The kernels only change the order of the
+   additions, so they should agree to within rounding.
+
+   This is built without RESAMPLE_FULL_SINC_TABLE, which makes opusdec use
+   the direct table for every conversion, so that the interpolating kernels
+   are checked too. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "speex_resampler.h"
+
+#define TOLERANCE (1e-5)
+#define SECONDS (0.25)
+#define CHUNK (960)
+
+typedef struct {
+  int in_rate;
+  int out_rate;
+} conversion;
+
+/* The first ones have a small denominator and use the direct table, the
+   others interpolate it. */
+static const conversion conversions[] = {
+  {48000, 16000}, {16000, 48000}, {48000, 32000}, {8000, 48000},
+  {48000, 44100}, {44100, 48000}, {48000, 44123}, {22050, 48000}
+};
+
+#define NCONVERSIONS ((int)(sizeof(conversions)/sizeof(*conversions)))
+
+/* Four or more channels use the interleaved kernel. */
+static const int channel_counts[] = {1, 2, 6};
+
+#define NCHANNEL_COUNTS ((int)(sizeof(channel_counts)/sizeof(*channel_counts)))
+#define MAX_CHANNELS (6)
+
+static const char *level_names[] = {"default", "avx2", "avx512"};
+
+/* Resamples in to *out, which receives *out_len frames, in opusdec-sized
+   chunks. Returns -1 on failure. */
+static int resample(int level, int quality, const conversion *conv,
+  int channels, const float *in, int in_len, float **out, int *out_len)
+{
+  SpeexResamplerState *st;
+  int allocated;
+  int done = 0;
+  int produced = 0;
+  int err;
+  speex_resampler_limit_kernels(level);
+  st = speex_resampler_init(channels, conv->in_rate, conv->out_rate, quality,
+    &err);
+  if (!st) return -1;
+  allocated = (int)((double)in_len*conv->out_rate/conv->in_rate) + 2*CHUNK;
+  *out = malloc(sizeof(**out)*allocated*channels);
+  if (!*out) {
+    speex_resampler_destroy(st);
+    return -1;
+  }
+  while (done < in_len) {
+    spx_uint32_t ilen = in_len - done < CHUNK ? in_len - done : CHUNK;
+    spx_uint32_t olen = allocated - produced;
+    speex_resampler_process_interleaved_float(st, in + done*channels, &ilen,
+      *out + produced*channels, &olen);
+    done += ilen;
+    produced += olen;
+  }
+  speex_resampler_destroy(st);
+  *out_len = produced;
+  return 0;
+}
+
+int main(void)
+{
+  float *in;
+  int in_len;
+  int max_level;
+  int failures = 0;
+  int level;
+  int i;
+
+  max_level = speex_resampler_limit_kernels(0);
+  if (max_level == 0) {
+    printf("No AVX2/FMA or AVX-512 kernels on this CPU or in this build\n");
+    return EXIT_SUCCESS;
+  }
+  in_len = (int)(SECONDS*48000);
+  in = malloc(sizeof(*in)*in_len*MAX_CHANNELS);
+  if (!in) {
+    fprintf(stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  srand(1);
+  for (i=0; i<in_len*MAX_CHANNELS; i++)
+    in[i] = 2.f*rand()/RAND_MAX - 1.f;
+
+  for (level=1; level<=max_level; level++) {
+    double worst = 0;
+    int c;
+    speex_resampler_limit_kernels(level);
+    printf("Checking %s against the default kernels (%s)\n",
+      level_names[level], speex_resampler_get_kernel_name());
+    for (c=0; c<NCONVERSIONS; c++) {
+      int quality;
+      for (quality=0; quality<=10; quality++) {
+        int k;
+        for (k=0; k<NCHANNEL_COUNTS; k++) {
+          int channels = channel_counts[k];
+          float *ref;
+          float *out;
+          int ref_len;
+          int out_len;
+          double max_diff = 0;
+          int n = in_len*conversions[c].in_rate/48000;
+          if (resample(0, quality, &conversions[c], channels, in, n,
+              &ref, &ref_len) < 0
+              || resample(level, quality, &conversions[c], channels, in, n,
+              &out, &out_len) < 0) {
+            fprintf(stderr, "Cannot set up the resampler\n");
+            return EXIT_FAILURE;
+          }
+          if (out_len != ref_len) {
+            printf("  %d -> %d Hz, quality %d, %d channel(s): "
+              "%d samples instead of %d\n", conversions[c].in_rate,
+              conversions[c].out_rate, quality, channels, out_len, ref_len);
+            failures++;
+          } else {
+            for (i=0; i<out_len*channels; i++) {
+              double diff = fabs((double)out[i] - ref[i]);
+              if (diff > max_diff) max_diff = diff;
+            }
+            if (max_diff > TOLERANCE) {
+              printf("  %d -> %d Hz, quality %d, %d channel(s): "
+                "difference of %g\n", conversions[c].in_rate,
+                conversions[c].out_rate, quality, channels, max_diff);
+              failures++;
+            }
+            if (max_diff > worst) worst = max_diff;
+          }
+          free(ref);
+          free(out);
+        }
+      }
+    }
+    printf("  largest difference %g\n", worst);
+  }
+  speex_resampler_limit_kernels(max_level);
+  free(in);
+  printf("%d failed\n", failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
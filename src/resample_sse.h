@@ -71,6 +71,33 @@ static inline float interpolate_product_single(const float *a, const float *b, u
    return ret;
 }
 
+/* Computes the same product for nb_channels interleaved channels at once:
+   out[c] = sum(a[j]*x[j*nb_channels+c]), four channels per group sharing each
+   load of a[j]. nb_channels must be a multiple of 4 and len a multiple of 4,
+   which allows four independent accumulators. */
+#define OVERRIDE_INTERLEAVED_PRODUCT_SINGLE
+static inline void interleaved_product_single(const float *a, const float *x, unsigned int len, unsigned int nb_channels, float *out)
+{
+   unsigned int i, c;
+   for (c=0;c<nb_channels;c+=4)
+   {
+      const float *xp;
+      __m128 sum0 = _mm_setzero_ps();
+      __m128 sum1 = _mm_setzero_ps();
+      __m128 sum2 = _mm_setzero_ps();
+      __m128 sum3 = _mm_setzero_ps();
+      xp = x+c;
+      for (i=0;i<len;i+=4, xp+=4*nb_channels)
+      {
+         sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_load1_ps(a+i), _mm_loadu_ps(xp)));
+         sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_load1_ps(a+i+1), _mm_loadu_ps(xp+nb_channels)));
+         sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_load1_ps(a+i+2), _mm_loadu_ps(xp+2*nb_channels)));
+         sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_load1_ps(a+i+3), _mm_loadu_ps(xp+3*nb_channels)));
+      }
+      _mm_storeu_ps(out+c, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+   }
+}
+
 #ifdef __SSE2__
 #include <emmintrin.h>
 #define OVERRIDE_INNER_PRODUCT_DOUBLE
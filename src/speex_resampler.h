@@ -67,6 +67,8 @@
 #define speex_resampler_get_ratio CAT_PREFIX(RANDOM_PREFIX,_resampler_get_ratio)
 #define speex_resampler_set_quality CAT_PREFIX(RANDOM_PREFIX,_resampler_set_quality)
 #define speex_resampler_get_quality CAT_PREFIX(RANDOM_PREFIX,_resampler_get_quality)
+#define speex_resampler_set_low_latency CAT_PREFIX(RANDOM_PREFIX,_resampler_set_low_latency)
+#define speex_resampler_get_low_latency CAT_PREFIX(RANDOM_PREFIX,_resampler_get_low_latency)
 #define speex_resampler_set_input_stride CAT_PREFIX(RANDOM_PREFIX,_resampler_set_input_stride)
 #define speex_resampler_get_input_stride CAT_PREFIX(RANDOM_PREFIX,_resampler_get_input_stride)
 #define speex_resampler_set_output_stride CAT_PREFIX(RANDOM_PREFIX,_resampler_set_output_stride)
@@ -76,6 +78,8 @@
 #define speex_resampler_skip_zeros CAT_PREFIX(RANDOM_PREFIX,_resampler_skip_zeros)
 #define speex_resampler_reset_mem CAT_PREFIX(RANDOM_PREFIX,_resampler_reset_mem)
 #define speex_resampler_strerror CAT_PREFIX(RANDOM_PREFIX,_resampler_strerror)
+#define speex_resampler_get_kernel_name CAT_PREFIX(RANDOM_PREFIX,_resampler_get_kernel_name)
+#define speex_resampler_limit_kernels CAT_PREFIX(RANDOM_PREFIX,_resampler_limit_kernels)
 
 #define spx_int16_t short
 #define spx_int32_t int
@@ -277,6 +281,23 @@ int speex_resampler_set_quality(SpeexResamplerState *st,
 void speex_resampler_get_quality(SpeexResamplerState *st,
                                  int *quality);
 
+/** Select shorter filters with about half the latency. The passband is
+ * narrower than at the same quality in the normal mode, while the stopband
+ * attenuation is kept. Use speex_resampler_get_input_latency() to query the
+ * resulting delay.
+ * @param st Resampler state
+ * @param enabled Non-zero for the low-latency filters
+ */
+int speex_resampler_set_low_latency(SpeexResamplerState *st,
+                                    int enabled);
+
+/** Get whether the low-latency filters are selected.
+ * @param st Resampler state
+ * @param enabled Non-zero if the low-latency filters are selected
+ */
+void speex_resampler_get_low_latency(SpeexResamplerState *st,
+                                     int *enabled);
+
 /** Set (change) the input stride.
  * @param st Resampler state
  * @param stride Input stride
@@ -336,6 +357,19 @@ int speex_resampler_reset_mem(SpeexResamplerState *st);
  */
 const char *speex_resampler_strerror(int err);
 
+/** Returns the name of the inner product kernels selected for this CPU,
+ * e.g. "sse" or "avx2".
+ */
+const char *speex_resampler_get_kernel_name(void);
+
+/** Limits the kernels that resamplers set up from now on may use, so that
+ * they can be checked against each other: 0 for the default ones, 1 for up
+ * to AVX2/FMA and 2 for up to AVX-512. This is not thread-safe.
+ * @param level Highest kernel level to use
+ * @return Highest level that this build can use on this CPU
+ */
+int speex_resampler_limit_kernels(int level);
+
 #ifdef __cplusplus
 }
 #endif
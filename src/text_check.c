@@ -0,0 +1,326 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: text_check.c
+   Checks the vector text kernels against the C code
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Runs every variant of the UTF-8 and Base64 kernels that this CPU can run
+   on the same inputs as the C code, and fails if any gives another answer.
+   The inputs are chosen to reach every lane of the vectors: each valid and
+   invalid UTF-8 form (overlong, surrogate, above U+10FFFF, cut short, bad
+   continuation) and each byte value at every position of a block, and
+   random text. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "text_kernels.h"
+
+/* Longer than two AVX2 blocks, so that every lane of the first and last
+   blocks is reached, with room for a misaligned start. */
+#define SPAN (160)
+#define BUF_SIZE (SPAN*3 + 64)
+
+typedef struct {
+  const char *bytes;
+  int length;
+} fragment;
+
+#define FRAGMENT(s) {s, (int)sizeof(s) - 1}
+
+/* Both the forms the kernels must accept and those they must reject. */
+static const fragment fragments[] = {
+  FRAGMENT("\x7F"),
+  FRAGMENT("\xC2\x80"), FRAGMENT("\xDF\xBF"),
+  FRAGMENT("\xE0\xA0\x80"), FRAGMENT("\xE1\x80\x80"), FRAGMENT("\xED\x9F\xBF"),
+  FRAGMENT("\xEE\x80\x80"), FRAGMENT("\xEF\xBF\xBF"),
+  FRAGMENT("\xF0\x90\x80\x80"), FRAGMENT("\xF3\xBF\xBF\xBF"),
+  FRAGMENT("\xF4\x8F\xBF\xBF"),
+  /* Lone continuation bytes and bytes that never start a sequence. */
+  FRAGMENT("\x80"), FRAGMENT("\xBF"), FRAGMENT("\xF8\x88\x80\x80\x80"),
+  FRAGMENT("\xFC\x84\x80\x80\x80\x80"), FRAGMENT("\xFE"), FRAGMENT("\xFF"),
+  /* Overlong forms. */
+  FRAGMENT("\xC0\x80"), FRAGMENT("\xC1\xBF"), FRAGMENT("\xE0\x80\x80"),
+  FRAGMENT("\xE0\x9F\xBF"), FRAGMENT("\xF0\x80\x80\x80"),
+  FRAGMENT("\xF0\x8F\xBF\xBF"),
+  /* Surrogates. */
+  FRAGMENT("\xED\xA0\x80"), FRAGMENT("\xED\xAF\xBF"), FRAGMENT("\xED\xBF\xBF"),
+  /* Above U+10FFFF. */
+  FRAGMENT("\xF4\x90\x80\x80"), FRAGMENT("\xF5\x80\x80\x80"),
+  FRAGMENT("\xF7\xBF\xBF\xBF"),
+  /* Sequences cut short, or followed by something that does not continue
+     them. */
+  FRAGMENT("\xC2"), FRAGMENT("\xE1\x80"), FRAGMENT("\xF0\x90\x80"),
+  FRAGMENT("\xC2\x41"), FRAGMENT("\xE1\x80\x41"), FRAGMENT("\xE1\xC0\x80"),
+  FRAGMENT("\xF0\x90\x80\x41"), FRAGMENT("\xF0\x90\xC0\x80"),
+  FRAGMENT("\xC2\xC2\x80")
+};
+
+#define NFRAGMENTS ((int)(sizeof(fragments)/sizeof(*fragments)))
+
+/* Valid text for around the fragments: ASCII, and two and three byte
+   characters, so that a fragment also follows a multi-byte character. */
+static const fragment fillers[] = {
+  FRAGMENT("a"), FRAGMENT("\xC3\xA9"), FRAGMENT("\xE2\x82\xAC")
+};
+
+#define NFILLERS ((int)(sizeof(fillers)/sizeof(*fillers)))
+
+static const char base64_chars[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static text_kernel_table variants[TEXT_KERNEL_VARIANTS];
+static int nvariants;
+static long failures;
+static long checks;
+
+static unsigned int rng_state = 1;
+
+static unsigned int rng(void)
+{
+  rng_state = rng_state*1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static void print_bytes(const unsigned char *buf, size_t n)
+{
+  size_t i;
+  for (i=0; i<n && i<64; i++)
+    fprintf(stderr, "%02X", buf[i]);
+  if (n > 64)
+    fprintf(stderr, "...");
+  fprintf(stderr, " (%lu bytes)\n", (unsigned long)n);
+}
+
+static void check_utf8(const unsigned char *buf, size_t n)
+{
+  int expected;
+  int i;
+  expected = variants[0].utf8_valid(buf, n);
+  for (i=1; i<nvariants; i++)
+  {
+    int got = variants[i].utf8_valid(buf, n);
+    checks++;
+    if (got != expected)
+    {
+      if (failures++ < 10)
+      {
+        fprintf(stderr, "utf8_valid %s gives %d, c gives %d for ",
+          variants[i].utf8_valid_name, got, expected);
+        print_bytes(buf, n);
+      }
+    }
+  }
+}
+
+static void check_base64(const char *text, size_t n)
+{
+  size_t expected;
+  int i;
+  expected = variants[0].base64_span(text, n);
+  for (i=1; i<nvariants; i++)
+  {
+    size_t got = variants[i].base64_span(text, n);
+    checks++;
+    if (got != expected)
+    {
+      if (failures++ < 10)
+      {
+        fprintf(stderr, "base64_span %s gives %lu, c gives %lu for ",
+          variants[i].base64_span_name, (unsigned long)got,
+          (unsigned long)expected);
+        print_bytes((const unsigned char *)text, n);
+      }
+    }
+  }
+}
+
+/* Fills buf with n bytes of filler, ending on a whole character. Returns
+   the number of bytes written. */
+static int fill(unsigned char *buf, int n, const fragment *filler)
+{
+  int i;
+  for (i=0; i + filler->length <= n; i += filler->length)
+    memcpy(buf + i, filler->bytes, filler->length);
+  for (; i<n; i++)
+    buf[i] = 'a';
+  return n;
+}
+
+/* Every fragment at every position, with the text ending right after it,
+   one byte later, and one block later, and cut at every byte of it. */
+static void check_fragments(unsigned char *base)
+{
+  static const int tails[] = {0, 1, 31, 64};
+  int f, k, t, pos, align, cut;
+  for (f=0; f<NFRAGMENTS; f++)
+  {
+    const fragment *frag = &fragments[f];
+    for (k=0; k<NFILLERS; k++)
+    {
+      for (pos=0; pos<SPAN; pos++)
+      {
+        unsigned char *buf;
+        align = pos & 31;
+        buf = base + align;
+        fill(buf, pos, &fillers[k]);
+        memcpy(buf + pos, frag->bytes, frag->length);
+        for (t=0; t<(int)(sizeof(tails)/sizeof(*tails)); t++)
+        {
+          fill(buf + pos + frag->length, tails[t], &fillers[k]);
+          check_utf8(buf, pos + frag->length + tails[t]);
+        }
+        for (cut=1; cut<frag->length; cut++)
+          check_utf8(buf, pos + cut);
+      }
+    }
+  }
+}
+
+/* Every byte value at every position of Base64 text, which also puts bytes
+   of 0x80 and above in every lane. */
+static void check_base64_bytes(char *base)
+{
+  int c, pos, n, align;
+  for (c=0; c<256; c++)
+  {
+    for (pos=0; pos<SPAN; pos++)
+    {
+      char *buf;
+      align = (pos + c) & 31;
+      buf = base + align;
+      for (n=0; n<SPAN; n++)
+        buf[n] = base64_chars[(n*7 + c) & 63];
+      buf[pos] = (char)c;
+      check_base64(buf, SPAN);
+      check_base64(buf, pos + 1);
+      check_base64(buf, pos);
+    }
+  }
+}
+
+/* Random bytes, random valid UTF-8 with a byte changed now and then, and
+   random Base64 text with a character changed. */
+static void check_random(unsigned char *buf, int rounds)
+{
+  int r;
+  for (r=0; r<rounds; r++)
+  {
+    int n = rng() % (BUF_SIZE - 64);
+    int align = rng() & 31;
+    unsigned char *p = buf + align;
+    int i;
+    switch (r % 3)
+    {
+      case 0:
+        for (i=0; i<n; i++)
+          p[i] = (unsigned char)rng();
+        break;
+      case 1:
+        for (i=0; i<n; )
+        {
+          unsigned int cp;
+          unsigned int kind = rng() % 8;
+          /* Mostly ASCII, as in real comments. */
+          if (kind < 4) cp = rng() % 0x80;
+          else if (kind < 5) cp = 0x80 + rng() % 0x780;
+          else if (kind < 7) cp = 0x800 + rng() % 0xF800;
+          else cp = 0x10000 + rng() % 0x100000;
+          if (cp >= 0xD800 && cp < 0xE000) cp = 'x';
+          if (cp < 0x80 && i + 1 <= n)
+            p[i++] = (unsigned char)cp;
+          else if (cp < 0x800 && i + 2 <= n)
+          {
+            p[i++] = (unsigned char)(0xC0 | cp >> 6);
+            p[i++] = (unsigned char)(0x80 | (cp & 0x3F));
+          }
+          else if (cp >= 0x800 && cp < 0x10000 && i + 3 <= n)
+          {
+            p[i++] = (unsigned char)(0xE0 | cp >> 12);
+            p[i++] = (unsigned char)(0x80 | (cp >> 6 & 0x3F));
+            p[i++] = (unsigned char)(0x80 | (cp & 0x3F));
+          }
+          else if (cp >= 0x10000 && i + 4 <= n)
+          {
+            p[i++] = (unsigned char)(0xF0 | cp >> 18);
+            p[i++] = (unsigned char)(0x80 | (cp >> 12 & 0x3F));
+            p[i++] = (unsigned char)(0x80 | (cp >> 6 & 0x3F));
+            p[i++] = (unsigned char)(0x80 | (cp & 0x3F));
+          }
+          else
+            p[i++] = 'a';
+        }
+        if (n > 0 && rng() % 2)
+          p[rng() % n] = (unsigned char)rng();
+        break;
+      default:
+        for (i=0; i<n; i++)
+          p[i] = base64_chars[rng() & 63];
+        if (n > 0 && rng() % 2)
+          p[rng() % n] = (unsigned char)rng();
+        break;
+    }
+    check_utf8(p, n);
+    check_base64((const char *)p, n);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned char *buf;
+  int rounds = 100000;
+  int i;
+  if (argc > 1)
+  {
+    rounds = atoi(argv[1]);
+    if (rounds < 0)
+    {
+      fprintf(stderr, "Usage: text_check [random rounds]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  buf = malloc(BUF_SIZE);
+  if (!buf)
+  {
+    fprintf(stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  nvariants = text_kernel_variants(variants, TEXT_KERNEL_VARIANTS);
+  printf("Checking against c:");
+  for (i=1; i<nvariants; i++)
+    printf(" %s", variants[i].utf8_valid_name);
+  printf("%s\n", nvariants > 1 ? "" : " (no other variants)");
+  check_fragments(buf);
+  check_base64_bytes((char *)buf);
+  check_random(buf, rounds);
+  free(buf);
+  printf("%ld checks, %ld failed\n", checks, failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: text_kernels.c
+   Base64 and UTF-8 scanning kernels with run-time dispatch
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "text_kernels.h"
+#include "cpusupport.h"
+
+/* Long comments, and the Base64 text of pictures, are almost all ASCII, so
+   the vector variants check whole blocks at once and leave anything else to
+   the C code one character at a time. See pcm_kernels.c for the targets. */
+#if defined(HAVE_AVX2_TARGET)
+# include <immintrin.h>
+# define TEXT_SSE2
+# define TEXT_AVX2
+# define TEXT_TARGET_SSE2 __attribute__((target("sse2")))
+# define TEXT_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define TEXT_SSE2
+# define TEXT_TARGET_SSE2
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+# define TEXT_NEON
+#endif
+
+/* Returns the length of the UTF-8 sequence at buf, with n bytes left, or 0
+   if it is not valid. */
+static size_t utf8_sequence(const unsigned char *buf, size_t n)
+{
+  int c;
+  c = buf[0];
+  if (c<0x80) return 1;
+  /* C0 and C1 could only start overlong forms. */
+  if (c<0xC2||c>0xF4) return 0;
+  if (c<0xE0)
+    return n>=2&&(buf[1]&0xC0)==0x80 ? 2 : 0;
+  if (c<0xF0)
+  {
+    if (n<3||(buf[1]&0xC0)!=0x80||(buf[2]&0xC0)!=0x80) return 0;
+    if (c==0xE0&&buf[1]<0xA0) return 0;
+    if (c==0xED&&buf[1]>0x9F) return 0;
+    return 3;
+  }
+  if (n<4||(buf[1]&0xC0)!=0x80||(buf[2]&0xC0)!=0x80||(buf[3]&0xC0)!=0x80)
+    return 0;
+  if (c==0xF0&&buf[1]<0x90) return 0;
+  if (c==0xF4&&buf[1]>0x8F) return 0;
+  return 4;
+}
+
+static int utf8_valid_c(const unsigned char *buf, size_t n)
+{
+  size_t i;
+  for (i=0;i<n;)
+  {
+    size_t len;
+    len = utf8_sequence(buf+i, n-i);
+    if (!len) return 0;
+    i += len;
+  }
+  return 1;
+}
+
+static int is_base64_char(int c)
+{
+  return (c>='A'&&c<='Z')||(c>='a'&&c<='z')||(c>='0'&&c<='9')
+   ||c=='+'||c=='/';
+}
+
+static size_t base64_span_c(const char *text, size_t n)
+{
+  size_t i;
+  for (i=0;i<n&&is_base64_char((unsigned char)text[i]);i++);
+  return i;
+}
+
+#ifdef TEXT_SSE2
+TEXT_TARGET_SSE2
+static int utf8_valid_sse2(const unsigned char *buf, size_t n)
+{
+  size_t i;
+  for (i=0;i<n;)
+  {
+    size_t len;
+    while (n-i>=16
+     &&_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(buf+i)))==0)
+      i += 16;
+    /* The rest of a block with a non-ASCII byte is done in C, and so is the
+       tail. */
+    while (i<n&&buf[i]<0x80) i++;
+    if (i>=n) break;
+    len = utf8_sequence(buf+i, n-i);
+    if (!len) return 0;
+    i += len;
+  }
+  return 1;
+}
+
+/* Byte compares are signed, so bytes from 0x80 up fail every range. */
+TEXT_TARGET_SSE2
+static size_t base64_span_sse2(const char *text, size_t n)
+{
+  size_t i;
+  for (i=0;i+16<=n;i+=16)
+  {
+    __m128i v, upper, lower, digit, plus, slash, ok;
+    v = _mm_loadu_si128((const __m128i *)(text+i));
+    upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A'-1)),
+     _mm_cmplt_epi8(v, _mm_set1_epi8('Z'+1)));
+    lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a'-1)),
+     _mm_cmplt_epi8(v, _mm_set1_epi8('z'+1)));
+    digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0'-1)),
+     _mm_cmplt_epi8(v, _mm_set1_epi8('9'+1)));
+    plus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+    slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+    ok = _mm_or_si128(_mm_or_si128(upper, lower),
+     _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+    if (_mm_movemask_epi8(ok)!=0xFFFF) break;
+  }
+  return i+base64_span_c(text+i, n-i);
+}
+#endif
+
+#ifdef TEXT_AVX2
+TEXT_TARGET_AVX2
+static int utf8_valid_avx2(const unsigned char *buf, size_t n)
+{
+  size_t i;
+  for (i=0;i<n;)
+  {
+    size_t len;
+    while (n-i>=32
+     &&_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(buf+i)))==0)
+      i += 32;
+    while (i<n&&buf[i]<0x80) i++;
+    if (i>=n) break;
+    len = utf8_sequence(buf+i, n-i);
+    if (!len) return 0;
+    i += len;
+  }
+  return 1;
+}
+
+TEXT_TARGET_AVX2
+static size_t base64_span_avx2(const char *text, size_t n)
+{
+  size_t i;
+  for (i=0;i+32<=n;i+=32)
+  {
+    __m256i v, upper, lower, digit, plus, slash, ok;
+    v = _mm256_loadu_si256((const __m256i *)(text+i));
+    upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A'-1)),
+     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z'+1), v));
+    lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('a'-1)),
+     _mm256_cmpgt_epi8(_mm256_set1_epi8('z'+1), v));
+    digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0'-1)),
+     _mm256_cmpgt_epi8(_mm256_set1_epi8('9'+1), v));
+    plus = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+'));
+    slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+    ok = _mm256_or_si256(_mm256_or_si256(upper, lower),
+     _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+    if (_mm256_movemask_epi8(ok)!=-1) break;
+  }
+  return i+base64_span_c(text+i, n-i);
+}
+#endif
+
+#ifdef TEXT_NEON
+static int utf8_valid_neon(const unsigned char *buf, size_t n)
+{
+  size_t i;
+  for (i=0;i<n;)
+  {
+    size_t len;
+    while (n-i>=16&&vmaxvq_u8(vld1q_u8(buf+i))<0x80) i += 16;
+    while (i<n&&buf[i]<0x80) i++;
+    if (i>=n) break;
+    len = utf8_sequence(buf+i, n-i);
+    if (!len) return 0;
+    i += len;
+  }
+  return 1;
+}
+
+static size_t base64_span_neon(const char *text, size_t n)
+{
+  size_t i;
+  for (i=0;i+16<=n;i+=16)
+  {
+    uint8x16_t v, ok;
+    v = vld1q_u8((const unsigned char *)text+i);
+    ok = vandq_u8(vcgeq_u8(v, vdupq_n_u8('A')), vcleq_u8(v, vdupq_n_u8('Z')));
+    ok = vorrq_u8(ok,
+     vandq_u8(vcgeq_u8(v, vdupq_n_u8('a')), vcleq_u8(v, vdupq_n_u8('z'))));
+    ok = vorrq_u8(ok,
+     vandq_u8(vcgeq_u8(v, vdupq_n_u8('0')), vcleq_u8(v, vdupq_n_u8('9'))));
+    ok = vorrq_u8(ok, vceqq_u8(v, vdupq_n_u8('+')));
+    ok = vorrq_u8(ok, vceqq_u8(v, vdupq_n_u8('/')));
+    if (vminvq_u8(ok)!=0xFF) break;
+  }
+  return i+base64_span_c(text+i, n-i);
+}
+#endif
+
+static void add_variant(text_kernel_table *tables, int max, int *count,
+  utf8_valid_func utf8_valid, base64_span_func base64_span, const char *name)
+{
+  if (*count < max)
+  {
+    tables[*count].utf8_valid = utf8_valid;
+    tables[*count].utf8_valid_name = name;
+    tables[*count].base64_span = base64_span;
+    tables[*count].base64_span_name = name;
+  }
+  (*count)++;
+}
+
+int text_kernel_variants(text_kernel_table *tables, int max)
+{
+  int features;
+  int count = 0;
+  features = cpu_features();
+  (void)features;
+  add_variant(tables, max, &count, utf8_valid_c, base64_span_c, "c");
+#ifdef TEXT_SSE2
+  if (features & CPU_FEATURE_SSE2)
+    add_variant(tables, max, &count, utf8_valid_sse2, base64_span_sse2,
+      "sse2");
+#endif
+#ifdef TEXT_AVX2
+  if (features & CPU_FEATURE_AVX2)
+    add_variant(tables, max, &count, utf8_valid_avx2, base64_span_avx2,
+      "avx2");
+#endif
+#ifdef TEXT_NEON
+  if (features & CPU_FEATURE_NEON)
+    add_variant(tables, max, &count, utf8_valid_neon, base64_span_neon,
+      "neon");
+#endif
+  return count < max ? count : max;
+}
+
+static text_kernel_table text_kernel_tab;
+
+const text_kernel_table *text_kernels(void)
+{
+  static int initialized = 0;
+  if (!initialized)
+  {
+    text_kernel_table tables[TEXT_KERNEL_VARIANTS];
+    int count;
+    /* The last variant is the fastest. */
+    count = text_kernel_variants(tables, TEXT_KERNEL_VARIANTS);
+    text_kernel_tab = tables[count - 1];
+    initialized = 1;
+  }
+  return &text_kernel_tab;
+}
+
+void text_kernels_print_info(FILE *file)
+{
+  const text_kernel_table *k;
+  k = text_kernels();
+  fprintf(file, "  UTF-8 check:     %s\n", k->utf8_valid_name);
+  fprintf(file, "  Base64 check:    %s\n", k->base64_span_name);
+}
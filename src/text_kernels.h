@@ -0,0 +1,66 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: text_kernels.h
+   Base64 and UTF-8 scanning kernels with run-time dispatch
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OPUSTOOLS_TEXT_KERNELS_H
+#define OPUSTOOLS_TEXT_KERNELS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Returns 1 if the n bytes are valid UTF-8: no overlong forms, surrogates,
+   or code points above U+10FFFF, and no sequence cut short at the end. */
+typedef int (*utf8_valid_func)(const unsigned char *buf, size_t n);
+
+/* Returns the number of leading characters of text, up to n, that are in
+   the Base64 alphabet (A-Z, a-z, 0-9, '+' and '/', but not '='). */
+typedef size_t (*base64_span_func)(const char *text, size_t n);
+
+typedef struct {
+   utf8_valid_func utf8_valid;
+   base64_span_func base64_span;
+   const char *utf8_valid_name;
+   const char *base64_span_name;
+} text_kernel_table;
+
+/* Returns the variants selected for this CPU (see cpu_features()). The table
+   is filled on first use, which must happen before any threads are started. */
+const text_kernel_table *text_kernels(void);
+
+/* The most variants a build can have. */
+#define TEXT_KERNEL_VARIANTS (4)
+
+/* Fills tables with every variant built in that this CPU can run, the C
+   code first, and returns how many there are, up to max. This is for
+   checking the variants against each other; text_kernels() picks the last
+   one. */
+int text_kernel_variants(text_kernel_table *tables, int max);
+
+/* Prints which variant of each kernel was selected. */
+void text_kernels_print_info(FILE *file);
+
+#endif
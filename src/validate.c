@@ -0,0 +1,387 @@
+/* Copyright (C)2026 Xiph.Org Foundation
+   File: validate.c
+   Decode-only validation of Opus files (opusdec --validate)
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+
+#include <opusfile.h>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#if defined WIN32 || defined _WIN32
+# include <io.h>
+# include <fcntl.h>
+#endif
+
+#include "validate.h"
+#include "file_reader.h"
+
+/* printf format specifier for ogg_int64_t */
+#if defined PRId64
+# define I64FORMAT PRId64
+#elif defined WIN32 || defined _WIN32
+# define I64FORMAT "I64d"
+#else
+# define I64FORMAT "lld"
+#endif
+
+/* One 120 ms packet of 8 channels; opusfile buffers larger packets itself. */
+#define VALIDATE_BUF_SIZE (5760*8)
+
+typedef struct {
+   int finished;
+   int open_error;
+   int holes;
+   int bad_packets;
+   int read_error;
+   int links;
+   ogg_int64_t samples;
+   /* First link whose length disagrees with its granule positions. */
+   int bad_link;
+   ogg_int64_t bad_link_decoded;
+   ogg_int64_t bad_link_expected;
+} validate_result;
+
+static int reader_read(void *stream, unsigned char *ptr, int nbytes)
+{
+   return (int)file_reader_read((file_reader *)stream, ptr, nbytes);
+}
+
+static int reader_seek(void *stream, opus_int64 offset, int whence)
+{
+   return file_reader_seek((file_reader *)stream, offset, whence) < 0 ? -1 : 0;
+}
+
+static opus_int64 reader_tell(void *stream)
+{
+   return file_reader_tell((file_reader *)stream);
+}
+
+static int reader_close(void *stream)
+{
+   file_reader_close((file_reader *)stream);
+   return 0;
+}
+
+static const OpusFileCallbacks reader_callbacks = {
+   reader_read, reader_seek, reader_tell, reader_close
+};
+
+/* Files are read through ring, the io_uring of the calling thread, which
+   may be NULL. */
+static OggOpusFile *validate_open(const char *path, file_ring *ring,
+   int *error)
+{
+   OggOpusFile *of;
+   file_reader *r;
+   if (strcmp(path, "-") == 0)
+   {
+      OpusFileCallbacks cb = {NULL, NULL, NULL, NULL};
+      int fd;
+#if defined WIN32 || defined _WIN32
+      fd = _fileno(stdin);
+      _setmode(fd, _O_BINARY);
+#else
+      fd = fileno(stdin);
+#endif
+      return op_open_callbacks(op_fdopen(&cb, fd, "rb"), &cb, NULL, 0, error);
+   }
+   of = op_open_url(path, NULL, NULL);
+   if (of != NULL) return of;
+   r = file_reader_open(path, ring);
+   if (r == NULL)
+   {
+      *error = OP_EFAULT;
+      return NULL;
+   }
+   /* The stream is only closed by op_free() once it has been opened. */
+   of = op_open_callbacks(r, &reader_callbacks, NULL, 0, error);
+   if (of == NULL) file_reader_close(r);
+   return of;
+}
+
+/* Compares the samples decoded from a link with the length its granule
+   positions give, when that is known. */
+static void validate_link(OggOpusFile *of, int li, ogg_int64_t decoded,
+   validate_result *res)
+{
+   ogg_int64_t expected;
+   if (!op_seekable(of) || res->bad_link >= 0) return;
+   expected = op_pcm_total(of, li);
+   if (expected >= 0 && expected != decoded)
+   {
+      res->bad_link = li;
+      res->bad_link_decoded = decoded;
+      res->bad_link_expected = expected;
+   }
+}
+
+static void validate_file(const char *path, float *buf, file_ring *ring,
+   validate_result *res)
+{
+   OggOpusFile *of;
+   ogg_int64_t link_samples;
+   int old_li;
+   int error;
+   memset(res, 0, sizeof(*res));
+   res->bad_link = -1;
+   error = 0;
+   of = validate_open(path, ring, &error);
+   if (of == NULL)
+   {
+      res->open_error = error ? error : OP_EFAULT;
+      return;
+   }
+   link_samples = 0;
+   old_li = -1;
+   for (;;)
+   {
+      int li;
+      int ret;
+      ret = op_read_float(of, buf, VALIDATE_BUF_SIZE, &li);
+      if (ret == OP_HOLE)
+      {
+         res->holes++;
+         continue;
+      }
+      /* The packet that failed was consumed, so decoding can go on. */
+      if (ret == OP_EBADPACKET)
+      {
+         res->bad_packets++;
+         continue;
+      }
+      if (ret < 0)
+      {
+         res->read_error = ret;
+         break;
+      }
+      if (ret == 0) break;
+      if (li != old_li)
+      {
+         if (old_li >= 0) validate_link(of, old_li, link_samples, res);
+         link_samples = 0;
+         old_li = li;
+         res->links++;
+      }
+      link_samples += ret;
+      res->samples += ret;
+   }
+   if (old_li >= 0 && !res->read_error)
+      validate_link(of, old_li, link_samples, res);
+   op_free(of);
+}
+
+static int validate_failed(const validate_result *res)
+{
+   return res->open_error || res->holes || res->bad_packets
+      || res->read_error || res->bad_link >= 0;
+}
+
+static void validate_print(const char *path, const validate_result *res,
+   int quiet)
+{
+   ogg_int64_t ms;
+   if (res->open_error)
+   {
+      printf("%s: FAILED: cannot open (error %d)\n", path, res->open_error);
+      return;
+   }
+   if (!validate_failed(res))
+   {
+      if (quiet) return;
+      ms = res->samples/48;
+      printf("%s: OK, %d %s, %ld:%02d.%03d\n", path, res->links,
+         res->links == 1 ? "link" : "links", (long)(ms/60000),
+         (int)(ms/1000%60), (int)(ms%1000));
+      return;
+   }
+   printf("%s: FAILED:", path);
+   if (res->holes) printf(" %d %s;", res->holes,
+      res->holes == 1 ? "hole" : "holes");
+   if (res->bad_packets) printf(" %d bad %s;", res->bad_packets,
+      res->bad_packets == 1 ? "packet" : "packets");
+   if (res->read_error) printf(" read error %d;", res->read_error);
+   if (res->bad_link >= 0)
+   {
+      printf(" link %d decoded to %" I64FORMAT " samples but its granule"
+         " positions give %" I64FORMAT ";", res->bad_link,
+         (ogg_int64_t)res->bad_link_decoded,
+         (ogg_int64_t)res->bad_link_expected);
+   }
+   ms = res->samples/48;
+   printf(" %ld:%02d.%03d decoded\n", (long)(ms/60000), (int)(ms/1000%60),
+      (int)(ms%1000));
+}
+
+#ifdef HAVE_PTHREAD
+typedef struct {
+   char **paths;
+   int npaths;
+   validate_result *results;
+   int next;
+   pthread_mutex_t lock;
+   pthread_cond_t finished;
+} validate_queue;
+
+static void *validate_worker(void *arg)
+{
+   validate_queue *queue = (validate_queue *)arg;
+   file_ring *ring;
+   float *buf;
+   buf = malloc(sizeof(*buf)*VALIDATE_BUF_SIZE);
+   ring = file_ring_create();
+   for (;;)
+   {
+      validate_result res;
+      int i;
+      pthread_mutex_lock(&queue->lock);
+      i = queue->next++;
+      pthread_mutex_unlock(&queue->lock);
+      if (i >= queue->npaths) break;
+      if (buf) validate_file(queue->paths[i], buf, ring, &res);
+      else
+      {
+         memset(&res, 0, sizeof(res));
+         res.open_error = OP_EFAULT;
+      }
+      res.finished = 1;
+      pthread_mutex_lock(&queue->lock);
+      queue->results[i] = res;
+      pthread_cond_broadcast(&queue->finished);
+      pthread_mutex_unlock(&queue->lock);
+   }
+   file_ring_destroy(ring);
+   free(buf);
+   return NULL;
+}
+
+/* Returns the number of failed files, or -1 if no thread could be
+   started. */
+static int validate_parallel(char **paths, int npaths, int jobs, int quiet)
+{
+   validate_queue queue;
+   pthread_t *threads;
+   int nthreads;
+   int failed;
+   int i;
+   queue.paths = paths;
+   queue.npaths = npaths;
+   queue.next = 0;
+   queue.results = calloc(npaths, sizeof(*queue.results));
+   threads = malloc(sizeof(*threads)*jobs);
+   if (!queue.results || !threads)
+   {
+      free(queue.results);
+      free(threads);
+      return -1;
+   }
+   pthread_mutex_init(&queue.lock, NULL);
+   pthread_cond_init(&queue.finished, NULL);
+   for (nthreads = 0; nthreads < jobs; nthreads++)
+   {
+      if (pthread_create(&threads[nthreads], NULL, validate_worker,
+            &queue) != 0)
+         break;
+   }
+   failed = -1;
+   if (nthreads > 0)
+   {
+      /* Report in input order while later files are still being checked. */
+      failed = 0;
+      for (i = 0; i < npaths; i++)
+      {
+         validate_result res;
+         pthread_mutex_lock(&queue.lock);
+         while (!queue.results[i].finished)
+            pthread_cond_wait(&queue.finished, &queue.lock);
+         res = queue.results[i];
+         pthread_mutex_unlock(&queue.lock);
+         validate_print(paths[i], &res, quiet);
+         fflush(stdout);
+         if (validate_failed(&res)) failed++;
+      }
+      for (i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+   }
+   pthread_mutex_destroy(&queue.lock);
+   pthread_cond_destroy(&queue.finished);
+   free(queue.results);
+   free(threads);
+   return failed;
+}
+#endif
+
+int validate_files(char **paths, int npaths, int jobs, int quiet)
+{
+   file_ring *ring;
+   float *buf;
+   int failed;
+   int i;
+   if (jobs > npaths) jobs = npaths;
+#ifdef HAVE_PTHREAD
+   if (jobs > 1)
+   {
+      failed = validate_parallel(paths, npaths, jobs, quiet);
+      if (failed >= 0) return failed;
+      fprintf(stderr, "Warning: Cannot start validation threads;"
+         " checking files in turn.\n");
+   }
+#else
+   if (jobs > 1)
+      fprintf(stderr, "Warning: Built without thread support;"
+         " checking files in turn.\n");
+#endif
+   buf = malloc(sizeof(*buf)*VALIDATE_BUF_SIZE);
+   if (!buf)
+   {
+      fprintf(stderr, "Memory allocation failure.\n");
+      return npaths;
+   }
+   ring = file_ring_create();
+   failed = 0;
+   for (i = 0; i < npaths; i++)
+   {
+      validate_result res;
+      validate_file(paths[i], buf, ring, &res);
+      validate_print(paths[i], &res, quiet);
+      fflush(stdout);
+      if (validate_failed(&res)) failed++;
+   }
+   file_ring_destroy(ring);
+   free(buf);
+   return failed;
+}
@@ -31,7 +31,15 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#if defined(HAVE_PWRITE)
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 #include "wav_io.h"
 #include "opus_header.h"
 
@@ -70,10 +78,15 @@ static size_t fwrite_le16(int i16, FILE *file)
    return fwrite(buf,2,1,file);
 }
 
-int write_wav_header(FILE *file, int rate, int mapping_family, int channels, int fp)
+/* audio_size is the length of the data chunk in bytes, or -1 if it is not yet
+   known, in which case the size fields are left for update_wav_header(). */
+int write_wav_header(FILE *file, int rate, int mapping_family, int channels, int fp,
+      opus_int64 audio_size)
 {
    int ret;
    int extensible;
+   opus_uint32 riff_size;
+   opus_uint32 data_size;
 
    /* Multichannel files require a WAVEFORMATEXTENSIBLE header to declare the
       proper channel meanings. */
@@ -82,8 +95,16 @@ int write_wav_header(FILE *file, int rate, int mapping_family, int channels, int
    /* >16 bit audio also requires WAVEFORMATEXTENSIBLE. */
    extensible |= fp;
 
+   riff_size = data_size = 0xffffffff;
+   if (audio_size >= 0 && audio_size < (opus_int64)0xffffffffU)
+   {
+      data_size = (opus_uint32)audio_size;
+      if (audio_size < (opus_int64)0xffffffffU - 20 - (extensible ? 40 : 16))
+         riff_size = (opus_uint32)(audio_size + 20 + (extensible ? 40 : 16));
+   }
+
    ret = fprintf(file, "RIFF") >= 0;
-   ret &= fwrite_le32(0xffffffff, file);
+   ret &= fwrite_le32(riff_size, file);
 
    ret &= fprintf(file, "WAVEfmt ") >= 0;
    ret &= fwrite_le32(extensible ? 40 : 16, file);
@@ -135,7 +156,7 @@ int write_wav_header(FILE *file, int rate, int mapping_family, int channels, int
    }
 
    ret &= fprintf(file, "data") >= 0;
-   ret &= fwrite_le32(0xffffffff, file);
+   ret &= fwrite_le32(data_size, file);
 
    return !ret ? -1 : extensible ? 40 : 16;
 }
@@ -162,3 +183,226 @@ int update_wav_header(FILE *file, int format, opus_int64 audio_size)
    }
    return 0;
 }
+
+/* Returns 1 if positioned output is set up, 0 if the caller should fall back
+   to plain fwrite() (not a regular file, or no pwrite()), and -1 on error.
+   The header must already have been written through file. */
+int pcm_prealloc_init(pcm_prealloc *pa, FILE *file, int format,
+      opus_int64 audio_size)
+{
+#if defined(HAVE_PWRITE)
+   struct stat st;
+   pa->fd = -1;
+   if (audio_size < 0) return 0;
+   if (fflush(file) != 0) return -1;
+   pa->fd = fileno(file);
+   if (pa->fd < 0 || fstat(pa->fd, &st) != 0 || !S_ISREG(st.st_mode))
+   {
+      pa->fd = -1;
+      return 0;
+   }
+   /* WAV data starts after the RIFF, fmt and data chunk headers. */
+   pa->data_offset = format > 0 ? 28 + format : 0;
+   pa->reserved = audio_size;
+   pa->pos = 0;
+   if ((opus_int64)(off_t)(pa->data_offset + audio_size)
+         != pa->data_offset + audio_size)
+   {
+      pa->fd = -1;
+      return 0;
+   }
+   if (audio_size > 0)
+   {
+# if defined(HAVE_POSIX_FALLOCATE)
+      int err;
+      err = posix_fallocate(pa->fd, (off_t)pa->data_offset, (off_t)audio_size);
+      /* Some filesystems cannot reserve blocks; extending the file still
+         lets the writes land at their final offsets. */
+      if (err != 0 && err != EINVAL && err != EOPNOTSUPP) return -1;
+      if (err != 0
+            && ftruncate(pa->fd, (off_t)(pa->data_offset + audio_size)) != 0)
+         return -1;
+# else
+      if (ftruncate(pa->fd, (off_t)(pa->data_offset + audio_size)) != 0)
+         return -1;
+# endif
+   }
+   return 1;
+#else
+   (void)file;
+   (void)format;
+   (void)audio_size;
+   pa->fd = -1;
+   return 0;
+#endif
+}
+
+/* Same contract as fwrite(): returns the number of complete items written. */
+size_t pcm_prealloc_write(pcm_prealloc *pa, const void *ptr, size_t size,
+      size_t nmemb)
+{
+#if defined(HAVE_PWRITE)
+   const unsigned char *buf;
+   size_t left;
+   size_t done;
+   buf = (const unsigned char *)ptr;
+   left = size*nmemb;
+   done = 0;
+   while (left > 0)
+   {
+      ssize_t ret;
+      ret = pwrite(pa->fd, buf + done, left, (off_t)(pa->data_offset + pa->pos));
+      if (ret < 0)
+      {
+         if (errno == EINTR) continue;
+         break;
+      }
+      if (ret == 0) break;
+      done += ret;
+      left -= ret;
+      pa->pos += ret;
+   }
+   return size ? done/size : 0;
+#else
+   (void)pa;
+   (void)ptr;
+   (void)size;
+   (void)nmemb;
+   return 0;
+#endif
+}
+
+/* Trims the reservation and rewrites the header sizes if the decoded length
+   turned out to differ from the one given to pcm_prealloc_init(). */
+int pcm_prealloc_finish(pcm_prealloc *pa, FILE *file, int format,
+      opus_int64 audio_size)
+{
+#if defined(HAVE_PWRITE)
+   if (pa->fd < 0 || audio_size == pa->reserved) return 0;
+   if (audio_size < pa->reserved
+         && ftruncate(pa->fd, (off_t)(pa->data_offset + audio_size)) != 0)
+      return -1;
+   return update_wav_header(file, format, audio_size);
+#else
+   (void)pa;
+   (void)file;
+   (void)format;
+   (void)audio_size;
+   return 0;
+#endif
+}
+
+int pcm_planar_init(pcm_planar *pl, FILE **files, int nfiles, int channels,
+      int sample_size, int format, const unsigned char *map,
+      opus_int64 length)
+{
+   int c;
+   pl->files = files;
+   pl->nfiles = nfiles;
+   pl->channels = channels;
+   pl->sample_size = sample_size;
+   pl->format = format;
+   memcpy(pl->map, map, channels);
+   pl->fill = 0;
+   pl->written = 0;
+   pl->prealloc = NULL;
+   pl->block = malloc((size_t)channels*PCM_PLANAR_BLOCK*sample_size);
+   if (!pl->block) return -1;
+   if (length < 0) return 0;
+   pl->prealloc = malloc(sizeof(*pl->prealloc)*channels);
+   if (!pl->prealloc) return 0;
+   if (nfiles == 1)
+   {
+      /* The blocks are written in order, so one reservation covers them. */
+      if (pcm_prealloc_init(&pl->prealloc[0], files[0], format,
+            length*sample_size*channels) == 1)
+         return 0;
+   }
+   else
+   {
+      for (c = 0; c < channels; c++)
+      {
+         if (pcm_prealloc_init(&pl->prealloc[c], files[c], format,
+               length*sample_size) != 1)
+            break;
+      }
+      if (c == channels) return 0;
+   }
+   free(pl->prealloc);
+   pl->prealloc = NULL;
+   return 0;
+}
+
+static int pcm_planar_flush(pcm_planar *pl)
+{
+   size_t size;
+   int c;
+   if (pl->fill == 0) return 0;
+   size = (size_t)pl->fill*pl->sample_size;
+   for (c = 0; c < pl->channels; c++)
+   {
+      const unsigned char *data;
+      size_t ret;
+      data = pl->block + (size_t)c*PCM_PLANAR_BLOCK*pl->sample_size;
+      if (pl->prealloc)
+         ret = pcm_prealloc_write(&pl->prealloc[pl->nfiles > 1 ? c : 0],
+            data, size, 1);
+      else
+         ret = fwrite(data, size, 1, pl->files[pl->nfiles > 1 ? c : 0]);
+      if (ret != 1) return -1;
+   }
+   pl->written += pl->fill;
+   pl->fill = 0;
+   return 0;
+}
+
+void *pcm_planar_buffer(pcm_planar *pl, int *n)
+{
+   *n = PCM_PLANAR_BLOCK - pl->fill;
+   return pl->block + (size_t)pl->fill*pl->sample_size;
+}
+
+int pcm_planar_commit(pcm_planar *pl, int n)
+{
+   pl->fill += n;
+   if (pl->fill == PCM_PLANAR_BLOCK) return pcm_planar_flush(pl);
+   return 0;
+}
+
+int pcm_planar_finish(pcm_planar *pl)
+{
+   int ret;
+   int c;
+   ret = pcm_planar_flush(pl);
+   if (pl->nfiles == 1)
+   {
+      /* Trim a reservation the decoded length fell short of. */
+      if (pl->prealloc && pcm_prealloc_finish(&pl->prealloc[0], pl->files[0],
+            pl->format, pl->written*pl->sample_size*pl->channels) < 0)
+         ret = -1;
+   }
+   else
+   {
+      opus_int64 audio_size;
+      audio_size = pl->written*pl->sample_size;
+      for (c = 0; c < pl->nfiles; c++)
+      {
+         int err;
+         if (pl->prealloc)
+            err = pcm_prealloc_finish(&pl->prealloc[c], pl->files[c],
+               pl->format, audio_size);
+         else
+            err = update_wav_header(pl->files[c], pl->format, audio_size);
+         if (err < 0) ret = -1;
+      }
+   }
+   return ret;
+}
+
+void pcm_planar_clear(pcm_planar *pl)
+{
+   free(pl->block);
+   free(pl->prealloc);
+   pl->block = NULL;
+   pl->prealloc = NULL;
+}
@@ -103,7 +103,70 @@ static inline void put_le_float(float *ptr, float val)
 
 void adjust_wav_mapping(int mapping_family, int channels, unsigned char *stream_map);
 
-int write_wav_header(FILE *file, int rate, int mapping_family, int channels, int fp);
+int write_wav_header(FILE *file, int rate, int mapping_family, int channels, int fp,
+      opus_int64 audio_size);
 int update_wav_header(FILE *file, int format, opus_int64 audio_size);
 
+/* Positioned PCM output for regular files whose final size is known before
+   decoding starts. The data area is reserved up front and samples are written
+   with pwrite() at data_offset+pos, so no seek-back is needed when the length
+   matches. Since every write carries its own offset, several writers sharing
+   one fd may each keep their own pcm_prealloc and fill disjoint regions. */
+typedef struct {
+   int fd;
+   opus_int64 data_offset;
+   opus_int64 reserved;
+   opus_int64 pos;
+} pcm_prealloc;
+
+int pcm_prealloc_init(pcm_prealloc *pa, FILE *file, int format,
+      opus_int64 audio_size);
+size_t pcm_prealloc_write(pcm_prealloc *pa, const void *ptr, size_t size,
+      size_t nmemb);
+int pcm_prealloc_finish(pcm_prealloc *pa, FILE *file, int format,
+      opus_int64 audio_size);
+
+/* Planar PCM output. The samples are gathered in one block of up to
+   PCM_PLANAR_BLOCK samples per channel, and map[c] gives the input channel
+   for output channel c. With one file per channel, each file gets a mono
+   stream. A single file is always written block by block: each block holds
+   PCM_PLANAR_BLOCK samples of channel 0, then as many of channel 1, and so
+   on, except the last, which holds the remaining length%PCM_PLANAR_BLOCK
+   samples of each channel. So a reader can find the layout from the size of
+   the file and the number of channels alone. */
+#define PCM_PLANAR_BLOCK (16384)
+
+typedef struct {
+   FILE **files;
+   int nfiles;
+   int channels;
+   int sample_size;
+   int format;
+   unsigned char map[255];
+   unsigned char *block;
+   int fill;
+   opus_int64 written;
+   pcm_prealloc *prealloc;
+} pcm_planar;
+
+/* files holds either one file or one per channel, each with its header (if
+   any, of the given format) already written. length is the number of
+   samples per channel, or -1 if it is not known. Returns 0 on success or -1
+   on error. */
+int pcm_planar_init(pcm_planar *pl, FILE **files, int nfiles, int channels,
+      int sample_size, int format, const unsigned char *map,
+      opus_int64 length);
+/* For converting samples straight into the block: returns where the next
+   sample of output channel 0 goes, those of channel c being
+   c*PCM_PLANAR_BLOCK samples further on, and sets *n to the number of
+   samples of each channel that fit. pcm_planar_commit() then adds the n
+   samples written for each channel, writing the block out once it is full.
+   It returns 0 on success or -1 on error. */
+void *pcm_planar_buffer(pcm_planar *pl, int *n);
+int pcm_planar_commit(pcm_planar *pl, int n);
+/* Writes the last block and completes the Wave headers. The files are left
+   open. Returns 0 on success or -1 on error. */
+int pcm_planar_finish(pcm_planar *pl);
+void pcm_planar_clear(pcm_planar *pl);
+
 #endif